@@ -30,4 +30,13 @@ void mmu_set_ptr1( uint32_t* x );
 // configure MMU: set 2-bit permission field of domain d to x
 void mmu_set_dom( int d, uint8_t x );
 
+// read fault address of last      data abort, i.e., DFAR
+uint32_t mmu_get_dfar();
+// read fault status  of last      data abort, i.e., DFSR
+uint32_t mmu_get_dfsr();
+// read fault address of last pre-fetch abort, i.e., IFAR
+uint32_t mmu_get_ifar();
+// read fault status  of last pre-fetch abort, i.e., IFSR
+uint32_t mmu_get_ifsr();
+
 #endif
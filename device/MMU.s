@@ -32,6 +32,11 @@
 	
 .global mmu_set_dom
 
+.global mmu_get_dfar
+.global mmu_get_dfsr
+.global mmu_get_ifar
+.global mmu_get_ifsr
+
 mmu_enable:          mrc   p15, 0, r0, c1, c0, 0 @ read  SCTLR
                      orr   r0, r0, #0x1          @ set   SCTLR[ M ] = 1 => MMU  enable
                      mcr   p15, 0, r0, c1, c0, 0 @ write SCTLR
@@ -69,3 +74,18 @@ mmu_set_dom:         add   r0, r0, r0            @ compute i (index      from do
 
                      mov   pc, lr                @ return
 
+mmu_get_dfar:        mrc   p15, 0, r0, c6, c0, 0 @ read  DFAR
+
+                     mov   pc, lr                @ return
+
+mmu_get_dfsr:        mrc   p15, 0, r0, c5, c0, 0 @ read  DFSR
+
+                     mov   pc, lr                @ return
+
+mmu_get_ifar:        mrc   p15, 0, r0, c6, c0, 2 @ read  IFAR
+
+                     mov   pc, lr                @ return
+
+mmu_get_ifsr:        mrc   p15, 0, r0, c5, c0, 1 @ read  IFSR
+
+                     mov   pc, lr                @ return
@@ -0,0 +1,68 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#ifndef __PMU_H
+#define __PMU_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "device.h"
+
+/* The Cortex-A8 performance monitors (PMU) are documented, alongside the
+ * other co-processor 15 registers, in Section 3.2 of
+ *
+ * http://infocenter.arm.com/help/topic/com.arm.doc.ddi0344k/index.html
+ *
+ * and, as for the MMU, are controlled via co-processor 15: there is one
+ * cycle counter, and PMU_EVENTS event counters, each of which counts the
+ * event selected for it.  Every counter is 32-bit, so a difference of two
+ * readings is correct iff. the interval is shorter than one wrap-around
+ * (about 7s at 600MHz).  Note that QEMU models few events (if any), so
+ * under emulation an event counter may well read 0 whatever it counts,
+ * and the cycle counter is derived from the host clock.
+ */
+
+#define PMU_EVENTS ( 4 )
+
+#define PMU_EVENT_SW_INCR           ( 0x00 ) // software increment
+#define PMU_EVENT_L1I_CACHE_REFILL  ( 0x01 ) // instruction cache miss
+#define PMU_EVENT_L1I_TLB_REFILL    ( 0x02 ) // instruction TLB    miss
+#define PMU_EVENT_L1D_CACHE_REFILL  ( 0x03 ) //        data cache miss
+#define PMU_EVENT_L1D_CACHE         ( 0x04 ) //        data cache access
+#define PMU_EVENT_L1D_TLB_REFILL    ( 0x05 ) //        data TLB    miss
+#define PMU_EVENT_INST_RETIRED      ( 0x08 ) // instruction executed
+#define PMU_EVENT_EXC_TAKEN         ( 0x09 ) // exception taken
+#define PMU_EVENT_PC_WRITE          ( 0x0C ) // software change of PC
+#define PMU_EVENT_BR_MIS_PRED       ( 0x10 ) // branch mispredicted
+#define PMU_EVENT_CPU_CYCLES        ( 0x11 ) // cycle
+#define PMU_EVENT_BR_PRED           ( 0x12 ) // branch predicted
+
+//  enable PMU: reset, then start the cycle counter (without divider), with no overflow interrupts
+void pmu_enable();
+// disable PMU
+void pmu_unable();
+
+// reset cycle counter and every event counter to 0
+void pmu_reset();
+
+// read number of event counters, i.e., PMCR[ N ]
+uint32_t pmu_get_num();
+
+// configure PMU: select event x for event counter i, then reset and start it
+void pmu_set_event( int i, uint32_t x );
+
+// read cycle counter, i.e., PMCCNTR
+uint32_t pmu_get_cycles();
+// read event counter i
+uint32_t pmu_get_event( int i );
+
+// read then clear overflow flags, i.e., PMOVSR (bit 31 => cycle counter, bit i => event counter i)
+uint32_t pmu_get_ovsr();
+
+#endif
@@ -0,0 +1,96 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+/* Chapter C12 of
+ *
+ * http://infocenter.arm.com/help/index.jsp?topic=/com.arm.doc.ddi0406c/index.html
+ *
+ * describes the performance monitor registers of co-processor 15, all of
+ * which have CRn = c9: for example, if we use an mrc instruction
+ *
+ * id = p15, opc1 = 0, CRn = c9, CRm = c13, opc2 = 0
+ *
+ * then we are reading from the PMCCNTR register, i.e., the cycle counter.
+ * An event counter is accessed indirectly, by first writing its index
+ * into the PMSELR register then reading or writing PMXEVTYPER (the event
+ * it counts) or PMXEVCNTR (the count); an isb makes sure the selection
+ * has taken effect before the access.  As for the MMU, the functions
+ * below capture an *extremely* limited sub-set of the functionality.
+ */
+
+.global pmu_enable
+.global pmu_unable
+
+.global pmu_reset
+
+.global pmu_get_num
+
+.global pmu_set_event
+
+.global pmu_get_cycles
+.global pmu_get_event
+
+.global pmu_get_ovsr
+
+pmu_enable:          mvn   r0, #0x0
+                     mcr   p15, 0, r0, c9, c14, 2 @ write PMINTENCLR => no overflow interrupts
+                     mcr   p15, 0, r0, c9, c12, 3 @ write PMOVSR     => clear overflow flags
+
+                     mrc   p15, 0, r0, c9, c12, 0 @ read  PMCR
+                     orr   r0, r0, #0x7           @ set   PMCR[ E, P, C ] = 1 => enable, reset counters
+                     bic   r0, r0, #0x8           @ set   PMCR[ D       ] = 0 => count every cycle
+                     mcr   p15, 0, r0, c9, c12, 0 @ write PMCR
+
+                     mov   r0, #0x80000000
+                     mcr   p15, 0, r0, c9, c12, 1 @ write PMCNTENSET => enable cycle counter
+
+                     mov   pc, lr                 @ return
+
+pmu_unable:          mrc   p15, 0, r0, c9, c12, 0 @ read  PMCR
+                     bic   r0, r0, #0x1           @ set   PMCR[ E ] = 0 => disable
+                     mcr   p15, 0, r0, c9, c12, 0 @ write PMCR
+
+                     mov   pc, lr                 @ return
+
+pmu_reset:           mrc   p15, 0, r0, c9, c12, 0 @ read  PMCR
+                     orr   r0, r0, #0x6           @ set   PMCR[ P, C ] = 1 => reset counters
+                     mcr   p15, 0, r0, c9, c12, 0 @ write PMCR
+
+                     mov   pc, lr                 @ return
+
+pmu_get_num:         mrc   p15, 0, r0, c9, c12, 0 @ read  PMCR
+                     mov   r0, r0, lsr #11
+                     and   r0, r0, #0x1F          @ extract PMCR[ N ]
+
+                     mov   pc, lr                 @ return
+
+pmu_set_event:       mcr   p15, 0, r0, c9, c12, 5 @ write PMSELR
+                     isb
+                     mcr   p15, 0, r1, c9, c13, 1 @ write PMXEVTYPER => select event
+                     mov   r1, #0x0
+                     mcr   p15, 0, r1, c9, c13, 2 @ write PMXEVCNTR  => reset counter
+
+                     mov   r1, #0x1
+                     mov   r1, r1, lsl r0
+                     mcr   p15, 0, r1, c9, c12, 1 @ write PMCNTENSET => enable counter
+
+                     mov   pc, lr                 @ return
+
+pmu_get_cycles:      mrc   p15, 0, r0, c9, c13, 0 @ read  PMCCNTR
+
+                     mov   pc, lr                 @ return
+
+pmu_get_event:       mcr   p15, 0, r0, c9, c12, 5 @ write PMSELR
+                     isb
+                     mrc   p15, 0, r0, c9, c13, 2 @ read  PMXEVCNTR
+
+                     mov   pc, lr                 @ return
+
+pmu_get_ovsr:        mrc   p15, 0, r0, c9, c12, 3 @ read  PMOVSR
+                     mcr   p15, 0, r0, c9, c12, 3 @ write PMOVSR => clear flags read
+
+                     mov   pc, lr                 @ return
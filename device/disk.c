@@ -7,6 +7,9 @@
 
 #include "disk.h"
 
+uint32_t disk_block_num = 0;
+uint32_t disk_block_len = 0;
+
 void addr_puth( PL011_t* d,       uint32_t x,        bool f ) {
   PL011_puth( d, ( x >>  0 ) & 0xFF, f );
   PL011_puth( d, ( x >>  8 ) & 0xFF, f );
@@ -26,6 +29,47 @@ void data_geth( PL011_t* d,       uint8_t* x, int n, bool f ) {
   }
 }
 
+int disk_init() {
+  int n = 2 * sizeof( uint32_t ); uint8_t x[ n ];
+
+  disk_block_num = 0;
+  disk_block_len = 0;
+
+      PL011_puth( UART2, 0x00, true );        // write command
+      PL011_putc( UART2, '\n', true );        // write EOL
+
+  // unlike other requests, don't block forever: the disk may not be attached
+  for( int i = 0; i < DISK_TIMEOUT && !PL011_can_getc( UART2 ); i++ ) {
+    asm volatile( "nop \n" : : : );
+  }
+  if( !PL011_can_getc( UART2 ) ) {
+    return DISK_FAILURE;
+  }
+
+  if( PL011_geth( UART2, true ) != 0x00 ) {   // read  command
+      PL011_getc( UART2,       true );        // read  EOL
+    return DISK_FAILURE;
+  }
+
+      PL011_getc( UART2,       true );        // read  separator
+       data_geth( UART2, x, n, true );        // read  data
+      PL011_getc( UART2,       true );        // read  EOL
+
+  uint32_t num = ( ( uint32_t )( x[ 0 ] ) <<  0 ) | ( ( uint32_t )( x[ 1 ] ) <<  8 ) |
+                 ( ( uint32_t )( x[ 2 ] ) << 16 ) | ( ( uint32_t )( x[ 3 ] ) << 24 ) ;
+  uint32_t len = ( ( uint32_t )( x[ 4 ] ) <<  0 ) | ( ( uint32_t )( x[ 5 ] ) <<  8 ) |
+                 ( ( uint32_t )( x[ 6 ] ) << 16 ) | ( ( uint32_t )( x[ 7 ] ) << 24 ) ;
+
+  if( len < DISK_BLOCK_LEN_MIN || len > DISK_BLOCK_LEN_MAX || ( len & ( len - 1 ) ) ) {
+    return DISK_FAILURE;
+  }
+
+  disk_block_num = num;
+  disk_block_len = len;
+
+  return DISK_SUCCESS;
+}
+
 int disk_get_block_num() {
   int n = 2 * sizeof( uint32_t ); uint8_t x[ n ];
 
@@ -119,3 +163,71 @@ int disk_rd( uint32_t a,       uint8_t* x, int n ) {
 
   return DISK_FAILURE;
 }
+
+int disk_wrv( uint32_t a, const uint8_t** x, int n, int m ) {
+  bool f[ DISK_BATCH ];
+
+  if( m > DISK_BATCH ) {
+    return DISK_FAILURE;
+  }
+
+  for( int j = 0; j < m; j++ ) {
+      PL011_puth( UART2, 0x01, true );        // write command
+      PL011_putc( UART2, ' ',  true );        // write separator
+       addr_puth( UART2, a + j, true );       // write address
+      PL011_putc( UART2, ' ',  true );        // write separator
+       data_puth( UART2, x[ j ], n, true );   // write data
+      PL011_putc( UART2, '\n', true );        // write EOL
+  }
+
+  for( int j = 0; j < m; j++ ) {
+    f[ j ] = ( PL011_geth( UART2, true ) != 0x00 ); // read  command
+      PL011_getc( UART2,       true );        // read  EOL
+  }
+
+  for( int j = 0; j < m; j++ ) {
+    if( f[ j ] && DISK_SUCCESS != disk_wr( a + j, x[ j ], n ) ) {
+      return DISK_FAILURE;
+    }
+  }
+
+  return DISK_SUCCESS;
+}
+
+int disk_rdv( uint32_t a,       uint8_t** x, int n, int m ) {
+  bool f[ DISK_BATCH ];
+
+  if( m > DISK_BATCH ) {
+    return DISK_FAILURE;
+  }
+
+  for( int j = 0; j < m; j++ ) {
+      PL011_puth( UART2, 0x02, true );        // write command
+      PL011_putc( UART2, ' ',  true );        // write separator
+       addr_puth( UART2, a + j, true );       // write address
+      PL011_putc( UART2, '\n', true );        // write EOL
+  }
+
+  for( int j = 0; j < m; j++ ) {
+    if( PL011_geth( UART2, true ) == 0x00 ) { // read  command
+      PL011_getc( UART2,       true );        // read  separator
+       data_geth( UART2, x[ j ], n, true );   // read  data
+      PL011_getc( UART2,       true );        // read  EOL
+
+      f[ j ] = false;
+    }
+    else {
+      PL011_getc( UART2,       true );        // read  EOL
+
+      f[ j ] = true;
+    }
+  }
+
+  for( int j = 0; j < m; j++ ) {
+    if( f[ j ] && DISK_SUCCESS != disk_rd( a + j, x[ j ], n ) ) {
+      return DISK_FAILURE;
+    }
+  }
+
+  return DISK_SUCCESS;
+}
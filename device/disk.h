@@ -26,13 +26,27 @@
  */
 
 #define DISK_RETRY   (  3 )
+#define DISK_BATCH   ( 16 )
 
 #define DISK_SUCCESS (  0 )
 #define DISK_FAILURE ( -1 )
 
-#define BLOCK_NUM 2048
-#define INODE_BLOCKS 24
-#define DATA_BLOCKS 1000
+/* The disk geometry is not fixed, but queried from the disk by disk_init
+ * at boot: the block length can be anything from DISK_BLOCK_LEN_MIN to
+ * DISK_BLOCK_LEN_MAX bytes (a power of two), and everything above the
+ * disk (i.e., the cache and file system) sizes itself to match.  If no
+ * disk answers within DISK_TIMEOUT polls of UART2, both are left as 0.
+ */
+
+#define DISK_BLOCK_LEN_MIN (   16 )
+#define DISK_BLOCK_LEN_MAX ( 4096 )
+#define DISK_TIMEOUT       ( 0x00100000 )
+
+extern uint32_t disk_block_num; // number of blocks, or 0 if there is no disk
+extern uint32_t disk_block_len; // length of each block in bytes
+
+// query the disk geometry, returning DISK_FAILURE if there is no (usable) disk
+extern int disk_init();
 
 // query the disk block count
 extern int disk_get_block_num();
@@ -44,21 +58,17 @@ extern int disk_wr( uint32_t a, const uint8_t* x, int n );
 // read  an n-byte block of data x from the disk at block address a
 extern int disk_rd( uint32_t a,       uint8_t* x, int n );
 
-// sblock
-typedef struct s_block{
-	uint32_t inode_count;
-	uint32_t root_inode;
-} s_block;
-
-// inode struct, stores file metadata
-typedef struct inode {
-	uint16_t i_ino;          // inode number
-	char     *i_type[1];     // file type (directory / file)
-	uint8_t  i_nlink;        // number of hard links
-	uint32_t i_size;         // file size in bytes
-	uint16_t i_blocks;       // file size in blocks
-	uint16_t i_addresses[15]; // data block addresses
-} inode;
+/* The vectored variants below transfer m <= DISK_BATCH blocks at the
+ * consecutive addresses a, a + 1, ..., a + m - 1, using the i-th buffer
+ * in x for block a + i.  Every request is issued back-to-back before
+ * any acknowledgement is collected, so the link is kept busy rather
+ * than waiting one round trip per block; any block that fails is then
+ * retried individually.
+ */
 
+// write m n-byte blocks of data x[ i ] to   the disk at block address a + i
+extern int disk_wrv( uint32_t a, const uint8_t** x, int n, int m );
+// read  m n-byte blocks of data x[ i ] from the disk at block address a + i
+extern int disk_rdv( uint32_t a,       uint8_t** x, int n, int m );
 
 #endif
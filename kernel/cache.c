@@ -0,0 +1,426 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#include "cache.h"
+
+uint8_t      cache_pool[ CACHE_POOL    ] __attribute__( ( aligned( 8 ) ) ); // block content of every buffer
+cache_buf_t  cache_bufs[ CACHE_BLOCKS  ]; // buffers
+int          cache_blocks = 0;            // buffers in use, given block length
+cache_buf_t* cache_hash[ CACHE_BUCKETS ]; // hash table of valid buffers
+cache_buf_t* cache_mru = NULL;            // head of LRU list (most  recent)
+cache_buf_t* cache_lru = NULL;            // tail of LRU list (least recent)
+cache_stat_t cache_stats;                 // hit/miss counters
+
+static uint32_t cache_bucket( uint32_t a ) {
+  return a % CACHE_BUCKETS;
+}
+
+// unlink buffer b from the LRU list
+static void lru_remove( cache_buf_t* b ) {
+  if( b->lru_prev != NULL ) { b->lru_prev->lru_next = b->lru_next; }
+  else                      { cache_mru             = b->lru_next; }
+  if( b->lru_next != NULL ) { b->lru_next->lru_prev = b->lru_prev; }
+  else                      { cache_lru             = b->lru_prev; }
+}
+
+// link buffer b onto the most recently used end of the LRU list
+static void lru_push( cache_buf_t* b ) {
+  b->lru_prev = NULL;
+  b->lru_next = cache_mru;
+
+  if( cache_mru != NULL ) { cache_mru->lru_prev = b; }
+  else                    { cache_lru           = b; }
+
+  cache_mru = b;
+}
+
+static void hash_remove( cache_buf_t* b ) {
+  cache_buf_t** p = &cache_hash[ cache_bucket( b->addr ) ];
+
+  while( *p != NULL && *p != b ) {
+    p = &( *p )->hash_next;
+  }
+  if( *p == b ) {
+    *p = b->hash_next;
+  }
+}
+
+static void hash_insert( cache_buf_t* b ) {
+  uint32_t h = cache_bucket( b->addr );
+
+  b->hash_next = cache_hash[ h ];
+  cache_hash[ h ] = b;
+}
+
+static cache_buf_t* hash_lookup( uint32_t a ) {
+  for( cache_buf_t* b = cache_hash[ cache_bucket( a ) ]; b != NULL; b = b->hash_next ) {
+    if( b->addr == a ) {
+      return b;
+    }
+  }
+  return NULL;
+}
+
+// completion of a write-back: on failure the buffer is dirty again, so will be retried
+static void cache_wr_done( void* tag, int r ) {
+  cache_buf_t* b = ( cache_buf_t* )( tag );
+
+  b->busy = false;
+
+  if( r == DISK_SUCCESS ) {
+    cache_stats.writebacks++;
+  }
+  else {
+    b->dirty = true;
+  }
+}
+
+// completion of a read: the buffer only becomes valid if the read succeeded
+static void cache_rd_done( void* tag, int r ) {
+  cache_buf_t* b = ( cache_buf_t* )( tag );
+
+  b->busy    = false;
+  b->valid   = ( r == DISK_SUCCESS );
+  b->checked = false;
+
+  if( b->valid ) {
+    hash_insert( b );
+  }
+}
+
+/* Queue buffer b for write-back if it is dirty.  If a write is already
+ * queued, it will pick up the current content when it is dispatched, so
+ * there is nothing more to do.
+ */
+
+static void cache_flush( cache_buf_t* b ) {
+  if( !b->valid || !b->dirty || b->pinned ) {
+    return;
+  }
+
+  b->dirty = false;
+
+  if( !b->busy ) {
+    b->busy = true;
+    ios_submit( IOS_WR, b->addr, b->data, &cache_wr_done, b );
+  }
+}
+
+/* Take the least recently used buffer that is neither dirty nor busy for
+ * reuse: dirty buffers passed over on the way are queued for write-back,
+ * and if every buffer is dirty or busy the queued writes are dispatched.
+ * The buffer returned is marked busy, so it is not handed out twice.
+ */
+
+static cache_buf_t* cache_alloc() {
+  for( int i = 0; i < 2; i++ ) {
+    for( cache_buf_t* b = cache_lru; b != NULL; b = b->lru_prev ) {
+      if( b->busy || b->pinned ) {
+        continue;
+      }
+      if( b->valid && b->dirty ) {
+        cache_flush( b ); continue;
+      }
+
+      if( b->valid ) {
+        hash_remove( b );
+        cache_stats.evictions++;
+      }
+
+      b->valid = false;
+      b->busy  = true;
+
+      // move to the most recently used end, so the next allocation takes another
+      lru_remove( b ); lru_push( b );
+
+      return b;
+    }
+
+    ios_run( true );
+  }
+
+  return NULL;
+}
+
+/* Read the run of m blocks starting at address a, none of which are cached,
+ * into freshly allocated buffers: the I/O scheduler merges the reads into
+ * a single vectored request.
+ */
+
+static int cache_fill( uint32_t a, int m ) {
+  cache_buf_t* b[ DISK_BATCH ];
+
+  for( int i = 0; i < m; i++ ) {
+    if( NULL == ( b[ i ] = cache_alloc() ) ) {
+      for( int j = 0; j < i; j++ ) {
+        b[ j ]->busy = false;
+      }
+      return DISK_FAILURE;
+    }
+  }
+
+  for( int i = 0; i < m; i++ ) {
+    b[ i ]->addr = a + i;
+    ios_submit( IOS_RD, a + i, b[ i ]->data, &cache_rd_done, b[ i ] );
+  }
+
+  ios_run( false );
+
+  for( int i = 0; i < m; i++ ) {
+    if( !b[ i ]->valid ) {
+      return DISK_FAILURE;
+    }
+  }
+
+  return DISK_SUCCESS;
+}
+
+// count uncached blocks from address a onward, up to a limit of m
+static int cache_run( uint32_t a, int m ) {
+  int n = 0;
+
+  while( n < m && ( a + n ) < disk_block_num && NULL == hash_lookup( a + n ) ) {
+    n++;
+  }
+
+  return n;
+}
+
+void cache_init() {
+  ios_init();
+
+  memset( cache_hash,  0, sizeof( cache_hash ) );
+  memset( &cache_stats, 0, sizeof( cache_stats ) );
+
+  cache_mru = cache_lru = NULL;
+
+  cache_blocks = ( disk_block_len == 0 ) ? 0 : CACHE_POOL / disk_block_len;
+  cache_blocks = ( cache_blocks > CACHE_BLOCKS ) ? CACHE_BLOCKS : cache_blocks;
+
+  for( int i = 0; i < cache_blocks; i++ ) {
+    cache_bufs[ i ].data      = &cache_pool[ i * disk_block_len ];
+    cache_bufs[ i ].valid     = false;
+    cache_bufs[ i ].dirty     = false;
+    cache_bufs[ i ].busy      = false;
+    cache_bufs[ i ].pinned    = false;
+    cache_bufs[ i ].checked   = false;
+    cache_bufs[ i ].hash_next = NULL;
+    lru_push( &cache_bufs[ i ] );
+  }
+}
+
+cache_buf_t* cache_get( uint32_t a ) {
+  if( a >= disk_block_num ) {
+    return NULL;
+  }
+
+  cache_buf_t* b = hash_lookup( a );
+
+  if( b != NULL ) {
+    cache_stats.hits++;
+  }
+  else {
+    cache_stats.misses++;
+
+    if( DISK_SUCCESS != cache_fill( a, 1 ) || NULL == ( b = hash_lookup( a ) ) ) {
+      return NULL;
+    }
+  }
+
+  lru_remove( b ); lru_push( b );
+
+  return b;
+}
+
+cache_buf_t* cache_lookup( uint32_t a ) {
+  return hash_lookup( a );
+}
+
+int cache_prefetch( uint32_t a, int m ) {
+  for( int i = 0; i < m; ) {
+    if( a + i >= disk_block_num ) {
+      return DISK_FAILURE;
+    }
+    if( NULL != hash_lookup( a + i ) ) {
+      i++; continue;
+    }
+
+    int k = cache_run( a + i, ( m - i < DISK_BATCH ) ? m - i : DISK_BATCH );
+
+    if( DISK_SUCCESS != cache_fill( a + i, k ) ) {
+      return DISK_FAILURE;
+    }
+
+    cache_stats.readaheads += k;
+
+    i += k;
+  }
+
+  return DISK_SUCCESS;
+}
+
+cache_buf_t* cache_new( uint32_t a ) {
+  if( a >= disk_block_num ) {
+    return NULL;
+  }
+
+  cache_buf_t* b = hash_lookup( a );
+
+  if( b == NULL ) {
+    if( NULL == ( b = cache_alloc() ) ) {
+      return NULL;
+    }
+
+    b->addr  = a;
+    b->valid = true;
+    b->busy  = false;
+    hash_insert( b );
+  }
+
+  memset( b->data, 0, disk_block_len ); cache_dirty( b );
+
+  b->checked = true;
+
+  lru_remove( b ); lru_push( b );
+
+  return b;
+}
+
+void cache_seq_init( cache_seq_t* s ) {
+  s->next   = UINT32_MAX;
+  s->window = 0;
+}
+
+cache_buf_t* cache_get_seq( cache_seq_t* s, uint32_t a ) {
+  if( a >= disk_block_num ) {
+    return NULL;
+  }
+
+  if( s->next == a ) {
+    s->window = ( s->window == 0 ) ? 1 : s->window * 2;
+    s->window = ( s->window > CACHE_RA_WINDOW ) ? CACHE_RA_WINDOW : s->window;
+  }
+  else {
+    s->window = 0;
+  }
+
+  s->next = a + 1;
+
+  // a miss reads the block together with the window beyond it ...
+  if( NULL == hash_lookup( a ) ) {
+    int m = cache_run( a, 1 + s->window );
+
+    cache_stats.misses++;
+    cache_stats.readaheads += m - 1;
+
+    if( DISK_SUCCESS != cache_fill( a, m ) ) {
+      return NULL;
+    }
+
+    cache_buf_t* b = hash_lookup( a );
+    lru_remove( b ); lru_push( b );
+    return b;
+  }
+
+  cache_buf_t* b = cache_get( a );
+
+  if( b == NULL || s->window == 0 ) {
+    return b;
+  }
+
+  // ... while a hit refills a whole window from the first gap once half of it has been consumed
+  for( int i = 1; i <= s->window; i++ ) {
+    if( NULL == hash_lookup( a + i ) ) {
+      int m = ( 2 * i <= s->window + 1 ) ? cache_run( a + i, s->window ) : 0;
+
+      if( m > 0 && DISK_SUCCESS == cache_fill( a + i, m ) ) {
+        cache_stats.readaheads += m;
+      }
+      break;
+    }
+  }
+
+  lru_remove( b ); lru_push( b );
+
+  return b;
+}
+
+void cache_dirty( cache_buf_t* b ) {
+  b->dirty = true;
+}
+
+void cache_pin( cache_buf_t* b, bool p ) {
+  b->pinned = p;
+}
+
+void cache_wait( cache_buf_t* b ) {
+  if( b->busy ) {
+    ios_run( true );
+  }
+}
+
+void cache_drop( cache_buf_t* b ) {
+  if( !b->valid || b->dirty || b->busy || b->pinned ) {
+    return;
+  }
+
+  hash_remove( b );
+
+  b->valid = false;
+
+  // move to the least recently used end, so it is the next buffer reused
+  lru_remove( b );
+
+  b->lru_prev = cache_lru;
+  b->lru_next = NULL;
+
+  if( cache_lru != NULL ) { cache_lru->lru_next = b; }
+  else                    { cache_mru           = b; }
+
+  cache_lru = b;
+}
+
+int cache_rd( uint32_t a,       uint8_t* x, int o, int n ) {
+  cache_buf_t* b = cache_get( a );
+
+  if( b == NULL || o < 0 || o + n > disk_block_len ) {
+    return DISK_FAILURE;
+  }
+
+  memcpy( x, b->data + o, n );
+
+  return DISK_SUCCESS;
+}
+
+int cache_wr( uint32_t a, const uint8_t* x, int o, int n ) {
+  cache_buf_t* b = cache_get( a );
+
+  if( b == NULL || o < 0 || o + n > disk_block_len ) {
+    return DISK_FAILURE;
+  }
+
+  memcpy( b->data + o, x, n ); cache_dirty( b );
+
+  return DISK_SUCCESS;
+}
+
+int cache_sync() {
+  for( int i = 0; i < cache_blocks; i++ ) {
+    cache_flush( &cache_bufs[ i ] );
+  }
+
+  ios_run( true );
+
+  // any write that failed has left its buffer dirty again
+  for( int i = 0; i < cache_blocks; i++ ) {
+    if( cache_bufs[ i ].valid && cache_bufs[ i ].dirty && !cache_bufs[ i ].pinned ) {
+      return DISK_FAILURE;
+    }
+  }
+
+  return DISK_SUCCESS;
+}
@@ -0,0 +1,122 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#ifndef __CACHE_H
+#define __CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string.h>
+
+#include "disk.h"
+#include "iosched.h"
+
+/* Every access to the disk is a round trip over UART2, so the kernel keeps
+ * a fixed-size cache of disk blocks in memory:
+ *
+ * - each cached block lives in a buffer, found via a hash table keyed by
+ *   block address,
+ * - buffers are kept on a list ordered by recency of use, so the least
+ *   recently used buffer is the one reused on a miss,
+ * - writes only update the buffer and mark it dirty: the block is queued
+ *   for write-back (via the I/O scheduler, which merges adjacent blocks
+ *   into one vectored request) when the buffer reaches the LRU end of the
+ *   list, and written by an explicit sync at the latest; until the write
+ *   has been dispatched the buffer is busy, so cannot be reused.
+ *
+ * Callers that read a stream of blocks (e.g., an open file) keep a small
+ * cache_seq_t: if accesses through it are sequential, the cache reads up
+ * to a window of blocks ahead in the same request, doubling the window on
+ * each sequential access up to CACHE_RA_WINDOW and resetting it on a seek.
+ *
+ * A buffer can be pinned, e.g., while it is part of a journal transaction
+ * that has not been committed: a pinned buffer is neither written back
+ * nor reused, even if dirty, until it is unpinned.
+ *
+ * A buffer read from the disk is marked unchecked, so a caller that can
+ * validate the content (e.g., against a checksum) does so once, rather
+ * than on every hit; if the content is bad, the caller can drop the
+ * buffer so the block is read again.
+ */
+
+/* The buffers share a fixed pool of CACHE_POOL bytes, so the number of
+ * buffers is set at initialisation from the disk block length: e.g., 128
+ * buffers of 512 bytes, or 16 of 4 KiB.
+ */
+
+#define CACHE_POOL      ( 0x10000 )
+#define CACHE_BLOCKS    ( CACHE_POOL / 512 )
+#define CACHE_BUCKETS   ( 32 )
+#define CACHE_RA_WINDOW (  8 )
+
+typedef struct cache_buf {
+  uint32_t          addr;           // block address
+  bool              valid;          // buffer holds a block?
+  bool              dirty;          // buffer differs from disk?
+  bool              busy;           // buffer has a transfer queued?
+  bool              pinned;         // buffer must not be written back yet?
+  bool              checked;        // content validated since it was read?
+
+  struct cache_buf* hash_next;      // next buffer in hash bucket
+  struct cache_buf*  lru_prev;      // more recently used buffer
+  struct cache_buf*  lru_next;      // less recently used buffer
+
+  uint8_t*          data;           // block content, within the pool
+} cache_buf_t;
+
+typedef struct {
+  uint32_t hits;                    // lookups served from memory
+  uint32_t misses;                  // lookups that read the disk
+  uint32_t evictions;               // buffers reused for another block
+  uint32_t writebacks;              // dirty blocks written to the disk
+  uint32_t readaheads;              // blocks read before being asked for
+} cache_stat_t;
+
+typedef struct {
+  uint32_t next;                    // block address expected next
+  int      window;                  // current read-ahead window, in blocks
+} cache_seq_t;
+
+extern cache_stat_t cache_stats;
+extern int          cache_blocks;   // number of buffers in use
+
+// initialise the cache, i.e., carve the pool into disk-block-sized buffers and invalidate them
+extern void         cache_init();
+
+// get buffer holding block a, reading it from the disk on a miss
+extern cache_buf_t* cache_get( uint32_t a );
+// get buffer holding block a, as accessed via stream s (reading ahead iff. sequential)
+extern cache_buf_t* cache_get_seq( cache_seq_t* s, uint32_t a );
+// get buffer holding block a iff. it is cached (without reading the disk, or counting a hit or miss)
+extern cache_buf_t* cache_lookup( uint32_t a );
+// make sure blocks a to a + m - 1 are cached, reading any that are not via multi-block transfers
+extern int          cache_prefetch( uint32_t a, int m );
+// get buffer for block a zero-filled and dirty, without reading the disk (e.g., for a newly allocated block)
+extern cache_buf_t* cache_new( uint32_t a );
+// mark buffer b as modified, so it is written back before reuse
+extern void         cache_dirty( cache_buf_t* b );
+// pin (iff. p) or unpin buffer b, i.e., prevent or allow its write-back and reuse (a write-back queued already is unaffected)
+extern void         cache_pin( cache_buf_t* b, bool p );
+// wait for any transfer queued for buffer b, e.g., so a write-back queued before b is modified carries the content it had
+extern void         cache_wait( cache_buf_t* b );
+// invalidate buffer b iff. it is clean and idle, so the block is read from the disk again on next use
+extern void         cache_drop( cache_buf_t* b );
+
+// read  n bytes into x from offset o of block a
+extern int          cache_rd( uint32_t a,       uint8_t* x, int o, int n );
+// write n bytes from x to   offset o of block a
+extern int          cache_wr( uint32_t a, const uint8_t* x, int o, int n );
+
+// reset stream s, i.e., forget any sequential access pattern
+extern void         cache_seq_init( cache_seq_t* s );
+
+// write every dirty buffer that is not pinned back to the disk
+extern int          cache_sync();
+
+#endif
@@ -0,0 +1,71 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#include "crc32.h"
+
+uint32_t crc32_table[ 8 ][ 256 ];        // table k maps byte i to CRC of i followed by k zero bytes
+bool     crc32_ready = false;
+
+void crc32_init() {
+  if( crc32_ready ) {
+    return;
+  }
+
+  for( uint32_t i = 0; i < 256; i++ ) {
+    uint32_t c = i;
+
+    for( int j = 0; j < 8; j++ ) {
+      c = ( c >> 1 ) ^ ( ( c & 1 ) ? CRC32_POLY : 0 );
+    }
+
+    crc32_table[ 0 ][ i ] = c;
+  }
+
+  for( uint32_t i = 0; i < 256; i++ ) {
+    for( int k = 1; k < 8; k++ ) {
+      uint32_t c = crc32_table[ k - 1 ][ i ];
+
+      crc32_table[ k ][ i ] = ( c >> 8 ) ^ crc32_table[ 0 ][ c & 0xFF ];
+    }
+  }
+
+  crc32_ready = true;
+}
+
+/* The bytes before the first 4-byte boundary, and any after the last
+ * 8-byte step, are taken one at a time.  The 8-byte steps load words,
+ * which assumes a little-endian machine (as both the ARM target and the
+ * host are): the low byte of each word is the first in memory.
+ */
+
+uint32_t crc32( uint32_t c, const uint8_t* x, size_t n ) {
+  const uint32_t ( *t )[ 256 ] = crc32_table;
+
+  c = ~c;
+
+  while( n > 0 && ( ( uintptr_t )( x ) & 3 ) ) {
+    c = t[ 0 ][ ( c ^ *x++ ) & 0xFF ] ^ ( c >> 8 ); n--;
+  }
+
+  while( n >= 8 ) {
+    uint32_t a = ( ( const uint32_t* )( x ) )[ 0 ] ^ c;
+    uint32_t b = ( ( const uint32_t* )( x ) )[ 1 ];
+
+    c = t[ 7 ][ ( a       ) & 0xFF ] ^ t[ 6 ][ ( a >>  8 ) & 0xFF ] ^
+        t[ 5 ][ ( a >> 16 ) & 0xFF ] ^ t[ 4 ][ ( a >> 24 )        ] ^
+        t[ 3 ][ ( b       ) & 0xFF ] ^ t[ 2 ][ ( b >>  8 ) & 0xFF ] ^
+        t[ 1 ][ ( b >> 16 ) & 0xFF ] ^ t[ 0 ][ ( b >> 24 )        ];
+
+    x += 8; n -= 8;
+  }
+
+  while( n > 0 ) {
+    c = t[ 0 ][ ( c ^ *x++ ) & 0xFF ] ^ ( c >> 8 ); n--;
+  }
+
+  return ~c;
+}
@@ -0,0 +1,39 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#ifndef __CRC32_H
+#define __CRC32_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* CRC-32 (i.e., the IEEE 802.3 polynomial, bit-reflected as 0xEDB88320,
+ * with initial value and final XOR of 0xFFFFFFFF, as used by zlib), so
+ * crc32( 0, "123456789", 9 ) = 0xCBF43926.
+ *
+ * The bitwise definition costs 8 shift-and-XOR steps per byte, so the
+ * kernel uses the slice-by-8 method instead: 8 tables of 256 entries,
+ * where table k holds the CRC of byte i followed by k zero bytes, let
+ * 8 bytes be folded into the CRC per step with 8 independent lookups
+ * (i.e., loads that can overlap) rather than one dependent lookup per
+ * byte.  The 8 KiB of tables are computed once, by crc32_init.
+ *
+ * This file is shared with the host-side tools, so it depends on neither
+ * the kernel nor the disk.
+ */
+
+#define CRC32_POLY  ( 0xEDB88320 )
+#define CRC32_CHECK ( 0xCBF43926 )    // CRC of "123456789"
+
+// compute the tables (idempotent)
+extern void     crc32_init();
+
+// update the CRC c (0 to start) with n bytes from x
+extern uint32_t crc32( uint32_t c, const uint8_t* x, size_t n );
+
+#endif
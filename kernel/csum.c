@@ -0,0 +1,80 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#include "csum.h"
+
+uint32_t    csum_start = 0;              // first block of checksum table
+uint32_t    csum_len   = 0;              // number of blocks in checksum table, or 0 if there is none
+csum_stat_t csum_stats;
+
+// true iff. block a has an entry, i.e., is neither the superblock, nor part of the table, nor beyond it
+static bool csum_covered( uint32_t a ) {
+  uint32_t epb = disk_block_len / sizeof( uint32_t );
+
+  return csum_len != 0 && a != 0 && a / epb < csum_len && ( a < csum_start || a >= csum_start + csum_len );
+}
+
+void csum_init( uint32_t s, uint32_t len ) {
+  crc32_init();
+
+  csum_start = s;
+  csum_len   = len;
+
+  memset( &csum_stats, 0, sizeof( csum_stats ) );
+}
+
+bool csum_enabled() {
+  return csum_len != 0;
+}
+
+bool csum_check( uint32_t a, const uint8_t* x ) {
+  uint32_t epb = disk_block_len / sizeof( uint32_t ), e;
+
+  if( !csum_covered( a ) ) {
+    return true;
+  }
+
+  // a table block that cannot be read is no evidence the block is bad
+  if( DISK_SUCCESS != cache_rd( csum_start + a / epb, ( uint8_t* )( &e ), ( a % epb ) * sizeof( uint32_t ), sizeof( uint32_t ) ) || e == FS_CSUM_NONE ) {
+    return true;
+  }
+
+  csum_stats.checked++;
+
+  if( e != fs_csum_tag( crc32( 0, x, disk_block_len ) ) ) {
+    csum_stats.failed++; return false;
+  }
+
+  return true;
+}
+
+int csum_set( uint32_t a, const uint8_t* x, cache_buf_t** t ) {
+  uint32_t epb = disk_block_len / sizeof( uint32_t );
+
+  *t = NULL;
+
+  if( !csum_covered( a ) ) {
+    return DISK_SUCCESS;
+  }
+
+  cache_buf_t* b = cache_get( csum_start + a / epb );
+
+  if( b == NULL ) {
+    return DISK_FAILURE;
+  }
+
+  uint32_t* e = &( ( uint32_t* )( b->data ) )[ a % epb ];
+  uint32_t  c = fs_csum_tag( crc32( 0, x, disk_block_len ) );
+
+  csum_stats.updated++;
+
+  if( *e != c ) {
+    cache_wait( b ); *e = c; *t = b;
+  }
+
+  return DISK_SUCCESS;
+}
@@ -0,0 +1,57 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#ifndef __CSUM_H
+#define __CSUM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string.h>
+
+#include "disk.h"
+#include "cache.h"
+#include "crc32.h"
+#include "fs_layout.h"
+
+/* Metadata blocks carry a CRC-32 each, kept in the checksum table region
+ * (see fs_layout.h), so a block the disk returns corrupted is detected
+ * rather than trusted:
+ *
+ * - the journal calls csum_set for every block in a transaction as it
+ *   commits, and adds any block of the table it modified to the same
+ *   transaction, so a block and its checksum reach the disk atomically
+ *   (i.e., a crash never leaves one updated without the other),
+ * - the file system calls csum_check on the content of a metadata block
+ *   the first time it is used after being read from the disk (i.e., not
+ *   on every cache hit).
+ *
+ * The table is read and written through the cache like any other block,
+ * so looking up an entry is normally a cache hit.  The superblock and the
+ * table itself have no checksums, and nor does file data, which is not
+ * written via the journal.
+ */
+
+typedef struct {
+  uint32_t checked;                 // blocks checked
+  uint32_t failed;                  // blocks whose checksum did not match
+  uint32_t updated;                 // checksums (re)computed
+} csum_stat_t;
+
+extern csum_stat_t csum_stats;
+
+// use the len blocks from address s onward as the checksum table (or none, iff. len = 0)
+extern void csum_init( uint32_t s, uint32_t len );
+// check content x of block a against its checksum: true iff. they match, or a has no checksum
+extern bool csum_check( uint32_t a, const uint8_t* x );
+// set the checksum of block a to that of content x; the table buffer modified (if any) is returned via t
+extern int  csum_set( uint32_t a, const uint8_t* x, cache_buf_t** t );
+// true iff. checksums are in use
+extern bool csum_enabled();
+
+#endif
@@ -0,0 +1,266 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#include "fd.h"
+
+fd_obj_t fd_objs [ FD_OBJS  ];           // object pool
+pipe_t   fd_pipes[ FD_PIPES ];           // pipe   pool
+
+// take an unused object from the pool, of type t with one reference; return NULL if there is none
+static fd_obj_t* obj_alloc( fd_type_t t ) {
+  for( int i = 0; i < FD_OBJS; i++ ) {
+    if( fd_objs[ i ].type == FD_NONE ) {
+      memset( &fd_objs[ i ], 0, sizeof( fd_obj_t ) );
+
+      fd_objs[ i ].type = t;
+      fd_objs[ i ].refs = 1;
+
+      return &fd_objs[ i ];
+    }
+  }
+
+  return NULL;
+}
+
+// drop a reference to object o, releasing it (and whatever it refers to) once there are none
+static void obj_put( fd_obj_t* o ) {
+  if( --o->refs > 0 ) {
+    return;
+  }
+
+  switch( o->type ) {
+    case FD_PIPE_RD : o->pipe->readers--; break;
+    case FD_PIPE_WR : o->pipe->writers--; break;
+    case FD_FILE    : fs_close( o->file ); break;
+    default         :                     break;
+  }
+
+  if( o->pipe != NULL && o->pipe->readers == 0 && o->pipe->writers == 0 ) {
+    o->pipe->used = false;
+  }
+
+  o->type = FD_NONE;
+}
+
+// get the object descriptor fd in table t refers to, or NULL if there is none
+static fd_obj_t* fd_get( fd_table_t t, int fd ) {
+  return ( fd < 0 || fd >= FD_MAX ) ? NULL : t[ fd ];
+}
+
+// make the lowest unused descriptor in table t refer to object o; return it, or FD_FAILURE
+static int fd_alloc( fd_table_t t, fd_obj_t* o ) {
+  for( int fd = 0; fd < FD_MAX; fd++ ) {
+    if( t[ fd ] == NULL ) {
+      t[ fd ] = o; return fd;
+    }
+  }
+
+  return FD_FAILURE;
+}
+
+void fd_init() {
+  memset( fd_objs,  0, sizeof( fd_objs  ) );
+  memset( fd_pipes, 0, sizeof( fd_pipes ) );
+}
+
+void fd_console( fd_table_t t ) {
+  fd_obj_t* o = obj_alloc( FD_CONSOLE );
+
+  memset( t, 0, sizeof( fd_table_t ) );
+
+  if( o != NULL ) {
+    t[ 0 ] = t[ 1 ] = t[ 2 ] = o; o->refs = 3;
+  }
+}
+
+void fd_fork( fd_table_t c, fd_table_t p ) {
+  for( int fd = 0; fd < FD_MAX; fd++ ) {
+    if( NULL != ( c[ fd ] = p[ fd ] ) ) {
+      c[ fd ]->refs++;
+    }
+  }
+}
+
+void fd_exit( fd_table_t t ) {
+  for( int fd = 0; fd < FD_MAX; fd++ ) {
+    fd_close( t, fd );
+  }
+}
+
+int fd_open( fd_table_t t, const char* path, int flags ) {
+  fd_obj_t* o = obj_alloc( FD_FILE );
+  int       fd;
+
+  if( o == NULL ) {
+    return FD_FAILURE;
+  }
+  if( NULL == ( o->file = fs_open( path, flags ) ) ) {
+    o->type = FD_NONE; return FD_FAILURE;
+  }
+  if( FD_FAILURE == ( fd = fd_alloc( t, o ) ) ) {
+    obj_put( o );
+  }
+
+  return fd;
+}
+
+int fd_pipe( fd_table_t t, int* x ) {
+  pipe_t* p = NULL;
+
+  for( int i = 0; i < FD_PIPES && p == NULL; i++ ) {
+    p = fd_pipes[ i ].used ? NULL : &fd_pipes[ i ];
+  }
+
+  if( p == NULL ) {
+    return FD_FAILURE;
+  }
+
+  fd_obj_t* r = obj_alloc( FD_PIPE_RD );
+  fd_obj_t* w = obj_alloc( FD_PIPE_WR );
+
+  if( r == NULL || w == NULL ) {
+    if( r != NULL ) { r->type = FD_NONE; }
+    if( w != NULL ) { w->type = FD_NONE; }
+    return FD_FAILURE;
+  }
+
+  memset( p, 0, sizeof( pipe_t ) );
+
+  p->used    = true;
+  p->readers = 1; r->pipe = p;
+  p->writers = 1; w->pipe = p;
+
+  if( FD_FAILURE == ( x[ 0 ] = fd_alloc( t, r ) ) ) {
+    obj_put( r ); obj_put( w ); return FD_FAILURE;
+  }
+  if( FD_FAILURE == ( x[ 1 ] = fd_alloc( t, w ) ) ) {
+    t[ x[ 0 ] ] = NULL; obj_put( r ); obj_put( w ); return FD_FAILURE;
+  }
+
+  return FD_SUCCESS;
+}
+
+int fd_dup( fd_table_t t, int fd ) {
+  fd_obj_t* o = fd_get( t, fd );
+  int       r;
+
+  if( o == NULL || FD_FAILURE == ( r = fd_alloc( t, o ) ) ) {
+    return FD_FAILURE;
+  }
+
+  o->refs++;
+
+  return r;
+}
+
+fs_file_t* fd_file( fd_table_t t, int fd ) {
+  fd_obj_t* o = fd_get( t, fd );
+
+  return ( o == NULL || o->type != FD_FILE ) ? NULL : o->file;
+}
+
+int fd_close( fd_table_t t, int fd ) {
+  fd_obj_t* o = fd_get( t, fd );
+
+  if( o == NULL ) {
+    return FD_FAILURE;
+  }
+
+  t[ fd ] = NULL; obj_put( o );
+
+  return FD_SUCCESS;
+}
+
+int fd_read( fd_table_t t, int fd, uint8_t* x, int n ) {
+  fd_obj_t* o = fd_get( t, fd );
+  int       i = 0;
+
+  if( o == NULL || n < 0 ) {
+    return FD_FAILURE;
+  }
+
+  switch( o->type ) {
+    case FD_CONSOLE : {
+      while( i < n && PL011_can_getc( UART0 ) ) {
+        x[ i++ ] = PL011_getc( UART0, true );
+      }
+
+      return i;
+    }
+    case FD_PIPE_RD : {
+      pipe_t* p = o->pipe;
+
+      // at most two copies, either side of the wrap-around point
+      while( i < n && p->count > 0 ) {
+        int m = PIPE_LEN - p->head;
+
+        m = ( m > p->count ) ? p->count : m;
+        m = ( m > n - i    ) ? n - i    : m;
+
+        memcpy( x + i, p->data + p->head, m );
+
+        p->head = ( p->head + m ) % PIPE_LEN; p->count -= m; i += m;
+      }
+
+      return i;
+    }
+    case FD_FILE    : {
+      return fs_read( o->file, x, n );
+    }
+    default         : {
+      return FD_FAILURE;
+    }
+  }
+}
+
+int fd_write( fd_table_t t, int fd, const uint8_t* x, int n ) {
+  fd_obj_t* o = fd_get( t, fd );
+  int       i = 0;
+
+  if( o == NULL || n < 0 ) {
+    return FD_FAILURE;
+  }
+
+  switch( o->type ) {
+    case FD_CONSOLE : {
+      for( ; i < n; i++ ) {
+        PERF_SCOPE( PERF_PUTC ) {
+          PL011_putc( UART0, x[ i ], true );
+        }
+      }
+
+      return i;
+    }
+    case FD_PIPE_WR : {
+      pipe_t* p = o->pipe;
+
+      // nobody can ever read what is written
+      if( p->readers == 0 ) {
+        return FD_FAILURE;
+      }
+
+      while( i < n && p->count < PIPE_LEN ) {
+        int k = ( p->head + p->count ) % PIPE_LEN, m = PIPE_LEN - k;
+
+        m = ( m > PIPE_LEN - p->count ) ? PIPE_LEN - p->count : m;
+        m = ( m > n - i               ) ? n - i               : m;
+
+        memcpy( p->data + k, x + i, m );
+
+        p->count += m; i += m;
+      }
+
+      return i;
+    }
+    case FD_FILE    : {
+      return fs_write( o->file, x, n );
+    }
+    default         : {
+      return FD_FAILURE;
+    }
+  }
+}
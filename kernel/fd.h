@@ -0,0 +1,100 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#ifndef __FD_H
+#define __FD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string.h>
+
+#include "PL011.h"
+#include "fs.h"
+#include "perf.h"
+
+/* Each process has a table of FD_MAX descriptors, each of which is either
+ * unused (NULL) or refers to an fd_obj_t, i.e., something that can be
+ * read or written:
+ *
+ * - the console (UART0), which descriptors 0 to 2 of the first process
+ *   refer to,
+ * - one end of a pipe, i.e., a FIFO of PIPE_LEN bytes held in the kernel, or
+ * - a file open in the file system.
+ *
+ * Objects come from fixed pools, and are reference counted: fd_dup makes
+ * a second descriptor, and fd_fork a copy of a whole table for a child
+ * process, that refer to (so share the offset of) the same object, which
+ * is only released once every descriptor referring to it is closed.
+ *
+ * Reads and writes never block: a read returns whatever is available
+ * (0 if nothing is), and a write to a pipe whatever fits.  Data moves
+ * directly between the caller's buffer and the UART, pipe buffer, or
+ * block cache.
+ */
+
+#define FD_MAX        ( 16 )         // descriptors per process
+#define FD_OBJS       ( 32 )         // objects, shared by every process
+#define FD_PIPES      (  8 )
+#define PIPE_LEN      ( 512 )
+
+#define FD_SUCCESS    (  0 )
+#define FD_FAILURE    ( -1 )
+
+typedef enum {
+  FD_NONE,
+  FD_CONSOLE,
+  FD_PIPE_RD,
+  FD_PIPE_WR,
+  FD_FILE
+} fd_type_t;
+
+typedef struct {
+  bool       used;                  // pipe in use?
+  uint8_t    data[ PIPE_LEN ];      // buffered bytes, circular
+  uint32_t   head;                  // index of first byte to read
+  uint32_t   count;                 // number of bytes buffered
+  int        readers;               // objects referring to read  end
+  int        writers;               // objects referring to write end
+} pipe_t;
+
+typedef struct {
+  fd_type_t  type;                  // what the object is, or FD_NONE if unused
+  int        refs;                  // descriptors referring to it, in any process
+  pipe_t*    pipe;                  // pipe, iff. type is FD_PIPE_RD or FD_PIPE_WR
+  fs_file_t* file;                  // file, iff. type is FD_FILE
+} fd_obj_t;
+
+typedef fd_obj_t* fd_table_t[ FD_MAX ];
+
+// initialise the object and pipe pools
+extern void fd_init();
+// make descriptors 0 to 2 of (empty) table t refer to the console
+extern void fd_console( fd_table_t t );
+// make table c, for a child process, a copy of table p
+extern void fd_fork   ( fd_table_t c, fd_table_t p );
+// close every descriptor in table t
+extern void fd_exit   ( fd_table_t t );
+
+// open the file at path, per flags; return descriptor, or FD_FAILURE
+extern int  fd_open   ( fd_table_t t, const char* path, int flags );
+// create a pipe, returning descriptors for the read end in x[ 0 ] and write end in x[ 1 ]
+extern int  fd_pipe   ( fd_table_t t, int* x );
+// make a new descriptor that refers to the same object as fd; return it, or FD_FAILURE
+extern int  fd_dup    ( fd_table_t t, int fd );
+// get the open file descriptor fd refers to, or NULL if it does not refer to a file
+extern fs_file_t* fd_file( fd_table_t t, int fd );
+// close descriptor fd
+extern int  fd_close  ( fd_table_t t, int fd );
+
+// read  n bytes into x from descriptor fd; return bytes read, or FD_FAILURE
+extern int  fd_read   ( fd_table_t t, int fd,       uint8_t* x, int n );
+// write n bytes from x to   descriptor fd; return bytes written, or FD_FAILURE
+extern int  fd_write  ( fd_table_t t, int fd, const uint8_t* x, int n );
+
+#endif
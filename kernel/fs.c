@@ -0,0 +1,1186 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#include "fs.h"
+
+s_block   fs_sb;                         // in-memory copy of superblock
+bool      fs_mounted = false;
+fs_file_t fs_files[ FS_OPEN_MAX ];       // open files, in any process
+fs_stat_t fs_stats;
+
+uint32_t  fs_dhint = 0;                  // next-fit hint for data  block allocation
+uint32_t  fs_ihint = 0;                  // next-fit hint for inode       allocation
+bool      fs_sb_dirty = false;           // in-memory superblock modified since last write
+
+/* Every metadata block (i.e., the superblock, bitmaps, inode table, extent
+ * blocks and directories) is modified via the journal, so changes to them
+ * are only written home once the transaction they belong to commits.
+ *
+ * A metadata block is checked against its checksum (if any) before it is
+ * first used after being read from the disk: on a mismatch it is read
+ * once more, in case the transfer rather than the disk was at fault, and
+ * is otherwise treated as unreadable, so corrupt metadata is never used.
+ */
+
+// get buffer holding metadata block a, or NULL if it cannot be read or fails its checksum
+static cache_buf_t* meta_get( uint32_t a ) {
+  for( int i = 0; i < 2; i++ ) {
+    cache_buf_t* b = cache_get( a );
+
+    if( b == NULL || b->checked ) {
+      return b;
+    }
+
+    // pinned while the table is read, so the buffer cannot be reused for it
+    cache_pin( b, true  ); b->checked = csum_check( a, b->data );
+    cache_pin( b, false );
+
+    if( b->checked ) {
+      return b;
+    }
+
+    cache_drop( b );
+  }
+
+  return NULL;
+}
+
+// read  n bytes into x from offset o of metadata block a
+static int meta_rd( uint32_t a,       uint8_t* x, int o, int n ) {
+  cache_buf_t* b = meta_get( a );
+
+  if( b == NULL || o < 0 || o + n > disk_block_len ) {
+    return FS_FAILURE;
+  }
+
+  memcpy( x, b->data + o, n );
+
+  return FS_SUCCESS;
+}
+
+// write n bytes from x to offset o of metadata block a
+static int meta_wr( uint32_t a, const uint8_t* x, int o, int n ) {
+  cache_buf_t* b = meta_get( a );
+
+  if( b == NULL || o < 0 || o + n > disk_block_len ) {
+    return FS_FAILURE;
+  }
+
+  journal_access( b ); memcpy( b->data + o, x, n ); journal_dirty( b );
+
+  return FS_SUCCESS;
+}
+
+/* The following functions deal with the superblock and bitmaps */
+
+// note the in-memory superblock was modified; it is written back by fs_sync
+static void sb_write() {
+  fs_sb_dirty = true;
+}
+
+// write the in-memory superblock into the (cached) block 0, iff. it was modified
+static int sb_flush() {
+  if( !fs_sb_dirty ) {
+    return FS_SUCCESS;
+  }
+
+  fs_sb_dirty = false;
+
+  return meta_wr( 0, ( const uint8_t* )( &fs_sb ), 0, sizeof( s_block ) );
+}
+
+/* Find, set and return the index of the first clear bit at or after hint
+ * in the bitmap of n bits stored from block s onward, or return -1 if all
+ * are set.  Each block is scanned a 32-bit word at a time: a word that is
+ * not all ones has a clear bit, whose position is found with CLZ.  Bits
+ * beyond n are kept set (by fstool format), so they are never returned.
+ */
+
+static int32_t bitmap_alloc( uint32_t s, uint32_t n, uint32_t hint ) {
+  uint32_t bpb = 8 * disk_block_len;          // bits  per block
+  uint32_t wpb = disk_block_len / 4;          // words per block
+  uint32_t m   = ( n + bpb - 1 ) / bpb;       // blocks in bitmap
+
+  hint = ( hint < n ) ? hint : 0;
+
+  for( uint32_t i = 0; i <= m; i++ ) {
+    uint32_t     k = ( hint / bpb + i ) % m;
+    cache_buf_t* b = meta_get( s + k );
+
+    if( b == NULL ) {
+      return -1;
+    }
+
+    uint32_t* w = ( uint32_t* )( b->data );
+
+    // the first block scanned starts at the hint, the extra (last) pass covers what it skipped
+    uint32_t j = ( i == 0 ) ? ( hint % bpb ) / 32 : 0;
+
+    for( ; j < wpb; j++ ) {
+      if( w[ j ] != 0xFFFFFFFF ) {
+        uint32_t x = __builtin_clz( ~w[ j ] );
+
+        journal_access( b ); w[ j ] |= 0x80000000 >> x; journal_dirty( b );
+
+        return k * bpb + j * 32 + x;
+      }
+    }
+  }
+
+  return -1;
+}
+
+// clear bit i in the bitmap stored from block s onward
+static void bitmap_free( uint32_t s, uint32_t i ) {
+  uint32_t     bpb = 8 * disk_block_len;
+  cache_buf_t* b   = meta_get( s + i / bpb );
+
+  if( b != NULL ) {
+    uint32_t* w = ( uint32_t* )( b->data );
+
+    journal_access( b ); w[ ( i % bpb ) / 32 ] &= ~( 0x80000000 >> ( i % 32 ) ); journal_dirty( b );
+  }
+}
+
+// set bit i in the bitmap stored from block s onward; return true iff. it was clear
+static bool bitmap_claim( uint32_t s, uint32_t i ) {
+  uint32_t     bpb = 8 * disk_block_len;
+  cache_buf_t* b   = meta_get( s + i / bpb );
+
+  if( b == NULL ) {
+    return false;
+  }
+
+  uint32_t* w = &( ( uint32_t* )( b->data ) )[ ( i % bpb ) / 32 ];
+  uint32_t  m = 0x80000000 >> ( i % 32 );
+
+  if( *w & m ) {
+    return false;
+  }
+
+  journal_access( b ); *w |= m; journal_dirty( b );
+
+  return true;
+}
+
+/* Allocate a run of up to n contiguous data blocks: the first free block
+ * at or after hint is taken, then the run is extended while the blocks
+ * that follow it are free.  The start address is returned (or 0 on
+ * failure) and the run length via m.  Content is *not* zeroed.
+ */
+
+static uint32_t balloc( uint32_t hint, uint32_t n, uint32_t* m ) {
+  int32_t a = bitmap_alloc( fs_sb.dbitmap_start, fs_sb.block_num, hint ? hint : fs_dhint );
+
+  if( a <= 0 ) {
+    return 0;
+  }
+
+  *m = 1;
+
+  while( *m < n && a + *m < fs_sb.block_num && bitmap_claim( fs_sb.dbitmap_start, a + *m ) ) {
+    ( *m )++;
+  }
+
+  fs_dhint = a + *m;
+  fs_sb.free_blocks -= *m; sb_write();
+
+  return a;
+}
+
+// allocate the block at address a, iff. it is free
+static bool bclaim( uint32_t a ) {
+  if( a >= fs_sb.block_num || !bitmap_claim( fs_sb.dbitmap_start, a ) ) {
+    return false;
+  }
+
+  fs_dhint = a + 1;
+  fs_sb.free_blocks--; sb_write();
+
+  return true;
+}
+
+static void bfree( uint32_t a ) {
+  bitmap_free( fs_sb.dbitmap_start, a );
+  fs_sb.free_blocks++; sb_write();
+}
+
+/* The following functions deal with inodes */
+
+static int inode_rd( uint32_t ino,       inode* x ) {
+  uint32_t ipb = disk_block_len / FS_INODE_LEN;
+
+  if( ino == 0 || ino >= fs_sb.inode_num ) {
+    return FS_FAILURE;
+  }
+
+  return meta_rd( fs_sb.itable_start + ino / ipb, ( uint8_t* )( x ), ( ino % ipb ) * FS_INODE_LEN, sizeof( inode ) );
+}
+
+static int inode_wr( uint32_t ino, const inode* x ) {
+  uint32_t ipb = disk_block_len / FS_INODE_LEN;
+
+  if( ino == 0 || ino >= fs_sb.inode_num ) {
+    return FS_FAILURE;
+  }
+
+  return meta_wr( fs_sb.itable_start + ino / ipb, ( const uint8_t* )( x ), ( ino % ipb ) * FS_INODE_LEN, sizeof( inode ) );
+}
+
+/* The inode cache holds the in-memory copy of recently used inodes, which
+ * everything else works on directly (rather than on transient copies).
+ * An entry is referenced by each open file and by any operation using it,
+ * and only an unreferenced entry can be replaced (the least recently used
+ * one is).  A modified inode is just marked dirty: it is written into the
+ * block cache when replaced or by fs_sync, so repeated updates of, e.g., a
+ * file's size as it is written cost nothing until then.  There are few
+ * entries, so a lookup is a simple scan.
+ */
+
+typedef struct {
+  inode    x;                       // cached inode (first, so an inode* is an icache_entry_t*)
+  uint32_t refs;                    // number of references held
+  bool     dirty;                   // modified since read or written back
+  uint32_t used;                    // time of last use, for LRU replacement
+} icache_entry_t;
+
+icache_entry_t fs_icache[ FS_ICACHE ];
+uint32_t       fs_itime = 0;
+
+/* Get a reference to (the cached copy of) inode ino, reading it from the
+ * disk iff. it is not cached and r is true.  If r is false, the inode is
+ * zero-filled (bar its number) even if cached, since a cached copy of a
+ * freed inode is stale.  Returns NULL if every entry is referenced.
+ */
+
+static inode* iget( uint32_t ino, bool r ) {
+  icache_entry_t* v = NULL;
+
+  for( int i = 0; i < FS_ICACHE; i++ ) {
+    icache_entry_t* e = &fs_icache[ i ];
+
+    if( e->x.i_ino == ino && e->used != 0 ) {
+      fs_stats.icache_hits++;
+
+      if( !r ) {
+        memset( &e->x, 0, sizeof( inode ) ); e->x.i_ino = ino;
+      }
+
+      e->refs++; e->used = ++fs_itime; return &e->x;
+    }
+    if( e->refs == 0 && ( v == NULL || e->used < v->used ) ) {
+      v = e;
+    }
+  }
+
+  fs_stats.icache_misses++;
+
+  if( v == NULL ) {
+    return NULL;
+  }
+  if( v->dirty && v->used != 0 ) {
+    inode_wr( v->x.i_ino, &v->x );
+  }
+
+  v->dirty = false;
+  v->used  = 0;
+
+  if( r ) {
+    if( DISK_SUCCESS != inode_rd( ino, &v->x ) ) {
+      return NULL;
+    }
+  }
+  else {
+    memset( &v->x, 0, sizeof( inode ) ); v->x.i_ino = ino;
+  }
+
+  v->refs = 1; v->used = ++fs_itime; return &v->x;
+}
+
+// drop a reference to cached inode x (which may be NULL)
+static void iput( inode* x ) {
+  if( x != NULL ) {
+    ( ( icache_entry_t* )( x ) )->refs--;
+  }
+}
+
+// mark cached inode x as modified
+static void idirty( inode* x ) {
+  ( ( icache_entry_t* )( x ) )->dirty = true;
+}
+
+// write every modified cached inode, and the superblock, into the block cache
+static int iflush() {
+  int r = sb_flush();
+
+  for( int i = 0; i < FS_ICACHE; i++ ) {
+    icache_entry_t* e = &fs_icache[ i ];
+
+    if( e->dirty && e->used != 0 ) {
+      r |= inode_wr( e->x.i_ino, &e->x ); e->dirty = false;
+    }
+  }
+
+  return r;
+}
+
+// allocate and initialise an inode of type t; return a reference to it, or NULL on failure
+static inode* ialloc( uint8_t t ) {
+  int32_t ino = bitmap_alloc( fs_sb.ibitmap_start, fs_sb.inode_num, fs_ihint );
+  inode*  x;
+
+  if( ino <= 0 || NULL == ( x = iget( ino, false ) ) ) {
+    return NULL;
+  }
+
+  fs_ihint = ino + 1;
+  fs_sb.inode_count++; sb_write();
+
+  x->i_type  = t;
+  x->i_nlink = 1;
+
+  idirty( x );
+
+  return x;
+}
+
+/* The following functions deal with extents: extent k of inode x is
+ * either inline (k < FS_EXTENTS) or in the extent block.
+ */
+
+static uint32_t ext_max() {
+  return FS_EXTENTS + disk_block_len / sizeof( extent );
+}
+
+static int ext_get( inode* x, uint32_t k,       extent* e ) {
+  if( k < FS_EXTENTS ) {
+    *e = x->i_extents[ k ]; return FS_SUCCESS;
+  }
+
+  return meta_rd( x->i_ext_block, ( uint8_t* )( e ), ( k - FS_EXTENTS ) * sizeof( extent ), sizeof( extent ) );
+}
+
+static int ext_set( inode* x, uint32_t k, const extent* e ) {
+  if( k < FS_EXTENTS ) {
+    x->i_extents[ k ] = *e; return FS_SUCCESS;
+  }
+
+  // the extent block is allocated on first use
+  if( x->i_ext_block == 0 ) {
+    uint32_t m;
+
+    if( 0 == ( x->i_ext_block = balloc( 0, 1, &m ) ) || NULL == cache_new( x->i_ext_block ) ) {
+      return FS_FAILURE;
+    }
+  }
+
+  return meta_wr( x->i_ext_block, ( const uint8_t* )( e ), ( k - FS_EXTENTS ) * sizeof( extent ), sizeof( extent ) );
+}
+
+// release every data block of inode x, i.e., truncate it to zero length
+static void itrunc( inode* x ) {
+  extent e;
+
+  for( uint32_t k = 0; k < x->i_nextents; k++ ) {
+    if( FS_SUCCESS == ext_get( x, k, &e ) ) {
+      for( uint32_t i = 0; i < e.e_len; i++ ) {
+        bfree( e.e_start + i );
+      }
+    }
+  }
+
+  if( x->i_ext_block != 0 ) {
+    bfree( x->i_ext_block );
+  }
+
+  memset( x->i_extents, 0, sizeof( x->i_extents ) );
+
+  x->i_ext_block = 0;
+  x->i_nextents  = 0;
+  x->i_size      = 0;
+  x->i_blocks    = 0;
+}
+
+// release inode x (and its data blocks), e.g., one ialloc'ed for a directory entry that could not be added
+static void ifree( inode* x ) {
+  itrunc( x );
+
+  x->i_nlink = 0; idirty( x );
+
+  bitmap_free( fs_sb.ibitmap_start, x->i_ino );
+  fs_sb.inode_count--; sb_write();
+}
+
+/* Map block i of the file described by inode x to a disk block address,
+ * or 0 if there is no such block; the number of blocks from there to the
+ * end of the extent (i.e., that are contiguous on disk) is returned via m.
+ */
+
+static uint32_t bmap( inode* x, uint32_t i, uint32_t* m ) {
+  extent e;
+
+  for( uint32_t k = 0; k < x->i_nextents; k++ ) {
+    if( FS_SUCCESS != ext_get( x, k, &e ) ) {
+      break;
+    }
+    if( i < e.e_len ) {
+      *m = e.e_len - i; return e.e_start + i;
+    }
+
+    i -= e.e_len;
+  }
+
+  *m = 0; return 0;
+}
+
+/* Grow the file described by inode x to (at least) n blocks.  The last
+ * extent is extended in place while the blocks after it are free;
+ * otherwise a new run is allocated as close after it as possible, and
+ * becomes a new extent.  A new run is at least as long as the file is
+ * already (between FS_PREALLOC and FS_PREALLOC_MAX blocks), so files that
+ * grow side by side don't end up with interleaved single-block extents;
+ * blocks beyond the end of the file are released by itrim on close.
+ * Returns the number of blocks the file has afterwards.
+ */
+
+static uint32_t iextend( inode* x, uint32_t n ) {
+  extent e = { 0, 0 };
+
+  if( x->i_nextents > 0 ) {
+    ext_get( x, x->i_nextents - 1, &e );
+  }
+
+  while( x->i_blocks < n ) {
+    if( e.e_len > 0 && bclaim( e.e_start + e.e_len ) ) {
+      e.e_len++;
+
+      // the block is only part of the file once the extent records it
+      if( FS_SUCCESS != ext_set( x, x->i_nextents - 1, &e ) ) {
+        bfree( e.e_start + e.e_len - 1 ); break;
+      }
+
+      x->i_blocks++;
+    }
+    else {
+      uint32_t m, a;
+
+      uint32_t want = ( x->i_blocks > FS_PREALLOC     ) ? x->i_blocks     : FS_PREALLOC;
+               want = (       want > FS_PREALLOC_MAX ) ? FS_PREALLOC_MAX : want;
+               want = ( n - x->i_blocks > want        ) ? n - x->i_blocks : want;
+
+      if( x->i_nextents >= ext_max() || 0 == ( a = balloc( e.e_start + e.e_len, want, &m ) ) ) {
+        break;
+      }
+
+      e.e_start = a; e.e_len = m;
+
+      // ditto, so release the whole run if the extent cannot be recorded
+      if( FS_SUCCESS != ext_set( x, x->i_nextents, &e ) ) {
+        for( uint32_t i = 0; i < m; i++ ) {
+          bfree( a + i );
+        }
+        break;
+      }
+
+      x->i_blocks += m; x->i_nextents++;
+    }
+  }
+
+  return x->i_blocks;
+}
+
+/* The following functions read and write file content */
+
+// release any blocks of inode x beyond the end of the file, i.e., that were preallocated but not used
+static void itrim( inode* x ) {
+  uint32_t n = ( x->i_size + disk_block_len - 1 ) / disk_block_len;
+  extent   e;
+
+  while( x->i_blocks > n && x->i_nextents > 0 && FS_SUCCESS == ext_get( x, x->i_nextents - 1, &e ) ) {
+    uint32_t k = ( x->i_blocks - n < e.e_len ) ? x->i_blocks - n : e.e_len;
+
+    for( uint32_t i = e.e_len - k; i < e.e_len; i++ ) {
+      bfree( e.e_start + i );
+    }
+
+    e.e_len -= k; x->i_blocks -= k;
+
+    if( e.e_len == 0 ) {
+      e.e_start = 0; x->i_nextents--;
+    }
+
+    ext_set( x, x->i_nextents - ( e.e_len == 0 ? 0 : 1 ), &e );
+  }
+
+  // the extent block is released once every extent left fits inline
+  if( x->i_nextents <= FS_EXTENTS && x->i_ext_block != 0 ) {
+    bfree( x->i_ext_block ); x->i_ext_block = 0;
+  }
+
+  idirty( x );
+}
+
+/* On a miss, a read fetches as much of the rest of the request as lies in
+ * the same extent (up to DISK_BATCH blocks) into the cache, so that it is
+ * moved by a single multi-block transfer rather than block by block.
+ */
+
+static int iread( inode* x, cache_seq_t* s, uint32_t off,       uint8_t* p, int n ) {
+  int r = 0;
+
+  if( off >= x->i_size ) {
+    return 0;
+  }
+  if( off + n > x->i_size ) {
+    n = x->i_size - off;
+  }
+
+  while( r < n ) {
+    uint32_t o = ( off + r ) % disk_block_len, m = disk_block_len - o, k;
+    uint32_t a = bmap( x, ( off + r ) / disk_block_len, &k );
+
+    m = ( m > n - r ) ? n - r : m;
+
+    if( a == 0 ) {
+      break;
+    }
+
+    uint32_t w = ( o + ( n - r ) + disk_block_len - 1 ) / disk_block_len; // blocks left in request
+
+    if( w > 1 && NULL == cache_lookup( a ) ) {
+      w = ( w < k ) ? w : k;
+      cache_prefetch( a, ( w < DISK_BATCH ) ? w : DISK_BATCH );
+    }
+
+    cache_buf_t* b = ( s != NULL ) ? cache_get_seq( s, a ) : cache_get( a );
+
+    if( b == NULL ) {
+      break;
+    }
+
+    memcpy( p + r, b->data + o, m );
+
+    r += m;
+  }
+
+  return r;
+}
+
+/* A write first allocates every block it needs, so the allocator sees the
+ * whole run at once and can place it contiguously.  A block written in
+ * full, or one holding nothing before the write (i.e., wholly beyond the
+ * end of the file), is not read from the disk beforehand.
+ */
+
+static int iwrite( inode* x, uint32_t off, const uint8_t* p, int n ) {
+  uint32_t old = ( x->i_size + disk_block_len - 1 ) / disk_block_len;
+  int      r   = 0;
+
+  iextend( x, ( off + n + disk_block_len - 1 ) / disk_block_len );
+
+  // any new block skipped over by a write past the end must read as zero
+  for( uint32_t i = old; i < off / disk_block_len && i < x->i_blocks; i++ ) {
+    uint32_t k;
+
+    cache_new( bmap( x, i, &k ) );
+  }
+
+  while( r < n ) {
+    uint32_t i = ( off + r ) / disk_block_len, k;
+    uint32_t o = ( off + r ) % disk_block_len, m = disk_block_len - o;
+    uint32_t a = bmap( x, i, &k );
+
+    m = ( m > n - r ) ? n - r : m;
+
+    if( a == 0 ) {
+      break;
+    }
+
+    cache_buf_t* b = ( i >= old || m == disk_block_len ) ? cache_new( a ) : cache_get( a );
+
+    if( b == NULL ) {
+      break;
+    }
+
+    memcpy( b->data + o, p + r, m ); cache_dirty( b );
+
+    r += m;
+  }
+
+  if( off + r > x->i_size ) {
+    x->i_size = off + r;
+  }
+
+  idirty( x );
+
+  return r;
+}
+
+/* The following functions deal with directories and paths */
+
+/* The dentry cache remembers names resolved (or added) in any directory,
+ * so repeated lookups of the same path components don't touch the disk
+ * at all.  It is direct-mapped: a new entry simply replaces whatever was
+ * in its slot.  There is no way to remove or rename a directory entry, so
+ * a cached entry never becomes stale.
+ */
+
+typedef struct {
+  uint16_t dir;                     // inode number of directory, or 0 if unused
+  uint16_t ino;                     // inode number name maps to
+  uint8_t  len;                     // length of name
+  char     name[ FS_NAME_MAX ];
+} dcache_entry_t;
+
+dcache_entry_t fs_dcache[ FS_DCACHE ];
+
+static dcache_entry_t* dcache_slot( uint32_t d, const char* n, int l ) {
+  return &fs_dcache[ ( fs_name_hash( n, l ) ^ ( d * 0x9E3779B1 ) ) % FS_DCACHE ];
+}
+
+static uint32_t dcache_lookup( uint32_t d, const char* n, int l ) {
+  dcache_entry_t* e = dcache_slot( d, n, l );
+
+  if( e->dir == d && e->len == l && 0 == memcmp( e->name, n, l ) ) {
+    fs_stats.dcache_hits++;   return e->ino;
+  }
+  else {
+    fs_stats.dcache_misses++; return 0;
+  }
+}
+
+static void dcache_insert( uint32_t d, const char* n, int l, uint32_t ino ) {
+  dcache_entry_t* e = dcache_slot( d, n, l );
+
+  e->dir = d;
+  e->ino = ino;
+  e->len = l;
+  memcpy( e->name, n, l );
+}
+
+// compare name n of length l against directory entry e
+static bool dir_match( const dir_entry* e, const char* n, int l ) {
+  return e->d_ino != 0 && e->d_len == l && 0 == memcmp( e->d_name, n, l );
+}
+
+// get buffer holding bucket k of directory d
+static cache_buf_t* dir_bucket( inode* d, uint32_t k ) {
+  uint32_t m, a = bmap( d, k, &m );
+
+  return ( a == 0 ) ? NULL : meta_get( a );
+}
+
+// look up name n of length l in directory d; return inode number or 0
+static uint32_t dir_lookup( inode* d, const char* n, int l ) {
+  uint32_t epb = disk_block_len / sizeof( dir_entry ), h = fs_name_hash( n, l ), ino;
+
+  if( 0 != ( ino = dcache_lookup( d->i_ino, n, l ) ) ) {
+    return ino;
+  }
+
+  for( uint32_t p = 0; p < d->i_buckets; p++ ) {
+    cache_buf_t* b = dir_bucket( d, ( h + p ) % d->i_buckets );
+    bool         f = false;
+
+    if( b == NULL ) {
+      break;
+    }
+
+    fs_stats.dir_reads++;
+
+    for( uint32_t i = 0; i < epb; i++ ) {
+      dir_entry* e = &( ( dir_entry* )( b->data ) )[ i ];
+
+      if( dir_match( e, n, l ) ) {
+        dcache_insert( d->i_ino, n, l, e->d_ino ); return e->d_ino;
+      }
+
+      f |= ( e->d_ino == 0 && e->d_len == 0 );
+    }
+
+    // a bucket that was never full ends the probe sequence
+    if( f ) {
+      break;
+    }
+  }
+
+  return 0;
+}
+
+// place entry x in the first bucket with a free entry, probing from its hash, in the table of directory d
+static int dir_place( inode* d, const dir_entry* x ) {
+  uint32_t epb = disk_block_len / sizeof( dir_entry ), h = fs_name_hash( x->d_name, x->d_len );
+
+  for( uint32_t p = 0; p < d->i_buckets; p++ ) {
+    cache_buf_t* b = dir_bucket( d, ( h + p ) % d->i_buckets );
+
+    if( b == NULL ) {
+      return FS_FAILURE;
+    }
+
+    for( uint32_t i = 0; i < epb; i++ ) {
+      dir_entry* e = &( ( dir_entry* )( b->data ) )[ i ];
+
+      if( e->d_ino == 0 ) {
+        journal_access( b ); *e = *x; journal_dirty( b ); return FS_SUCCESS;
+      }
+    }
+  }
+
+  return FS_FAILURE;
+}
+
+/* Allocate an empty table of m buckets for directory d, i.e., m zeroed
+ * blocks; any blocks d had before are left to the caller.
+ */
+
+static int dir_alloc( inode* d, uint32_t m ) {
+  uint32_t k;
+
+  memset( d->i_extents, 0, sizeof( d->i_extents ) );
+
+  d->i_ext_block = 0;
+  d->i_nextents  = 0;
+  d->i_blocks    = 0;
+
+  // on failure, release whatever was allocated, so the caller need only restore the table it had
+  if( iextend( d, m ) < m ) {
+    itrunc( d ); return FS_FAILURE;
+  }
+
+  d->i_buckets = m;
+  d->i_size    = m * disk_block_len;
+
+  for( uint32_t i = 0; i < m; i++ ) {
+    cache_buf_t* b = cache_new( bmap( d, i, &k ) );
+
+    if( b == NULL ) {
+      itrunc( d ); return FS_FAILURE;
+    }
+
+    journal_dirty( b );
+  }
+
+  // release any blocks preallocated beyond the table
+  itrim( d );
+
+  return FS_SUCCESS;
+}
+
+// double the number of buckets in directory d, rehashing every entry into the new table
+static int dir_grow( inode* d ) {
+  uint32_t epb = disk_block_len / sizeof( dir_entry );
+  inode    o   = *d;
+
+  if( FS_SUCCESS != dir_alloc( d, 2 * o.i_buckets ) ) {
+    *d = o; return FS_FAILURE;
+  }
+
+  // on failure, release the half-filled new table and go back to the old one, which is intact
+  for( uint32_t k = 0; k < o.i_buckets; k++ ) {
+    for( uint32_t i = 0; i < epb; i++ ) {
+      // placing an entry may evict the old bucket, so get it afresh each time
+      cache_buf_t* b = dir_bucket( &o, k );
+
+      if( b == NULL ) {
+        itrunc( d ); *d = o; return FS_FAILURE;
+      }
+
+      dir_entry e = ( ( dir_entry* )( b->data ) )[ i ];
+
+      if( e.d_ino != 0 && FS_SUCCESS != dir_place( d, &e ) ) {
+        itrunc( d ); *d = o; return FS_FAILURE;
+      }
+    }
+  }
+
+  // release the old table, i.e., all blocks o still refers to
+  itrunc( &o ); idirty( d );
+
+  return FS_SUCCESS;
+}
+
+// return true iff. directory d must grow before another entry is added, i.e., its table would be over 3/4 full
+static bool dir_full( inode* d ) {
+  uint32_t epb = disk_block_len / sizeof( dir_entry );
+
+  return 4 * ( d->i_entries + 1 ) > 3 * d->i_buckets * epb;
+}
+
+// add entry mapping name n of length l to inode number ino in directory d
+static int dir_add( inode* d, const char* n, int l, uint32_t ino ) {
+  dir_entry e;
+
+  if( dir_full( d ) && FS_SUCCESS != dir_grow( d ) ) {
+    return FS_FAILURE;
+  }
+
+  memset( &e, 0, sizeof( dir_entry ) );
+  e.d_ino = ino;
+  e.d_len = l;
+  memcpy( e.d_name, n, l );
+
+  if( FS_SUCCESS != dir_place( d, &e ) ) {
+    return FS_FAILURE;
+  }
+
+  d->i_entries++; idirty( d );
+
+  dcache_insert( d->i_ino, n, l, ino );
+
+  return FS_SUCCESS;
+}
+
+/* Resolve path p, which is always taken relative to the root directory:
+ * a reference to the parent directory of the last component is returned
+ * via d (which the caller must iput), and the last component itself via n
+ * and l.  The result is the inode number of the last component, or 0 if
+ * it does not exist (or FS_FAILURE, with no reference held, if some
+ * intermediate component does not).
+ */
+
+static int32_t namei( const char* p, inode** d, const char** n, int* l ) {
+  uint32_t ino = fs_sb.root_inode;
+
+  if( NULL == ( *d = iget( ino, true ) ) ) {
+    return FS_FAILURE;
+  }
+
+  *n = ""; *l = 0;
+
+  while( true ) {
+    while( *p == '/' ) {
+      p++;
+    }
+    if( *p == '\0' ) {
+      return ino;
+    }
+
+    const char* c = p;
+
+    while( *p != '/' && *p != '\0' ) {
+      p++;
+    }
+    if( p - c > FS_NAME_MAX ) {
+      iput( *d ); return FS_FAILURE;
+    }
+
+    // descend into the previous component, which must be a directory
+    if( *l != 0 ) {
+      iput( *d );
+
+      if( ino == 0 || NULL == ( *d = iget( ino, true ) ) ) {
+        return FS_FAILURE;
+      }
+      if( ( *d )->i_type != FS_TYPE_DIR ) {
+        iput( *d ); return FS_FAILURE;
+      }
+    }
+
+    *n = c; *l = p - c;
+
+    ino = dir_lookup( *d, c, *l );
+  }
+}
+
+// create a directory d's content: a one-bucket table holding the entries . and .. (whose parent is p)
+static int dir_init( inode* d, uint32_t p ) {
+  if( FS_SUCCESS != dir_alloc( d, 1 ) ) {
+    return FS_FAILURE;
+  }
+  if( FS_SUCCESS != dir_add( d, ".",  1, d->i_ino ) ) {
+    return FS_FAILURE;
+  }
+  if( FS_SUCCESS != dir_add( d, "..", 2, p        ) ) {
+    return FS_FAILURE;
+  }
+
+  return FS_SUCCESS;
+}
+
+/* Before an operation modifies anything, it reserves room in the running
+ * transaction for every metadata block it might modify, committing the
+ * transaction first if they might not fit: the operation is then never
+ * split between two transactions, so is never left half done on disk.
+ * The bound for each operation is computed from the functions it uses;
+ * besides, any modified cached inode, and the superblock, may be written
+ * (e.g., an inode replaced by one the operation gets) into the block cache.
+ */
+
+// the number of data bitmap blocks that allocating or releasing n blocks, in r runs, might modify
+static uint32_t bitmap_cost( uint32_t n, uint32_t r ) {
+  uint32_t m = n / ( 8 * disk_block_len ) + 2 * r;
+
+  return ( m < fs_sb.itable_start - fs_sb.dbitmap_start ) ? m : fs_sb.itable_start - fs_sb.dbitmap_start;
+}
+
+// the number of metadata blocks that adding an entry to directory d might modify, i.e., more if the table must grow
+static uint32_t dir_cost( inode* d ) {
+  uint32_t m = d->i_buckets;
+
+  if( !dir_full( d ) ) {
+    return 1;
+  }
+
+  // the new table and its extent block, plus the bitmap for it (with any preallocation) and the old table
+  return 2 * m + 1 + bitmap_cost( 3 * m + FS_PREALLOC_MAX, 3 * m + 2 );
+}
+
+// reserve room for n metadata blocks in the running transaction, committing it first iff. need be
+static int fs_reserve( uint32_t n ) {
+  n += 1;
+
+  for( int i = 0; i < FS_ICACHE; i++ ) {
+    if( fs_icache[ i ].dirty && fs_icache[ i ].used != 0 ) {
+      n++;
+    }
+  }
+
+  // an operation too large for any transaction goes ahead, but then is split
+  return journal_fits( n ) ? FS_SUCCESS : fs_sync();
+}
+
+/* The following functions implement the file system interface */
+
+int fs_mount() {
+  fs_mounted = false;
+
+  memset( fs_files,  0, sizeof( fs_files  ) );
+  memset( fs_dcache, 0, sizeof( fs_dcache ) );
+  memset( fs_icache, 0, sizeof( fs_icache ) );
+  memset( &fs_stats,  0, sizeof( fs_stats   ) );
+
+  fs_sb_dirty = false;
+
+  if( disk_block_len < FS_BLOCK_MIN ) {
+    return FS_FAILURE;
+  }
+  if( DISK_SUCCESS != cache_rd( 0, ( uint8_t* )( &fs_sb ), 0, sizeof( s_block ) ) ) {
+    return FS_FAILURE;
+  }
+
+  // a disk that was never formatted, or formatted with another geometry (or damaged), is left alone: format it with tools/fstool
+  if( fs_sb.magic != FS_MAGIC || fs_sb.block_len != disk_block_len || fs_sb.block_num > disk_block_num ) {
+    return FS_FAILURE;
+  }
+
+  // complete the last transaction if it was committed, which may include the superblock itself
+  uint32_t q;
+
+  if( DISK_SUCCESS != journal_replay( fs_sb.journal_start, fs_sb.journal_len, &q ) ) {
+    return FS_FAILURE;
+  }
+  if( DISK_SUCCESS != cache_rd( 0, ( uint8_t* )( &fs_sb ), 0, sizeof( s_block ) ) ) {
+    return FS_FAILURE;
+  }
+
+  journal_init( fs_sb.journal_start, fs_sb.journal_len, q );
+  // checksums are only kept up to date by journal commits, so are of no use without a journal
+  csum_init( fs_sb.csum_start, ( fs_sb.journal_len > 2 ) ? fs_sb.csum_len : 0 );
+
+  fs_dhint   = fs_sb.data_start;
+  fs_ihint   = FS_ROOT_INO;
+  fs_mounted = true;
+
+  return FS_SUCCESS;
+}
+
+int fs_sync() {
+  int r = iflush();
+
+  return ( FS_SUCCESS == r && DISK_SUCCESS == journal_commit() ) ? FS_SUCCESS : FS_FAILURE;
+}
+
+// take an unused open file for inode x, which keeps the reference to x until it is closed; return NULL (dropping the reference) if there is none
+static fs_file_t* file_alloc( inode* x, int flags ) {
+  for( int i = 0; i < FS_OPEN_MAX; i++ ) {
+    if( !fs_files[ i ].used ) {
+      fs_files[ i ].used  = true;
+      fs_files[ i ].ip    = x;
+      fs_files[ i ].off   = 0;
+      fs_files[ i ].flags = flags;
+      cache_seq_init( &fs_files[ i ].seq );
+
+      return &fs_files[ i ];
+    }
+  }
+
+  iput( x ); return NULL;
+}
+
+fs_file_t* fs_open( const char* path, int flags ) {
+  inode* d; inode* x = NULL; const char* n; int l;
+
+  if( !fs_mounted ) {
+    return NULL;
+  }
+
+  int32_t ino = namei( path, &d, &n, &l );
+
+  if( ino < 0 ) {
+    return NULL;
+  }
+
+  if( ino == 0 ) {
+    // create the file iff. asked to: the inode bitmap, a directory entry, and the two inodes
+    if( ( flags & FS_O_CREAT ) && l != 0 && FS_SUCCESS == fs_reserve( 1 + dir_cost( d ) + 2 ) && NULL != ( x = ialloc( FS_TYPE_FILE ) ) ) {
+      if( FS_SUCCESS != dir_add( d, n, l, x->i_ino ) ) {
+        ifree( x ); iput( x ); x = NULL;
+      }
+    }
+  }
+  else {
+    x = iget( ino, true );
+  }
+
+  iput( d );
+
+  // a directory can be opened, but not written
+  if( x == NULL || ( x->i_type == FS_TYPE_DIR && ( flags & FS_O_ACCMODE ) != FS_O_RDONLY ) ) {
+    iput( x ); return NULL;
+  }
+
+  if( ( flags & FS_O_TRUNC ) && ( flags & FS_O_ACCMODE ) != FS_O_RDONLY ) {
+    // the data bitmap for every block and the extent block, and the inode
+    if( FS_SUCCESS != fs_reserve( bitmap_cost( x->i_blocks + 1, x->i_nextents + 1 ) + 1 ) ) {
+      iput( x ); return NULL;
+    }
+
+    itrunc( x ); idirty( x );
+  }
+
+  return file_alloc( x, flags );
+}
+
+fs_file_t* fs_reopen( fs_file_t* f, int flags ) {
+  if( f == NULL || !f->used ) {
+    return NULL;
+  }
+
+  inode* x = iget( f->ip->i_ino, true );
+
+  return ( x == NULL ) ? NULL : file_alloc( x, flags );
+}
+
+int fs_close( fs_file_t* f ) {
+  if( f == NULL || !f->used ) {
+    return FS_FAILURE;
+  }
+
+  if( ( f->flags & FS_O_ACCMODE ) != FS_O_RDONLY ) {
+    // the data bitmap for the blocks beyond the end of the file, the extent block, and the inode
+    uint32_t n = f->ip->i_blocks - ( f->ip->i_size + disk_block_len - 1 ) / disk_block_len;
+
+    if( FS_SUCCESS == fs_reserve( bitmap_cost( n + 1, f->ip->i_nextents + 1 ) + 2 ) ) {
+      itrim( f->ip );
+    }
+  }
+
+  iput( f->ip ); f->used = false;
+
+  return FS_SUCCESS;
+}
+
+int fs_read( fs_file_t* f, uint8_t* x, int n ) {
+  if( f == NULL || !f->used || ( f->flags & FS_O_ACCMODE ) == FS_O_WRONLY ) {
+    return FS_FAILURE;
+  }
+
+  int r = iread( f->ip, &f->seq, f->off, x, n );
+
+  f->off += r;
+
+  return r;
+}
+
+int fs_write( fs_file_t* f, const uint8_t* x, int n ) {
+  if( f == NULL || !f->used || ( f->flags & FS_O_ACCMODE ) == FS_O_RDONLY ) {
+    return FS_FAILURE;
+  }
+
+  if( f->flags & FS_O_APPEND ) {
+    f->off = f->ip->i_size;
+  }
+
+  // the data bitmap for any new blocks (with preallocation, each maybe in a run of its own), the extent block, and the inode
+  uint32_t k = ( f->off + n + disk_block_len - 1 ) / disk_block_len;
+
+  k = ( k > f->ip->i_blocks ) ? k - f->ip->i_blocks : 0;
+
+  if( n > 0 && FS_SUCCESS != fs_reserve( bitmap_cost( k + FS_PREALLOC_MAX, k + 1 ) + 2 ) ) {
+    return FS_FAILURE;
+  }
+
+  int r = iwrite( f->ip, f->off, x, n );
+
+  f->off += r;
+
+  return r;
+}
+
+int fs_mkdir( const char* path ) {
+  inode* d; inode* x; const char* n; int l; int r = FS_FAILURE;
+
+  if( !fs_mounted ) {
+    return FS_FAILURE;
+  }
+
+  int32_t ino = namei( path, &d, &n, &l );
+
+  if( ino < 0 ) {
+    return FS_FAILURE;
+  }
+  // the inode bitmap, the new table (a bucket, and the data bitmap for it), a directory entry, and the two inodes
+  if( ino != 0 || l == 0 || FS_SUCCESS != fs_reserve( 1 + 1 + bitmap_cost( FS_PREALLOC, 1 ) + dir_cost( d ) + 2 ) || NULL == ( x = ialloc( FS_TYPE_DIR ) ) ) {
+    iput( d ); return FS_FAILURE;  // exists already, or an intermediate component is missing
+  }
+
+  if( FS_SUCCESS == dir_init( x, d->i_ino ) && FS_SUCCESS == dir_add( d, n, l, x->i_ino ) ) {
+    x->i_nlink = 2; idirty( x );
+    d->i_nlink++;   idirty( d );
+
+    r = FS_SUCCESS;
+  }
+  else {
+    ifree( x );
+  }
+
+  iput( x ); iput( d );
+
+  return r;
+}
+
+int fs_info( const char* path, fs_info_t* s ) {
+  inode* d; inode* x; const char* n; int l;
+
+  if( !fs_mounted ) {
+    return FS_FAILURE;
+  }
+
+  int32_t ino = namei( path, &d, &n, &l );
+
+  if( ino < 0 ) {
+    return FS_FAILURE;
+  }
+
+  // the root directory has no parent entry, so is d itself
+  if( ino == 0 || NULL == ( x = ( l == 0 ) ? d : iget( ino, true ) ) ) {
+    iput( d ); return FS_FAILURE;
+  }
+
+  s->ino    = x->i_ino;
+  s->type   = x->i_type;
+  s->nlink  = x->i_nlink;
+  s->size   = x->i_size;
+  s->blocks = x->i_blocks;
+
+  if( x != d ) {
+    iput( x );
+  }
+
+  iput( d ); return FS_SUCCESS;
+}
@@ -0,0 +1,112 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#ifndef __FS_H
+#define __FS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string.h>
+
+#include "disk.h"
+#include "cache.h"
+#include "journal.h"
+#include "csum.h"
+#include "fs_layout.h"
+
+/* The file system sits on top of the block cache: every metadata and data
+ * block it touches is read and written through the cache, so repeated
+ * access to the superblock, bitmaps or inode table is served from memory.
+ *
+ * Opening a file takes an entry from a global pool of open files, which
+ * holds the offset and flags; the descriptors a process uses to refer to
+ * it are managed separately, by the fd layer.  Each open file has its own
+ * read-ahead stream, so sequential reads of a file are detected
+ * independently of any other file.  Reads and writes copy directly
+ * between cached blocks and the caller's buffer (e.g., in user space),
+ * with no intermediate kernel copy.
+ *
+ * Path lookup goes via a small in-memory dentry cache first, and only on
+ * a miss reads the hashed directory on disk.  Inodes are likewise kept in
+ * an inode cache, referenced by each open file using them; changes to an
+ * inode (or the superblock) reach the block cache only once the entry is
+ * reused or fs_sync is called.  Metadata blocks are then updated via the
+ * journal, so fs_sync commits them as a single transaction, and (if the
+ * file system was formatted with a checksum table) are checked against
+ * their checksums when read back.
+ */
+
+#define FS_OPEN_MAX   ( 16 )
+#define FS_PATH_MAX   ( 128 )
+#define FS_DCACHE     ( 64 )
+#define FS_ICACHE     ( 32 )
+#define FS_PREALLOC     (  8 )
+#define FS_PREALLOC_MAX ( 64 )
+
+#define FS_O_RDONLY   ( 0x0000 )
+#define FS_O_WRONLY   ( 0x0001 )
+#define FS_O_RDWR     ( 0x0002 )
+#define FS_O_ACCMODE  ( 0x0003 )
+#define FS_O_CREAT    ( 0x0040 )
+#define FS_O_TRUNC    ( 0x0200 )
+#define FS_O_APPEND   ( 0x0400 )
+
+#define FS_SUCCESS    (  0 )
+#define FS_FAILURE    ( -1 )
+
+typedef struct {
+  bool        used;       // entry in use?
+  inode*      ip;         // cached inode of file
+  uint32_t    off;        // current file offset
+  int         flags;      // flags file was opened with
+  cache_seq_t seq;        // read-ahead state
+} fs_file_t;
+
+typedef struct {
+  uint32_t    dcache_hits;   // path components resolved from memory
+  uint32_t    dcache_misses; // path components looked up on disk
+  uint32_t    dir_reads;     // directory buckets read by lookups
+  uint32_t    icache_hits;   // inodes found in memory
+  uint32_t    icache_misses; // inodes read from the block cache
+} fs_stat_t;
+
+typedef struct {
+  uint32_t    ino;        // inode number
+  uint32_t    type;       // FS_TYPE_FILE or FS_TYPE_DIR
+  uint32_t    nlink;      // number of links
+  uint32_t    size;       // size in bytes
+  uint32_t    blocks;     // size in blocks
+} fs_info_t;
+
+extern s_block   fs_sb;                  // in-memory copy of superblock
+extern bool      fs_mounted;
+extern fs_file_t fs_files[ FS_OPEN_MAX ];
+extern fs_stat_t fs_stats;
+
+// mount the file system on the disk, failing if it holds none that matches its geometry (format it with tools/fstool)
+extern int        fs_mount();
+// write all modified inodes and cached blocks back to the disk
+extern int        fs_sync();
+
+// open the file at path, per flags; return the open file, or NULL on failure
+extern fs_file_t* fs_open ( const char* path, int flags );
+// open the file that open file f refers to again, per flags, with an offset of its own; return it, or NULL on failure
+extern fs_file_t* fs_reopen( fs_file_t* f, int flags );
+// close the open file f
+extern int        fs_close( fs_file_t* f );
+// read  n bytes into x from the open file f; return bytes read
+extern int        fs_read ( fs_file_t* f,       uint8_t* x, int n );
+// write n bytes from x to   the open file f; return bytes written
+extern int        fs_write( fs_file_t* f, const uint8_t* x, int n );
+// create a directory at path
+extern int        fs_mkdir( const char* path );
+// describe the file or directory at path in s
+extern int        fs_info ( const char* path, fs_info_t* s );
+
+#endif
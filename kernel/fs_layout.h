@@ -0,0 +1,151 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#ifndef __FS_LAYOUT_H
+#define __FS_LAYOUT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* The file system uses a simple, fixed on-disk layout (in units of disk
+ * blocks, whose length is whatever the disk reports):
+ *
+ * | super | inode bitmap | data bitmap | inode table | checksums | journal | data ... |
+ * 0       1
+ *
+ * - the superblock records the geometry the file system was formatted
+ *   with, and where each region starts,
+ * - each bitmap holds one bit per inode or per disk block respectively
+ *   (1 means used), packed most significant bit first into 32-bit words
+ *   so a free bit can be found a word at a time using CLZ; the data
+ *   bitmap covers the whole disk, with the metadata blocks marked used,
+ * - the inode table is an array of fixed-size inodes; inode 0 is never
+ *   used, so a directory entry with inode number 0 is free,
+ * - a file's data blocks are described by extents, i.e., runs of blocks
+ *   (start, length) that are contiguous on disk, in file order: the first
+ *   FS_EXTENTS live in the inode, any more in a single extent block,
+ *   so a file written sequentially is often just one extent however
+ *   large it is,
+ * - a directory is a file whose content is a hash table of dir_entry:
+ *   each block is a bucket, and an entry for a name whose hash is h is
+ *   placed in bucket h mod i_buckets or, if that is full, the next one
+ *   with space (wrapping around).  A lookup therefore stops at the first
+ *   bucket with a never-used entry in it, and the table is doubled (and
+ *   rehashed) once it is 3/4 full, so it reads O(1) blocks however large
+ *   the directory is,
+ * - the journal holds (a copy of) the last metadata transaction: a
+ *   descriptor listing the home address of each block, the blocks, and
+ *   then a commit record with the same sequence number; a transaction
+ *   whose commit record is intact is copied home again at mount,
+ * - the checksum table (which is optional, i.e., may have length 0) holds
+ *   one uint32_t per disk block: the CRC-32 of a metadata block, or 0 if
+ *   the block has no checksum (so a CRC of 0 is stored as ~0).  Only the
+ *   bitmaps, inode table, extent blocks and directories are covered: the
+ *   entry of a block is set as part of the transaction that writes it,
+ *   and checked when it is next read as metadata, so the entry of a block
+ *   since freed or reused for file data is stale, but never checked.
+ *
+ * Every structure here has a fixed size and layout (and is little-endian
+ * on disk), so this header is shared with the host-side tools.
+ */
+
+#define FS_MAGIC       ( 0x33534643 ) // "CFS3"
+#define FS_ROOT_INO    (  1 )
+#define FS_INODE_RATIO (  4 )         // one inode per this many disk blocks
+#define FS_INODE_LEN   ( 64 )
+#define FS_EXTENTS     (  5 )
+#define FS_NAME_MAX    ( 29 )
+#define FS_BLOCK_MIN   ( 64 )         // smallest block length that can hold the layout
+
+#define FS_JOURNAL_LEN ( 128 )        // blocks reserved for the journal (at most 1/16 of the disk)
+#define FS_JOURNAL_MAGIC  ( 0x4C4E524A ) // "JRNL"
+#define FS_JOURNAL_DESC   (  1 )
+#define FS_JOURNAL_COMMIT (  2 )
+
+#define FS_CSUM_NONE   ( 0 )
+
+#define FS_TYPE_FREE   (  0 )
+#define FS_TYPE_FILE   (  1 )
+#define FS_TYPE_DIR    (  2 )
+
+// sblock
+typedef struct s_block {
+	uint32_t inode_count;    // number of inodes in use
+	uint32_t root_inode;     // inode number of root directory
+	uint32_t magic;          // FS_MAGIC iff. formatted
+	uint32_t block_len;      // block length the disk was formatted with
+	uint32_t block_num;      // number of blocks the disk was formatted with
+	uint32_t inode_num;      // number of inodes in the inode table
+	uint32_t free_blocks;    // number of unused data blocks
+	uint32_t ibitmap_start;  // first block of inode bitmap
+	uint32_t dbitmap_start;  // first block of data  bitmap
+	uint32_t itable_start;   // first block of inode table
+	uint32_t data_start;     // first data block
+	uint32_t journal_start;  // first block of journal
+	uint32_t journal_len;    // number of blocks in journal, or 0 if there is none
+	uint32_t csum_start;     // first block of checksum table
+	uint32_t csum_len;       // number of blocks in checksum table, or 0 if there is none
+} s_block;
+
+// journal block header: a descriptor is followed by j_count uint32_t home addresses
+typedef struct journal_header {
+	uint32_t j_magic;        // FS_JOURNAL_MAGIC
+	uint32_t j_type;         // FS_JOURNAL_DESC or FS_JOURNAL_COMMIT
+	uint32_t j_seq;          // transaction sequence number
+	uint32_t j_count;        // number of blocks in transaction
+} journal_header;
+
+// extent, i.e., a run of e_len data blocks starting at address e_start
+typedef struct extent {
+	uint32_t e_start;
+	uint32_t e_len;
+} extent;
+
+// inode struct, stores file metadata
+typedef struct inode {
+	uint16_t i_ino;                   // inode number
+	uint8_t  i_type;                  // file type (FS_TYPE_FILE / FS_TYPE_DIR)
+	uint8_t  i_nlink;                 // number of hard links
+	uint32_t i_size;                  // file size in bytes
+	uint32_t i_blocks;                // file size in blocks
+	uint16_t i_nextents;              // number of extents in use
+	uint16_t i_buckets;               // number of hash buckets (directory only)
+	extent   i_extents[FS_EXTENTS];   // first extents
+	uint32_t i_ext_block;             // address of block holding further extents, or 0
+	uint32_t i_entries;               // number of entries     (directory only)
+} inode;
+
+// directory entry, maps a name to an inode number
+typedef struct dir_entry {
+	uint16_t d_ino;                   // inode number, or 0 if entry is free (and d_len = 0 if never used)
+	uint8_t  d_len;                   // length of name
+	char     d_name[FS_NAME_MAX];     // name (not NUL-terminated iff. d_len = FS_NAME_MAX)
+} dir_entry;
+
+// hash of name n of length l (FNV-1a), which selects the directory bucket an entry for it belongs in
+static inline uint32_t fs_name_hash( const char* n, int l ) {
+	uint32_t h = 0x811C9DC5;
+
+	for( int i = 0; i < l; i++ ) {
+		h = ( h ^ ( uint8_t )( n[ i ] ) ) * 0x01000193;
+	}
+
+	return h;
+}
+
+// checksum table entry for a block whose CRC-32 is c
+static inline uint32_t fs_csum_tag( uint32_t c ) {
+	return ( c == FS_CSUM_NONE ) ? ~FS_CSUM_NONE : c;
+}
+
+// number of blocks in a checksum table covering n blocks of length l
+static inline uint32_t fs_csum_len( uint32_t n, uint32_t l ) {
+	return ( n * sizeof( uint32_t ) + l - 1 ) / l;
+}
+
+#endif
@@ -22,270 +22,156 @@
 
 pcb_t procTab[ MAX_PROCS ];        // PCB table
 pcb_t* executing = NULL;           // Pointer to currently executing PCB
-mlf_queues mlfq;                   // Multi-level feedback queue structure
 int next_pid;                      // PID counter to ensure unique PIDs
 bool available_stacks[MAX_PROCS];  // Free stack space table
+pcb_t idleProc;                    // Idle "process", executing iff. no process is ready (so not in procTab)
+uint32_t idleStack[64];            // Stack of idle process
+int schedTick;                     // Timer ticks since scheduler last invoked by the timer
 
 /* The following functions are related to the scheduling and execution of processes */
 
 // Resume/ begin execution of a process by the processor
 void dispatch( ctx_t* ctx, pcb_t* prev, pcb_t* next ) {
-  mlfq.timeCount = 0; // reset process execution timer
+  if (prev == next) { return; }
 
-  char prev_pid = '?', next_pid = '?';
+  schedTick = 0; // next starts a full time slice
 
-  if (prev == next) { return; }
+  uint32_t now = SYSCONF->COUNTER_24MHZ;
 
   if( NULL != prev ) {
     memcpy( &prev->ctx, ctx, sizeof( ctx_t ) ); // preserve execution context of process
-    prev_pid = '0' + prev->pid;
+    prev->acct.run  += now - prev->acct.t_run;  // charge time since dispatch
   }
   if( NULL != next ) {
     memcpy( ctx, &next->ctx, sizeof( ctx_t ) ); // restore execution context of process
-    next_pid = '0' + next->pid;
+    next->acct.wait += now - next->acct.t_wait; // charge time since enqueue
+    next->acct.t_run = now;
   }
 
-   /* PL011_putc( UART0, '[',      true );
-    PL011_putc( UART0, prev_pid, true );
-    PL011_putc( UART0, '-',      true );
-    PL011_putc( UART0, '>',      true );
-    PL011_putc( UART0, next_pid, true );
-    PL011_putc( UART0, ']',      true );
-	*/
+    trace( TRACE_DISPATCH, ( NULL != prev ) ? prev->pid : 0, ( NULL != next ) ? next->pid : 0 ); // [prev->next], via the trace buffer
 
     executing = next;                           // update executing process
 
   return;
 }
 
-// create queue node for given PCB
-node* newNode(pcb_t* pcb) { 
-    node* temp = (node*)malloc(sizeof(node)); 
-    temp->pcb = pcb; 
-    temp->next = NULL; 
-    return temp; 
-} 
+// called by the scheduler as a process is placed onto a ready queue
+void sched_enqueued(queue* q, pcb_t* pcb) {
+	trace(TRACE_ENQUEUE, q - mlfq.queues, pcb->pid);
 
-bool isEmpty(queue* q) {
-	return q->tail == NULL;
+	pcb->acct.t_wait = SYSCONF->COUNTER_24MHZ; // start of wait
 }
 
-// place PCB node onto end of given queue
-void enqueue(queue* q, pcb_t* pcb) {
-    node* temp = newNode(pcb);
-
-    if (isEmpty(q)) {
-        q->head = q->tail = temp;
-        return;
-    }
-
-    q->tail->next = temp;
-    q->tail = temp;
+// called by the scheduler as a process is removed from a ready queue
+void sched_dequeued(queue* q, pcb_t* pcb) {
+	trace(TRACE_DEQUEUE, q - mlfq.queues, pcb->pid);
 }
 
-// remove head node from given queue
-void dequeue(queue* q) {
-	if (isEmpty(q)) {
-		return;
-	}
-
-    node* temp = q->head;
-	q->head = q->head->next;
+// Scheduler: select the process to execute next (see sched.c), then dispatch it
+void multiLevelFeedbackSchedule(ctx_t* ctx){
+	pcb_t* prev = executing;
+	pcb_t* next = NULL;
 
-	if (q->head == NULL) {
-		q->tail = NULL;
+	PERF_SCOPE( PERF_SCHEDULE ) {
+		next = mlfqSchedule((prev == &idleProc) ? NULL : prev);
+	}
+	if (next == NULL) { next = &idleProc; } // nothing ready, so wait for an interrupt
+	PERF_SCOPE( PERF_DISPATCH ) {
+		dispatch(ctx, prev, next);
 	}
-
-	free(temp);
 }
 
-// delete PCB node from any point in a queue
-void delPCBNode(queue* q, pcb_t* pcb) {
-
-	if (pcb->status != STATUS_READY) {return;} // only PCBs with ready status are in a queue
-
-	if (q->head->pcb == pcb) {
-		dequeue(q);
-		return;
+// Executed by the idle process: wait for an interrupt, e.g., the timer waking a process
+void idle() {
+	while (1) {
+		asm volatile( "wfi \n" );
 	}
+}
 
-	node* temp1 = q->head;
-	node* temp2;
+/* A process sleeps by being parked with status STATUS_WAITING, i.e., out
+ * of every ready queue, with its timer pending in the timer wheel (see
+ * wheel.h), which ticks at WHEEL_HZ: on expiry, wake places it back into
+ * the ready queue of its priority level, and returns the time in ms from
+ * sleep_ms or sleep_until.  The scheduler itself is invoked every
+ * SCHED_TICKS ticks, so a woken process waits for the rest of the time
+ * slice of whatever executes (unless that is the idle process).
+ */
 
-	while (temp1->next->pcb != pcb) {
-		temp1 = temp1->next;
-	}
+void wake(void* x) {
+	pcb_t* pcb = (pcb_t*)x;
 
-	temp2 = temp1->next;
-	temp1->next = temp1->next->next;
-	
-	if (temp1->next == NULL) {
-		q->tail = temp1;
-	}
-
-	free(temp2);
+	pcb->ctx.gpr[0] = wheel.now / (WHEEL_HZ / 1000); // sleep returns time of wake-up
+	pcb->status = STATUS_READY;
+	enqueue(&mlfq.queues[pcb->prty-1], pcb);
 }
 
-// retrieve highest priority PCB node from within the multi-level queue structure
-node* mlfqHighestNode(mlf_queues* mlfq) {
-	for (int i = 0; i < PRIORITY_LEVELS; i++) {
-		if (!isEmpty(&mlfq->queues[i])) {
-	      return mlfq->queues[i].head;
-		}
+// Park the executing process until tick t (unless that has passed), and schedule another in its place
+void sleepUntil(ctx_t* ctx, uint32_t t) {
+	if ((int32_t)(t - wheel.now) <= 0) {
+		ctx->gpr[0] = wheel.now / (WHEEL_HZ / 1000);
+		return;
 	}
-	return NULL;
-}
 
-// Place given PCB node (that has just finished being executed) into a queue 
-void reQueue(pcb_t* pcb) {
+	executing->status = STATUS_WAITING;
+	executing->acct.vcsw++;
+	wheel_add(&executing->timer, t, &wake, executing);
 
-	prty_t prev_prty = pcb->prty;
-	prty_t next_prty;
-	if (pcb->prty < 3) { 
-		next_prty = pcb->prty + 1;
-		pcb->prty++;
-	}
-	else {
-		next_prty = pcb->prty;
-	}
-	enqueue(&mlfq.queues[next_prty-1], pcb);
+	multiLevelFeedbackSchedule(ctx);
 }
 
-// Scheduler
-void multiLevelFeedbackSchedule(ctx_t* ctx){
-	int prev = -1;	
-
-	// Get previous process pcb
-	for (int i = 0; i < MAX_PROCS; i++) {
-		if (executing->pid == procTab[i].pid) {
-			prev = i;
-		}
-	}
+extern uint32_t p_stack_space;
+extern uint32_t img_space_start;
+extern uint32_t img_space_end;
+extern uint32_t vm_space_start;
+extern uint32_t vm_space_end;
+extern void main_console();
 
-   	// if no previous process, dispatch next highest priority process
-	if (prev == -1) {		
-		node* top = mlfqHighestNode(&mlfq);
-		dispatch(ctx, NULL, top->pcb);
-		dequeue(&mlfq.queues[top->pcb->prty-1]);
-		executing->status = STATUS_EXECUTING;
-		return;
-	}
-	
-	// increment no. time slices used by process
-	mlfq.timeCount++;  
-	
-	// Check process has not used up allocated time slices at current priority level
-	if (mlfq.timeCount < mlfq.queueTime[procTab[prev].prty-1]) { return; }
-
-	// If process has used allocated time slice, requeue and dispatch next
-	// highest priority process
-	reQueue(&procTab[prev]);
-	node* newTop = mlfqHighestNode(&mlfq);
-	dispatch(ctx, &procTab[prev], newTop->pcb); 
-	dequeue(&mlfq.queues[newTop->pcb->prty-1]);
-	procTab[prev].status = STATUS_READY;
-	executing->status = STATUS_EXECUTING;
-
-	return;
-}
+/* Each system call identifier below SVC_IDS has a latency histogram, i.e.,
+ * of the ticks of the 24MHz counter between entry to and exit from the
+ * handler; these are read and reset via svc_stat and svc_reset.
+ */
 
-void initMLFS(ctx_t* ctx) {
-  // place all initialised processes into correct priority queue
+hist_t svcHist[SVC_IDS];
 
-  for (int i = 0; i < MAX_PROCS; i++) {
-    if (procTab[i].status != STATUS_INVALID) {
-      for (int j = 0; j < PRIORITY_LEVELS; j++) {
-	    if (procTab[i].prty == j) { enqueue(&mlfq.queues[j-1], &procTab[i]);}
-	  }	
+void svcReset() {
+	for (int i = 0; i < SVC_IDS; i++) {
+		hist_reset(&svcHist[i]);
 	}
-  }
-
-  // Each priority queue is assigned double the time slot for processes than the queue above
-  mlfq.queueTime[0] = 1;
-  for (int i = 1; i < PRIORITY_LEVELS; i++) {
-	  mlfq.queueTime[i] = mlfq.queueTime[i-1]*2;
-  }
-
-  mlfq.timeCount = 0;
 }
 
-/* The following functions are related to the use of the disk */
+int svcStat(int id, hist_t* x) {
+	if (id < 0 || id >= SVC_IDS) { return -1; }
 
-// convert 4 bytes to uint32
-uint32_t b2u32(uint8_t *in) {
-	uint32_t out = 0;
-	for (int i = 0; i<4; i++) {
-		out = out | ((uint32_t)(in[i]) << i*8);
-	}
-	return out;
-}
+	memcpy(x, &svcHist[id], sizeof(hist_t));
 
-// convert 2 bytes to uint16
-uint16_t b2u16(uint8_t *in) {
-	uint16_t out = 0;
-	for (int i = 0; i<2; i++) {
-		out = out | ((uint16_t)(in[i]) << i*8);
-	}
-	return out;
+	return 0;
 }
 
-// read in a super block struct
-s_block *readInSBlock() {
-	int size = sizeof(s_block);
-	uint8_t data[size];
-	if (DISK_SUCCESS == disk_rd(0, data, size)) {
-		PL011_putc(UART1,'P',true);
-	}
-	else {PL011_putc(UART1,'O',true);}
-
-	s_block *s = malloc(sizeof(s_block));
-   	s->inode_count = data[0];
-	s->root_inode = data[4];
+/* The timer interrupt has a histogram of latency, i.e., how long after the
+ * expiry of TIMER0 the handler is entered (the periodic timer reloads then
+ * counts down, so this is Timer1Load - Timer1Value on entry), and one of
+ * duration, i.e., how long the handler takes; these are read and reset via
+ * irq_stat.  Both are in ticks of the 24MHz counter, so the latency is only
+ * as precise as the SP804 clock; a latency beyond one period is missed.
+ */
 
-	return s;
-}
+hist_t irqHist[2];
 
-// retrieve the inode count stored in the sblock
-uint32_t getInodeCount(){
-	/*s_block *s = readInSBlock();
-	uint32_t y = s->inode_count;
-	free(s);
-*/
-	uint8_t data[4];
-	disk_rd(0,data,4);
-	uint32_t y = data[0];
-	return y;
-}
+int irqStat(hist_t* x, bool reset) {
+	memcpy(x, irqHist, sizeof(irqHist));
 
-// write an sblock struct to the sblock on disk
-void writeSBlock(s_block *s) {
-	uint8_t write[BLOCK_SIZE];
-    write[0] = s->inode_count;
-	write[4] = s->root_inode;
-	for (int i = 8; i<BLOCK_SIZE; i++){
-		write[i] = 0;
+	if (reset) {
+		hist_reset(&irqHist[IRQ_LAT]);
+		hist_reset(&irqHist[IRQ_DUR]);
 	}
-	if (DISK_SUCCESS == disk_wr(0, write, BLOCK_SIZE)) {
-		PL011_putc(UART1,'S',true);
-	}
-	else { PL011_putc(UART1,'N',true);}
-	free(s);
-}
-
-// increment the inode count in the disk sblock
-void incInodeCount(){
-	s_block *s = readInSBlock();
-	s->inode_count++;
- 	writeSBlock(s);
-}	
 
-extern uint32_t p_stack_space;
-extern void main_console();
+	return 0;
+}
 
 void hilevel_handler_rst( ctx_t* ctx              ) { 
     // Configure interrupt handling mechanism
 
-    TIMER0->Timer1Load  = 0x00001000; // select period
+    TIMER0->Timer1Load  = TIMER0_MHZ * 1000000 / WHEEL_HZ; // select period, i.e., one tick of the timer wheel
 	TIMER0->Timer1Ctrl  = 0x00000002; // select 32-bit   timer
     TIMER0->Timer1Ctrl |= 0x00000040; // select periodic timer
 	TIMER0->Timer1Ctrl |= 0x00000020; // enable          timer interrupt
@@ -293,10 +179,30 @@ void hilevel_handler_rst( ctx_t* ctx              ) {
 	
 	GICC0->PMR          = 0x000000F0; // unmask all            interrupts
 	GICD0->ISENABLER1  |= 0x00000010; // enable timer          interrupt
+	GICD0->ISENABLER1  |= 0x00000020; // enable TIMER1         interrupt, which samples for the profiler
+	GICD0->ISENABLER1  |= 0x00008000; // enable UART3          interrupt, which drains the trace buffer
 	GICC0->CTLR         = 0x00000001; // enable GIC interface
 	GICD0->CTLR         = 0x00000001; // enable GIC distributor
 	
-	int_enable_irq();
+	trace_init(); // start recording events, streamed over UART3
+	svcReset();   // start every system call latency histogram empty
+	hist_reset(&irqHist[IRQ_LAT]); // start the timer interrupt histograms empty
+	hist_reset(&irqHist[IRQ_DUR]);
+	prof_start(0);  // profiler stopped until prof is used
+	perf_init();    // start the PMU cycle counter, and every kernel scope histogram empty
+	wheel_init();   // start with no timers pending
+
+  // Query the disk geometry, size the block cache to match it, then mount the file system
+
+  if (DISK_SUCCESS != disk_init()) {
+	  PL011_putc(UART1,'D',true); // no disk: block I/O will fail
+  }
+  cache_init();
+  if (FS_SUCCESS != fs_mount()) {
+	  PL011_putc(UART1,'F',true); // no file system: open etc. will fail
+  }
+  vm_init(&vm_space_start, &vm_space_end); // enable the MMU, with pages of the mapping window read on demand
+  loader_init(&img_space_start, &img_space_end); // program images are loaded on demand
 
   /* Invalidate all entries in the process table, so it's clear they are not
    * representing valid (i.e., active) processes.
@@ -324,10 +230,21 @@ void hilevel_handler_rst( ctx_t* ctx              ) {
   procTab[ 0 ].ctx.pc   = ( uint32_t )( &main_console );
   procTab[ 0 ].ctx.sp   = procTab[ 0 ].tos;
 
+  fd_init();
+  fd_console( procTab[ 0 ].fd ); // console reads and writes UART0 via descriptors 0 to 2
+
   available_stacks[0] = false; // the top stack area in the stack space is now being used
 
-  // Initialise the feedback queue and start scheduling
-  initMLFS(ctx);
+  memset( &idleProc, 0, sizeof( pcb_t ) ); // initialise idle process, which is never in a queue
+  idleProc.status   = STATUS_READY;
+  idleProc.prty     = PRIORITY_LEVELS;
+  idleProc.ctx.cpsr = 0x50;
+  idleProc.ctx.pc   = ( uint32_t )( &idle );
+  idleProc.ctx.sp   = ( uint32_t )( &idleStack[ 64 ] );
+
+  // Initialise the feedback queue and start scheduling; only now can the timer interrupt schedule, so only now enable it
+  mlfqInit(procTab, MAX_PROCS);
+  int_enable_irq();
   multiLevelFeedbackSchedule(ctx);  
 
   return;
@@ -344,6 +261,70 @@ uint32_t getNextStack(){
 }
 
 
+/* Copy the accounting of up to n valid processes into x, returning how many
+ * were copied: the time the executing process has run since its dispatch,
+ * and a ready process has waited since its enqueue, is included as well.
+ */
+
+int procStat(proc_stat_t* x, int n) {
+	uint32_t now = SYSCONF->COUNTER_24MHZ;
+	int r = 0;
+
+	for (int i = 0; i < MAX_PROCS && r < n; i++) {
+		pcb_t* p = &procTab[i];
+
+		if (p->status == STATUS_INVALID) { continue; }
+
+		x[r].pid    = p->pid;
+		x[r].status = p->status;
+		x[r].prty   = p->prty;
+		x[r].run    = p->acct.run  + ((p == executing)              ? now - p->acct.t_run  : 0);
+		x[r].wait   = p->acct.wait + ((p->status == STATUS_READY)   ? now - p->acct.t_wait : 0);
+		x[r].vcsw   = p->acct.vcsw;
+		x[r].ivcsw  = p->acct.ivcsw;
+		x[r].svcs   = p->acct.svcs;
+		r++;
+	}
+
+	return r;
+}
+
+/* The arguments of exec, i.e., the NULL-terminated array of strings argv,
+ * are copied onto the top of the new stack (via a buffer, since the old
+ * stack, which is discarded, may well hold them); the program is entered
+ * with argc in r0, the copy of argv in r1, and the stack pointer below
+ * them.  Any arguments beyond EXEC_ARGS, or EXEC_ARGS_LEN bytes, or from
+ * the first that cannot be read (see vm_touch), are dropped.  Returns the
+ * stack pointer.
+ */
+
+uint32_t execArgs(ctx_t* ctx, uint32_t tos, char** argv) {
+	char x[EXEC_ARGS_LEN]; uint32_t off[EXEC_ARGS]; int n = 0, len = 0;
+
+	for (; argv != NULL && n < EXEC_ARGS && vm_touch((uint32_t)&argv[n], sizeof(char*), false) && argv[n] != NULL; n++) {
+		if (!vm_touch_str((uint32_t)argv[n], EXEC_ARGS_LEN - len)) { break; }
+
+		int l = strlen(argv[n]) + 1;
+
+		memcpy(x + len, argv[n], l); off[n] = len; len += l;
+	}
+
+	uint32_t  s = (tos - len) & ~3;                     // strings
+	uint32_t* v = (uint32_t*)((s - (n + 1) * 4) & ~7);  // array of pointers to them, 8-byte aligned per the AAPCS
+
+	memcpy((void*)s, x, len);
+
+	for (int i = 0; i < n; i++) {
+		v[i] = s + off[i];
+	}
+	v[n] = 0;
+
+	ctx->gpr[0] = n;
+	ctx->gpr[1] = (uint32_t)v;
+
+	return (uint32_t)v;
+}
+
 void hilevel_handler_svc( ctx_t* ctx, uint32_t id ) { 
   /* Based on the identifier (i.e., the immediate operand) extracted from the
    * svc instruction, 
@@ -353,9 +334,23 @@ void hilevel_handler_svc( ctx_t* ctx, uint32_t id ) {
    * - write any return value back to preserved usr mode registers.
    */
 
+  uint32_t t = SYSCONF->COUNTER_24MHZ; // start of system call, for the latency histogram
+
+  trace( TRACE_SVC_ENTER, id, ( NULL != executing ) ? executing->pid : 0 );
+
+  if( NULL != executing ) {
+    executing->acct.svcs++;
+  }
+
   switch( id ) {
     case 0x00 : { // 0x00 => yield()
+      pcb_t* prev = executing;
+
       multiLevelFeedbackSchedule( ctx );
+
+      if( NULL != prev && executing != prev ) {
+        prev->acct.vcsw++;
+      }
       break;
     }
 
@@ -364,16 +359,32 @@ void hilevel_handler_svc( ctx_t* ctx, uint32_t id ) {
       char*  x = ( char* )( ctx->gpr[ 1 ] );  
       int    n = ( int   )( ctx->gpr[ 2 ] ); 
 
-      for( int i = 0; i < n; i++ ) {
-        PL011_putc( UART0, *x++, true );
+      // console, pipe or file, per the descriptor table of the process; x is paged in first if need be
+      if( !vm_touch( ( uint32_t )( x ), n, false ) ) {
+        ctx->gpr[ 0 ] = FD_FAILURE; break;
+      }
+
+      ctx->gpr[ 0 ] = fd_write( executing->fd, fd, ( const uint8_t* )( x ), n );
+
+      break;
+    }
+
+    case 0x02 : { // 0x02 => read( fd, x, n )
+      int   fd = ( int   )( ctx->gpr[ 0 ] );  
+      char*  x = ( char* )( ctx->gpr[ 1 ] );  
+      int    n = ( int   )( ctx->gpr[ 2 ] ); 
+
+      // whatever is available, without blocking; x is paged in first if need be
+      if( !vm_touch( ( uint32_t )( x ), n, true ) ) {
+        ctx->gpr[ 0 ] = FD_FAILURE; break;
       }
-      
-      ctx->gpr[ 0 ] = n;
+
+      ctx->gpr[ 0 ] = fd_read( executing->fd, fd, ( uint8_t* )( x ), n );
 
       break;
     }
 	
-	case 0x03 : { //0x03 => fork()
+	case 0x03 : { // 0x03 => fork()
 
 	  // print pid of next function
       PL011_putc( UART0, next_pid, true );
@@ -401,6 +412,10 @@ void hilevel_handler_svc( ctx_t* ctx, uint32_t id ) {
   	  procTab[ free_pcb ].status     = STATUS_READY;
  	  procTab[ free_pcb ].prty       = 1;
 	  procTab[ free_pcb ].ctx.gpr[0] = 0; // fork() returns 0 to child process
+	  memset( &procTab[ free_pcb ].acct, 0, sizeof(acct_t) ); // child starts its own accounting
+
+	  // child inherits (i.e., shares) every open descriptor
+	  fd_fork(procTab[free_pcb].fd, executing->fd);
 
 	  // create and place PCB node for new process
 	  enqueue(&mlfq.queues[procTab[free_pcb].prty-1],&procTab[free_pcb]);
@@ -419,9 +434,11 @@ void hilevel_handler_svc( ctx_t* ctx, uint32_t id ) {
 	  break;
 	}
 	
-	case 0x04 : { // 0x04 => exit(success?) 
+	case 0x04 : { // 0x04 => exit( x )
 	  for(int i = 0; i < MAX_PROCS; i++) {
 		if (procTab[i].pid == executing->pid) {
+	      fd_exit( procTab[i].fd ); // close all descriptors
+	      vm_exit( procTab[i].pid ); // unmap all regions
 	      memset( &procTab[i], 0, sizeof(pcb_t) ); // reset PCB
           procTab[i].status = STATUS_INVALID;	// PCB available to be used		
 		}
@@ -431,18 +448,18 @@ void hilevel_handler_svc( ctx_t* ctx, uint32_t id ) {
 	  break;
 	}
 
-	case 0x05 : { // 0x05 => exec(addr)
+	case 0x05 : { // 0x05 => exec( addr, argv )
 	  
 	  // get address of process main function to execute
 	  uint32_t addr = (uint32_t)ctx->gpr[0];
 
  	  ctx->pc = addr;
-	  ctx->sp = executing->tos;
+	  ctx->sp = execArgs(ctx, executing->tos, (char**)ctx->gpr[1]);
 
 	  break;
 	}
 
-	case 0x06 : { // 0x06 => kill(pid, x)
+	case 0x06 : { // 0x06 => kill( pid, x )
 		
 	  int pid = (int)ctx->gpr[0];
 	  int x = (int)ctx->gpr[1];
@@ -450,6 +467,9 @@ void hilevel_handler_svc( ctx_t* ctx, uint32_t id ) {
 	  if (pid == 0) { // terminate all processes except console
 		for (int i = 1; i < MAX_PROCS; i++) {
 		  delPCBNode(&mlfq.queues[procTab[i].prty-1], &procTab[i]); // remove process from queue
+		  wheel_del( &procTab[i].timer ); // cancel wake-up, iff. sleeping
+		  fd_exit( procTab[i].fd ); // close all descriptors
+		  vm_exit( procTab[i].pid ); // unmap all regions
 		  memset( &procTab[i], 0, sizeof(pcb_t) ); // reset PCB
 		  procTab[i].status = STATUS_INVALID;	// PCB available to be used		
 		} 
@@ -460,6 +480,9 @@ void hilevel_handler_svc( ctx_t* ctx, uint32_t id ) {
 		for (int i = 0; i < MAX_PROCS; i++) { 
 		  if (procTab[i].pid == pid) {
 			delPCBNode(&mlfq.queues[procTab[i].prty-1], &procTab[i]); // remove process from queue
+			wheel_del( &procTab[i].timer ); // cancel wake-up, iff. sleeping
+			fd_exit( procTab[i].fd ); // close all descriptors
+			vm_exit( procTab[i].pid ); // unmap all regions
 	  	 	memset( &procTab[i], 0, sizeof(pcb_t) ); // reset PCB
 			procTab[i].status = STATUS_INVALID;	// PCB available to be used		
 		  }
@@ -470,52 +493,294 @@ void hilevel_handler_svc( ctx_t* ctx, uint32_t id ) {
 	  break;
 	}
 	
-	case 0x08 : { // sem_init( id )
+	case 0x08 : { // 0x08 => sem_init( id )
 	  uint32_t* sem = malloc(sizeof(uint32_t));
 	  *sem = ctx->gpr[0];
 	  ctx->gpr[0] = (uint32_t) sem;
 	  break;
 	}
 	
-	case 0x09 : { // sem_close ( *sem )
+	case 0x09 : { // 0x09 => sem_close( *sem )
 	  free((uint32_t*)ctx->gpr[0]);	
 	  break;
 	}
-/*	
-	case 0x10 : { // new_inode
 
+	case 0x0A : { // 0x0A => sync()
+	  ctx->gpr[0] = fs_sync(); // write back all dirty inodes and cached blocks
+	  break;
 	}
-	
-	case 0x11 : { // 
 
+	case 0x0B : { // 0x0B => cache_stat( *x )
+	  cache_stat_t* x = (cache_stat_t*)ctx->gpr[0];
+	  if (!vm_touch((uint32_t)x, sizeof(cache_stat_t), true)) { ctx->gpr[0] = -1; break; }
+	  memcpy(x, &cache_stats, sizeof(cache_stat_t));
+	  ctx->gpr[0] = 0;
+	  break;
+	}
+
+	/* Copy the I/O scheduler counters of both the read and write queues into x.
+	 */
+	case 0x0C : { // 0x0C => ios_stat( *x )
+	  ios_stat_t* x = (ios_stat_t*)ctx->gpr[0];
+	  if (!vm_touch((uint32_t)x, sizeof(ios_stats), true)) { ctx->gpr[0] = -1; break; }
+	  memcpy(x, ios_stats, sizeof(ios_stats));
+	  ctx->gpr[0] = 0;
+	  break;
+	}
+
+	case 0x0D : { // 0x0D => fs_stat( *x )
+	  fs_stat_t* x = (fs_stat_t*)ctx->gpr[0];
+	  if (!vm_touch((uint32_t)x, sizeof(fs_stat_t), true)) { ctx->gpr[0] = -1; break; }
+	  memcpy(x, &fs_stats, sizeof(fs_stat_t));
+	  ctx->gpr[0] = 0;
+	  break;
+	}
+
+	case 0x0E : { // 0x0E => journal_stat( *x )
+	  journal_stat_t* x = (journal_stat_t*)ctx->gpr[0];
+	  if (!vm_touch((uint32_t)x, sizeof(journal_stat_t), true)) { ctx->gpr[0] = -1; break; }
+	  memcpy(x, &journal_stats, sizeof(journal_stat_t));
+	  ctx->gpr[0] = 0;
+	  break;
+	}
+
+	case 0x0F : { // 0x0F => csum_stat( *x )
+	  csum_stat_t* x = (csum_stat_t*)ctx->gpr[0];
+	  if (!vm_touch((uint32_t)x, sizeof(csum_stat_t), true)) { ctx->gpr[0] = -1; break; }
+	  memcpy(x, &csum_stats, sizeof(csum_stat_t));
+	  ctx->gpr[0] = 0;
+	  break;
+	}
+
+	case 0x10 : { // 0x10 => open( path, flags )
+	  if (!vm_touch_str(ctx->gpr[0], FS_PATH_MAX)) { ctx->gpr[0] = -1; break; }
+	  ctx->gpr[0] = fd_open(executing->fd, (const char*)ctx->gpr[0], (int)ctx->gpr[1]);
+	  break;
+	}
+
+	case 0x11 : { // 0x11 => close( fd )
+	  ctx->gpr[0] = fd_close(executing->fd, (int)ctx->gpr[0]);
+	  break;
+	}
+
+	case 0x12 : { // 0x12 => mkdir( path )
+	  if (!vm_touch_str(ctx->gpr[0], FS_PATH_MAX)) { ctx->gpr[0] = -1; break; }
+	  ctx->gpr[0] = fs_mkdir((const char*)ctx->gpr[0]);
+	  break;
+	}
+
+	case 0x13 : { // 0x13 => stat( path, *x )
+	  if (!vm_touch_str(ctx->gpr[0], FS_PATH_MAX) || !vm_touch(ctx->gpr[1], sizeof(fs_info_t), true)) { ctx->gpr[0] = -1; break; }
+	  ctx->gpr[0] = fs_info((const char*)ctx->gpr[0], (fs_info_t*)ctx->gpr[1]);
+	  break;
+	}
+
+	case 0x14 : { // 0x14 => dup( fd )
+	  ctx->gpr[0] = fd_dup(executing->fd, (int)ctx->gpr[0]);
+	  break;
+	}
+
+	/* Open a pipe, setting x[ 0 ] to its read end and x[ 1 ] to its write end.
+	 */
+	case 0x15 : { // 0x15 => pipe( x )
+	  if (!vm_touch(ctx->gpr[0], 2 * sizeof(int), true)) { ctx->gpr[0] = -1; break; }
+	  ctx->gpr[0] = fd_pipe(executing->fd, (int*)ctx->gpr[0]);
+	  break;
+	}
+
+	/* Load the program image at path; return its entry point, for use by exec
+	 * (see loader.h).
+	 */
+	case 0x16 : { // 0x16 => load( path )
+	  if (!vm_touch_str(ctx->gpr[0], FS_PATH_MAX)) { ctx->gpr[0] = 0; break; }
+	  ctx->gpr[0] = (uint32_t)loader_load((const char*)ctx->gpr[0]);
+	  break;
+	}
+
+	/* Map n bytes from offset off of the file fd refers to, privately; return
+	 * the address of the mapping (see vm.h).
+	 */
+	case 0x17 : { // 0x17 => mmap( fd, off, n, prot )
+	  fs_file_t* f = fd_file(executing->fd, (int)ctx->gpr[0]);
+	  ctx->gpr[0] = vm_mmap(executing->pid, f, ctx->gpr[1], ctx->gpr[2], ctx->gpr[3] & 0x2);
+	  break;
+	}
+
+	case 0x18 : { // 0x18 => munmap( addr )
+	  ctx->gpr[0] = vm_unmap(executing->pid, ctx->gpr[0]);
+	  break;
+	}
+
+	/* Copy the accounting of up to n processes into x; return the number
+	 * copied.
+	 */
+	case 0x19 : { // 0x19 => ps( *x, n )
+	  int n = ((int)ctx->gpr[1] < MAX_PROCS) ? (int)ctx->gpr[1] : MAX_PROCS;
+	  if (n > 0 && !vm_touch(ctx->gpr[0], n * sizeof(proc_stat_t), true)) { ctx->gpr[0] = -1; break; }
+	  ctx->gpr[0] = procStat((proc_stat_t*)ctx->gpr[0], n);
+	  break;
+	}
+
+	/* Copy the latency histogram of system call id into x.
+	 */
+	case 0x1A : { // 0x1A => svc_stat( id, *x )
+	  if (!vm_touch(ctx->gpr[1], sizeof(hist_t), true)) { ctx->gpr[0] = -1; break; }
+	  ctx->gpr[0] = svcStat((int)ctx->gpr[0], (hist_t*)ctx->gpr[1]);
+	  break;
+	}
+
+	/* Clear the latency histogram of every system call.
+	 */
+	case 0x1B : { // 0x1B => svc_reset()
+	  svcReset();
+	  break;
+	}
+
+	/* Copy the timer interrupt latency and duration histograms into x, then
+	 * clear them iff. reset.
+	 */
+	case 0x1C : { // 0x1C => irq_stat( *x, reset )
+	  if (!vm_touch(ctx->gpr[0], sizeof(irqHist), true)) { ctx->gpr[0] = -1; break; }
+	  ctx->gpr[0] = irqStat((hist_t*)ctx->gpr[0], (bool)ctx->gpr[1]);
+	  break;
 	}
-	
-	case 0x11 : { // open
 
+	/* Sample the PC at hz samples per second, or stop iff. hz = 0; return the
+	 * rate set (see prof.h).
+	 */
+	case 0x1D : { // 0x1D => prof( hz )
+	  ctx->gpr[0] = prof_start(ctx->gpr[0]);
+	  break;
+	}
+
+	/* Select the event counted by each PMU event counter iff. events != NULL,
+	 * then copy every counter into x; return the number of event counters
+	 * (see perf.h).
+	 */
+	case 0x1E : { // 0x1E => pmu( *x, *events )
+	  if (!vm_touch(ctx->gpr[0], sizeof(perf_pmu_t), true) || !vm_touch(ctx->gpr[1], (0 != ctx->gpr[1]) ? PMU_EVENTS * sizeof(uint32_t) : 0, false)) { ctx->gpr[0] = -1; break; }
+	  ctx->gpr[0] = perf_read((perf_pmu_t*)ctx->gpr[0], (const uint32_t*)ctx->gpr[1]);
+	  break;
+	}
+
+	/* Copy the cycle histogram of kernel scope id into x, then clear it iff.
+	 * reset.
+	 */
+	case 0x1F : { // 0x1F => pmu_stat( id, *x, reset )
+	  if (!vm_touch(ctx->gpr[1], sizeof(hist_t), true)) { ctx->gpr[0] = -1; break; }
+	  ctx->gpr[0] = perf_stat((int)ctx->gpr[0], (hist_t*)ctx->gpr[1], (bool)ctx->gpr[2]);
+	  break;
+	}
+
+	/* Park the process for ms ms (at most 2^31 - 1); return the time of wake-up,
+	 * in ms.
+	 */
+	case 0x20 : { // 0x20 => sleep_ms( ms )
+	  uint32_t ms = ctx->gpr[0];
+	  sleepUntil(ctx, wheel.now + ((ms > INT32_MAX) ? INT32_MAX : ms) * (WHEEL_HZ / 1000));
+	  break;
+	}
+
+	/* Park the process until time t, in ms; return the time of wake-up, in ms.
+	 */
+	case 0x21 : { // 0x21 => sleep_until( t )
+	  sleepUntil(ctx, ctx->gpr[0] * (WHEEL_HZ / 1000));
+	  break;
 	}
 
-	case 0x10 : { // mkdir
+	/* Return the time since reset, in ms.
+	 */
+	case 0x22 : { // 0x22 => clock_ms()
+	  ctx->gpr[0] = wheel.now / (WHEEL_HZ / 1000);
+	  break;
+	}
 
+	case 0x23 : { // 0x23 => loader_stat( *x )
+	  loader_stat_t* x = (loader_stat_t*)ctx->gpr[0];
+	  if (!vm_touch((uint32_t)x, sizeof(loader_stat_t), true)) { ctx->gpr[0] = -1; break; }
+	  memcpy(x, &loader_stats, sizeof(loader_stat_t));
+	  ctx->gpr[0] = 0;
+	  break;
 	}
-*/
+
+	case 0x24 : { // 0x24 => vm_stat( *x )
+	  vm_stat_t* x = (vm_stat_t*)ctx->gpr[0];
+	  if (!vm_touch((uint32_t)x, sizeof(vm_stat_t), true)) { ctx->gpr[0] = -1; break; }
+	  memcpy(x, &vm_stats, sizeof(vm_stat_t));
+	  ctx->gpr[0] = 0;
+	  break;
+	}
+
+	case 0x25 : { // 0x25 => trace_stat( *x )
+	  trace_stat_t* x = (trace_stat_t*)ctx->gpr[0];
+	  if (!vm_touch((uint32_t)x, sizeof(trace_stat_t), true)) { ctx->gpr[0] = -1; break; }
+	  memcpy(x, &trace_stats, sizeof(trace_stat_t));
+	  ctx->gpr[0] = 0;
+	  break;
+	}
+
+	case 0x26 : { // 0x26 => prof_stat( *x )
+	  prof_stat_t* x = (prof_stat_t*)ctx->gpr[0];
+	  if (!vm_touch((uint32_t)x, sizeof(prof_stat_t), true)) { ctx->gpr[0] = -1; break; }
+	  memcpy(x, &prof_stats, sizeof(prof_stat_t));
+	  ctx->gpr[0] = 0;
+	  break;
+	}
+
     default   : {
       break;
     }
   }
 
+  if( id < SVC_IDS ) {
+    hist_add( &svcHist[ id ], SYSCONF->COUNTER_24MHZ - t );
+  }
+
+  trace( TRACE_SVC_EXIT, id, ( NULL != executing ) ? executing->pid : 0 );
+
   return;
 }
 
 void hilevel_handler_irq(ctx_t* ctx) {
+   // Sample the timer and counter first, so the latency and duration of a timer interrupt are as accurate as possible.
+
+   uint32_t v = TIMER0->Timer1Value, t = SYSCONF->COUNTER_24MHZ;
+
    // Read  the interrupt identifier so we know the source.
 
    uint32_t id = GICC0->IAR;
 
-   // Handle the interrupt, then clear source.
+   // Handle the interrupt, then clear source; UART3 is not traced, since it transmits the trace, nor TIMER1, since it samples.
+
+   if( id != GIC_SOURCE_UART3 && id != GIC_SOURCE_TIMER1 ) {
+	   trace( TRACE_IRQ_ENTER, 0, id );
+   }
 
    if( id == GIC_SOURCE_TIMER0 ) {
-	   multiLevelFeedbackSchedule(ctx);
+	   wheel_tick(); // may wake a process
+
+	   // invoke scheduler every SCHED_TICKS ticks, or at once if idle
+	   if (++schedTick >= SCHED_TICKS || executing == &idleProc) {
+		   pcb_t* prev = executing;
+		   schedTick = 0;
+		   multiLevelFeedbackSchedule(ctx);
+		   if (prev != NULL && prev != &idleProc && executing != prev) { prev->acct.ivcsw++; } // preempted
+	   }
 	   TIMER0->Timer1IntClr = 0x01;
+	   hist_add(&irqHist[IRQ_LAT], (TIMER0->Timer1Load - v) * (24 / TIMER0_MHZ));
+   }
+   else if( id == GIC_SOURCE_TIMER1 ) {
+	   prof_sample( ctx->pc, ctx->cpsr, ( NULL != executing ) ? executing->pid : 0 );
+   }
+   else if( id == GIC_SOURCE_UART3 ) {
+	   trace_drain();
+   }
+
+   if( id != GIC_SOURCE_UART3 && id != GIC_SOURCE_TIMER1 ) {
+	   trace( TRACE_IRQ_EXIT, 0, id );
+   }
+   if( id == GIC_SOURCE_TIMER0 ) {
+	   hist_add(&irqHist[IRQ_DUR], SYSCONF->COUNTER_24MHZ - t);
    }
 
    // Write to the interrupt identifier to signal we're done.
@@ -524,3 +789,35 @@ void hilevel_handler_irq(ctx_t* ctx) {
 
    return;
 }
+
+/* An abort is either a first access to a page of the mapping window, which
+ * is read in so the access can be retried, or an invalid access: the process
+ * that made it is then terminated, as if it had called exit.  An invalid
+ * access by the kernel itself is a bug, so halts the processor as before.
+ */
+
+void handleAbort(ctx_t* ctx, uint32_t addr, bool write) {
+	if (vm_fault(addr, write)) {
+		return;
+	}
+
+	if ((ctx->cpsr & 0x1F) != 0x10) {
+		PL011_putc(UART1, 'A', true);
+		while (1) {}
+	}
+
+	fd_exit( executing->fd ); // close all descriptors
+	vm_exit( executing->pid ); // unmap all regions
+	memset( executing, 0, sizeof(pcb_t) ); // reset PCB
+	executing->status = STATUS_INVALID; // PCB available to be used
+	executing = NULL;
+	multiLevelFeedbackSchedule(ctx);
+}
+
+void hilevel_handler_pab(ctx_t* ctx) {
+	handleAbort(ctx, mmu_get_ifar(), false);
+}
+
+void hilevel_handler_dab(ctx_t* ctx) {
+	handleAbort(ctx, mmu_get_dfar(), mmu_get_dfsr() & 0x800); // DFSR[ WnR ] = 1 => write
+}
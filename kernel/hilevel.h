@@ -21,72 +21,44 @@
 #include   "GIC.h"
 #include "PL011.h"
 #include "SP804.h"
+#include   "SYS.h"
 #include "disk.h"
 
 // Include functionality relating to the   kernel.
 
 #include "lolevel.h"
 #include "int.h"
-
-/* The kernel source code is made simpler and more consistent by using 
- * some human-readable type definitions:
- *
- * - a type that captures a Process IDentifier (PID), which is really
- *   just an integer,
- * - an enumerated type that captures the status of a process, e.g.,
- *   whether it is currently executing,
- * - a type that captures each component of an execution context (i.e.,
- *   processor state) in a compatible order wrt. the low-level handler
- *   preservation and restoration prologue and epilogue, and
- * - a type that captures a process PCB.
- */
-
-#define MAX_PROCS 20 
-#define PRIORITY_LEVELS 3
-#define STACK_SIZE 0x1000
-#define BLOCK_SIZE 512
-
-typedef int pid_t;
-typedef int prty_t;
-
-typedef enum { 
-  STATUS_INVALID,
-
-  STATUS_CREATED,
-  STATUS_TERMINATED,
-
-  STATUS_READY,
-  STATUS_EXECUTING,
-  STATUS_WAITING
-} status_t;
-
-typedef struct {
-  uint32_t cpsr, pc, gpr[ 13 ], sp, lr;
-} ctx_t;
-
-typedef struct {
-     pid_t    pid; // Process IDentifier (PID)
-  status_t status; // current status
-  uint32_t    tos; // address of Top of Stack (ToS)
-     ctx_t    ctx; // execution context
-    prty_t   prty; // priority level of process
-} pcb_t;
-
-typedef struct node { 
-	pcb_t* pcb;
-	struct node* next;
-} node;
-
-typedef struct queue {
-    node* head;
-    node* tail;
-} queue;
-
+#include "cache.h"
+#include "fs.h"
+#include "fd.h"
+#include "loader.h"
+#include "vm.h"
+#include "trace.h"
+#include "hist.h"
+#include "prof.h"
+#include "perf.h"
+#include "proc.h"
+#include "sched.h"
+
+#define SVC_IDS 48 // system call identifiers with a latency histogram
+#define EXEC_ARGS 16 // arguments passed by exec, at most
+#define EXEC_ARGS_LEN 256 // bytes of arguments (including terminators) passed by exec, at most
+#define TIMER0_MHZ 1 // SP804 clock frequency, i.e., of Timer1Value
+#define SCHED_TICKS 4 // timer wheel ticks per time slice
+
+#define IRQ_LAT 0 // timer interrupt histogram of latency,  i.e., from expiry to handler
+#define IRQ_DUR 1 // timer interrupt histogram of duration, i.e., of handler
+
+// accounting of one process, as copied to user space by ps
 typedef struct {
-    queue queues[PRIORITY_LEVELS];
-	int queueTime[PRIORITY_LEVELS];
-	int timeCount;
-} mlf_queues;
-
+  uint32_t    pid;
+  uint32_t status;
+  uint32_t   prty;
+  uint64_t    run;
+  uint64_t   wait;
+  uint32_t   vcsw;
+  uint32_t  ivcsw;
+  uint32_t   svcs;
+} proc_stat_t;
 
 #endif
@@ -0,0 +1,25 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#include "hist.h"
+
+void hist_reset( hist_t* h ) {
+  memset( h, 0, sizeof( hist_t ) );
+
+  h->min = UINT32_MAX;
+}
+
+void hist_add( hist_t* h, uint32_t x ) {
+  int k = ( x == 0 ) ? 0 : 32 - __builtin_clz( x );
+
+  h->bucket[ k ]++;
+  h->count++;
+  h->sum += x;
+
+  h->min = ( x < h->min ) ? x : h->min;
+  h->max = ( x > h->max ) ? x : h->max;
+}
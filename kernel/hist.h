@@ -0,0 +1,44 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#ifndef __HIST_H
+#define __HIST_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string.h>
+
+/* A histogram of durations (or any other unsigned quantity), with buckets
+ * whose bounds are powers of two: bucket 0 counts the value 0 and bucket
+ * k > 0 the values 2^( k - 1 ) to 2^k - 1, so 33 buckets cover every
+ * 32-bit value with a relative error of at most a factor of 2.  Adding a
+ * value costs one CLZ plus a few loads and stores, whatever the value, so
+ * a histogram can be kept on a hot path such as system call dispatch.
+ *
+ * The exact minimum, maximum and sum are kept alongside, so the mean is
+ * exact, and a percentile can be bounded by the bucket it falls in.  The
+ * layout is mirrored by user/libc.h, for copying to user space.
+ */
+
+#define HIST_BUCKETS ( 33 )
+
+typedef struct {
+  uint32_t count;                   // values added
+  uint32_t min;                     // smallest value added (UINT32_MAX iff. none)
+  uint32_t max;                     // largest  value added
+  uint64_t sum;                     // sum of values added
+  uint32_t bucket[ HIST_BUCKETS ];  // number of values in each bucket
+} hist_t;
+
+// forget every value added to histogram h
+extern void hist_reset( hist_t* h );
+// add value x to histogram h
+extern void hist_add( hist_t* h, uint32_t x );
+
+#endif
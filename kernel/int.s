@@ -9,7 +9,8 @@
  * copy it into place (which is called on reset): note that 
  * 
  * - for interrupts we don't handle, an infinite loop is realised (that
- *   approximates halting the processor), and
+ *   approximates halting the processor), whereas aborts are handled so
+ *   pages of the mapping window can be read in on demand, and
  * - we copy the table itself, *and* the associated addresses stored as
  *   static data: this preserves the relative offset between each ldr
  *   instruction and wherever it loads from.
@@ -18,14 +19,16 @@
 int_data:            ldr   pc, int_addr_rst        @ reset                 vector -> SVC mode
                      b     .                       @ undefined instruction vector -> UND mode
                      ldr   pc, int_addr_svc        @ supervisor call       vector -> SVC mode
-                     b     .                       @ pre-fetch abort       vector -> ABT mode
-                     b     .                       @      data abort       vector -> ABT mode
+                     ldr   pc, int_addr_pab        @ pre-fetch abort       vector -> ABT mode
+                     ldr   pc, int_addr_dab        @      data abort       vector -> ABT mode
                      b     .                       @ reserved
                      ldr   pc, int_addr_irq        @ IRQ                   vector -> IRQ mode
                      b     .                       @ FIQ                   vector -> FIQ mode
 
 int_addr_rst:        .word lolevel_handler_rst
 int_addr_svc:        .word lolevel_handler_svc
+int_addr_pab:        .word lolevel_handler_pab
+int_addr_dab:        .word lolevel_handler_dab
 int_addr_irq:        .word lolevel_handler_irq
 	
 .global int_init
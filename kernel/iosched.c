@@ -0,0 +1,197 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#include "iosched.h"
+
+ios_req_t  ios_reqs[ IOS_REQS ];      // request pool
+ios_req_t* ios_free = NULL;           // free list of unused requests
+ios_req_t* ios_queue[ 2 ];            // queued requests, sorted by address
+uint32_t   ios_head;                  // address following the last dispatch
+uint32_t   ios_clock;                 // dispatch count, used for deadlines
+ios_stat_t ios_stats[ 2 ];            // per-queue statistics
+
+static void dispatch_req( ios_dir_t d, ios_req_t* q );
+
+void ios_init() {
+  memset( ios_stats, 0, sizeof( ios_stats ) );
+
+  ios_queue[ IOS_RD ] = NULL;
+  ios_queue[ IOS_WR ] = NULL;
+  ios_free            = NULL;
+  ios_head            = 0;
+  ios_clock           = 0;
+
+  for( int i = 0; i < IOS_REQS; i++ ) {
+    ios_reqs[ i ].next = ios_free; ios_free = &ios_reqs[ i ];
+  }
+}
+
+// remove request q from queue d
+static void unlink_req( ios_dir_t d, ios_req_t* q ) {
+  ios_req_t** p = &ios_queue[ d ];
+
+  while( *p != q ) {
+    p = &( *p )->next;
+  }
+
+  *p = q->next; ios_stats[ d ].depth--;
+}
+
+// select the request to dispatch next from queue d, or NULL if it is empty
+static ios_req_t* select_req( ios_dir_t d ) {
+  ios_req_t* r = NULL;
+
+  // any expired request is served first, oldest first ...
+  for( ios_req_t* q = ios_queue[ d ]; q != NULL; q = q->next ) {
+    if( ( int32_t )( ios_clock - q->expire ) >= 0 && ( r == NULL || ( int32_t )( q->expire - r->expire ) < 0 ) ) {
+      r = q;
+    }
+  }
+  if( r != NULL ) {
+    if( r->addr < ios_head ) {
+      ios_stats[ d ].expired++;
+    }
+    return r;
+  }
+
+  // ... otherwise continue the sweep upward from the head, or wrap around
+  for( ios_req_t* q = ios_queue[ d ]; q != NULL; q = q->next ) {
+    if( q->addr >= ios_head ) {
+      return q;
+    }
+  }
+
+  return ios_queue[ d ];
+}
+
+static void dispatch_req( ios_dir_t d, ios_req_t* q ) {
+  int r;
+
+  unlink_req( d, q );
+
+  if( d == IOS_RD ) {
+    r = disk_rdv( q->addr, q->x, disk_block_len, q->count );
+  }
+  else {
+    r = disk_wrv( q->addr, ( const uint8_t** )( q->x ), disk_block_len, q->count );
+  }
+
+  ios_head = q->addr + q->count;
+  ios_clock++;
+
+  ios_stats[ d ].dispatched++;
+  ios_stats[ d ].blocks += q->count;
+  ios_stats[ d ].errors += ( r != DISK_SUCCESS ) ? 1 : 0;
+
+  for( int i = 0; i < q->count; i++ ) {
+    q->done[ i ]( q->tag[ i ], r );
+  }
+
+  q->next = ios_free; ios_free = q;
+}
+
+// try to merge block a into a queued request of queue d
+static bool merge_req( ios_dir_t d, uint32_t a, uint8_t* x, ios_done_t done, void* tag ) {
+  for( ios_req_t* q = ios_queue[ d ]; q != NULL; q = q->next ) {
+    if( q->count >= DISK_BATCH ) {
+      continue;
+    }
+
+    if     ( a == q->addr + q->count ) {     // back  merge
+      q->x   [ q->count ] = x;
+      q->done[ q->count ] = done;
+      q->tag [ q->count ] = tag;
+    }
+    else if( a + 1 == q->addr ) {            // front merge
+      memmove( &q->x   [ 1 ], &q->x   [ 0 ], q->count * sizeof( q->x   [ 0 ] ) );
+      memmove( &q->done[ 1 ], &q->done[ 0 ], q->count * sizeof( q->done[ 0 ] ) );
+      memmove( &q->tag [ 1 ], &q->tag [ 0 ], q->count * sizeof( q->tag [ 0 ] ) );
+
+      q->x   [ 0 ] = x;
+      q->done[ 0 ] = done;
+      q->tag [ 0 ] = tag;
+      q->addr      = a;
+    }
+    else {
+      continue;
+    }
+
+    q->count++; ios_stats[ d ].merged++;
+
+    return true;
+  }
+
+  return false;
+}
+
+void ios_submit( ios_dir_t d, uint32_t a, uint8_t* x, ios_done_t done, void* tag ) {
+  ios_stats[ d ].submitted++;
+
+  if( merge_req( d, a, x, done, tag ) ) {
+    return;
+  }
+
+  // no free request: make room by dispatching from the fuller queue
+  if( ios_free == NULL ) {
+    ios_dir_t e = ( ios_stats[ IOS_RD ].depth > ios_stats[ IOS_WR ].depth ) ? IOS_RD : IOS_WR;
+    dispatch_req( e, select_req( e ) );
+  }
+
+  ios_req_t* q = ios_free; ios_free = q->next;
+
+  q->addr      = a;
+  q->count     = 1;
+  q->expire    = ios_clock + ( ( d == IOS_RD ) ? IOS_RD_EXPIRE : IOS_WR_EXPIRE );
+  q->x   [ 0 ] = x;
+  q->done[ 0 ] = done;
+  q->tag [ 0 ] = tag;
+
+  // insert in address order
+  ios_req_t** p = &ios_queue[ d ];
+
+  while( *p != NULL && ( *p )->addr < a ) {
+    p = &( *p )->next;
+  }
+
+  q->next = *p; *p = q;
+
+  if( ++ios_stats[ d ].depth > ios_stats[ d ].max_depth ) {
+    ios_stats[ d ].max_depth = ios_stats[ d ].depth;
+  }
+}
+
+static bool wr_due( bool f ) {
+  if( ios_queue[ IOS_WR ] == NULL ) {
+    return false;
+  }
+  if( f || ios_stats[ IOS_WR ].depth >= IOS_WR_DEPTH ) {
+    return true;
+  }
+
+  for( ios_req_t* q = ios_queue[ IOS_WR ]; q != NULL; q = q->next ) {
+    if( ( int32_t )( ios_clock - q->expire ) >= 0 ) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void ios_run( bool f ) {
+  while( true ) {
+    if( wr_due( f ) ) {
+      // an expired write goes ahead of reads, as does a full write queue
+      dispatch_req( IOS_WR, select_req( IOS_WR ) );
+    }
+    else if( ios_queue[ IOS_RD ] != NULL ) {
+      dispatch_req( IOS_RD, select_req( IOS_RD ) );
+    }
+    else {
+      break;
+    }
+  }
+}
@@ -0,0 +1,81 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#ifndef __IOSCHED_H
+#define __IOSCHED_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string.h>
+
+#include "disk.h"
+
+/* Block requests from the cache are not sent to the disk in the order
+ * they are made, but are queued by an elevator-style I/O scheduler:
+ *
+ * - there is one queue for reads and one for writes, each sorted by block
+ *   address, and a request for a block adjacent to one already queued (in
+ *   the same direction) is merged into it, up to DISK_BATCH blocks, so it
+ *   is dispatched as a single vectored transfer,
+ * - requests are dispatched in ascending address order from the current
+ *   head position, wrapping around to the lowest address (i.e., C-SCAN),
+ * - reads are preferred, since a process is waiting for them, while
+ *   writes are held back until there are IOS_WR_DEPTH of them or a sync,
+ * - each request has a deadline, measured in dispatches: once a request
+ *   has expired it is dispatched next regardless of its address, so no
+ *   request starves behind a stream of others.
+ *
+ * Each block carries a completion function and tag, so the submitter is
+ * told the outcome of the transfer into or out of its buffer.
+ */
+
+#define IOS_REQS        ( 32 )
+#define IOS_WR_DEPTH    ( 16 )
+#define IOS_RD_EXPIRE   (  8 )
+#define IOS_WR_EXPIRE   ( 64 )
+
+typedef enum { IOS_RD, IOS_WR } ios_dir_t;
+
+typedef void ( *ios_done_t )( void* tag, int r );
+
+typedef struct ios_req {
+  uint32_t        addr;                 // first block address
+  int             count;                // number of (consecutive) blocks
+  uint32_t        expire;               // dispatch count at which request expires
+
+  uint8_t*        x[ DISK_BATCH ];      // buffer     for each block
+  ios_done_t      done[ DISK_BATCH ];   // completion for each block
+  void*           tag[ DISK_BATCH ];    // completion argument for each block
+
+  struct ios_req* next;                 // next request in address order
+} ios_req_t;
+
+typedef struct {
+  uint32_t submitted;                   // blocks submitted
+  uint32_t merged;                      // blocks merged into a queued request
+  uint32_t dispatched;                  // requests sent to the disk
+  uint32_t blocks;                      // blocks   sent to the disk
+  uint32_t expired;                     // requests dispatched out of order by deadline
+  uint32_t errors;                      // requests that failed
+  uint32_t depth;                       // requests currently queued
+  uint32_t max_depth;                   // high-water mark of depth
+} ios_stat_t;
+
+extern ios_stat_t ios_stats[ 2 ];       // indexed by ios_dir_t
+
+// initialise the scheduler, i.e., empty both queues
+extern void ios_init();
+
+// queue a transfer of block a to/from buffer x; done( tag, r ) is called once dispatched
+extern void ios_submit( ios_dir_t d, uint32_t a, uint8_t* x, ios_done_t done, void* tag );
+
+// dispatch queued reads (and any writes that are due); dispatch all writes iff. f = true
+extern void ios_run( bool f );
+
+#endif
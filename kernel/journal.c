@@ -0,0 +1,200 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#include "journal.h"
+
+uint32_t       journal_start = 0;       // first block of journal
+uint32_t       journal_len   = 0;       // number of blocks in journal, or 0 if there is none
+uint32_t       journal_seq   = 0;       // sequence number of running transaction
+cache_buf_t*   journal_txn[ JOURNAL_TXN_MAX ]; // buffers in running transaction
+int            journal_count = 0;       // number of buffers in running transaction
+int            journal_errors;          // failed writes during a commit
+journal_stat_t journal_stats;
+
+// descriptor or commit record being written or read
+uint8_t        journal_buf[ DISK_BLOCK_LEN_MAX ] __attribute__( ( aligned( 8 ) ) );
+
+// the largest number of blocks a transaction can hold
+static int journal_max() {
+  int m = JOURNAL_TXN_MAX;
+
+  m = ( m > ( int )( journal_len ) - 2 ) ? ( int )( journal_len ) - 2 : m;
+  m = ( m > ( int )( ( disk_block_len - sizeof( journal_header ) ) / 4 ) ) ? ( int )( ( disk_block_len - sizeof( journal_header ) ) / 4 ) : m;
+  m = ( m > cache_blocks / 2 ) ? cache_blocks / 2 : m;
+
+  return m;
+}
+
+// the number of blocks a transaction can hold before it must be committed, leaving space for any checksum table blocks
+static int journal_room() {
+  return csum_enabled() ? journal_max() / 2 : journal_max();
+}
+
+static void journal_done( void* tag, int r ) {
+  if( r != DISK_SUCCESS ) {
+    journal_errors++;
+  }
+}
+
+// fill journal_buf with a header of type t for the running transaction
+static journal_header* journal_header_init( uint32_t t ) {
+  journal_header* h = ( journal_header* )( journal_buf );
+
+  memset( journal_buf, 0, disk_block_len );
+
+  h->j_magic = FS_JOURNAL_MAGIC;
+  h->j_type  = t;
+  h->j_seq   = journal_seq;
+  h->j_count = journal_count;
+
+  return h;
+}
+
+void journal_init( uint32_t s, uint32_t len, uint32_t q ) {
+  for( int i = 0; i < journal_count; i++ ) {
+    cache_pin( journal_txn[ i ], false );
+  }
+
+  journal_start = s;
+  journal_len   = ( len > 2 ) ? len : 0;
+  journal_seq   = q + 1;
+  journal_count = 0;
+
+  memset( &journal_stats, 0, sizeof( journal_stats ) );
+}
+
+int journal_replay( uint32_t s, uint32_t len, uint32_t* q ) {
+  journal_header* h = ( journal_header* )( journal_buf );
+  uint32_t        a[ JOURNAL_TXN_MAX ], n;
+
+  *q = 0;
+
+  if( len <= 2 || DISK_SUCCESS != disk_rd( s, journal_buf, disk_block_len ) ) {
+    return ( len <= 2 ) ? DISK_SUCCESS : DISK_FAILURE;
+  }
+  if( h->j_magic != FS_JOURNAL_MAGIC || h->j_type != FS_JOURNAL_DESC || h->j_count > JOURNAL_TXN_MAX || h->j_count + 2 > len ) {
+    return DISK_SUCCESS;  // the journal was never used
+  }
+
+  *q = h->j_seq; n = h->j_count;
+
+  memcpy( a, journal_buf + sizeof( journal_header ), n * sizeof( uint32_t ) );
+
+  // without a matching commit record the transaction never happened
+  if( DISK_SUCCESS != disk_rd( s + 1 + n, journal_buf, disk_block_len ) ) {
+    return DISK_FAILURE;
+  }
+  if( h->j_magic != FS_JOURNAL_MAGIC || h->j_type != FS_JOURNAL_COMMIT || h->j_seq != *q || h->j_count != n ) {
+    return DISK_SUCCESS;
+  }
+
+  for( uint32_t i = 0; i < n; i++ ) {
+    cache_buf_t* b;
+
+    if( DISK_SUCCESS != disk_rd( s + 1 + i, journal_buf, disk_block_len ) || NULL == ( b = cache_new( a[ i ] ) ) ) {
+      return DISK_FAILURE;
+    }
+
+    memcpy( b->data, journal_buf, disk_block_len );
+  }
+
+  journal_stats.replays++;
+
+  return cache_sync();
+}
+
+bool journal_fits( int n ) {
+  return journal_len == 0 || journal_count + n <= journal_room();
+}
+
+void journal_access( cache_buf_t* b ) {
+  cache_wait( b );
+}
+
+void journal_dirty( cache_buf_t* b ) {
+  cache_dirty( b );
+
+  if( journal_len == 0 || b->pinned ) {
+    return;
+  }
+
+  // only an operation too large for any transaction finds it full: b stays pinned while the rest commits, so is never written home uncommitted
+  cache_pin( b, true );
+
+  if( journal_count >= journal_room() ) {
+    journal_commit();
+  }
+
+  // if the commit failed, b is left to be written back like any other block
+  if( journal_count < journal_room() ) {
+    journal_txn[ journal_count++ ] = b;
+  }
+  else {
+    cache_pin( b, false );
+  }
+}
+
+int journal_commit() {
+  journal_header* h;
+
+  if( journal_len == 0 || journal_count == 0 ) {
+    return cache_sync();
+  }
+
+  journal_errors = 0;
+
+  // 0. checksums, whose table blocks join the transaction
+  for( int i = 0, n = journal_count; i < n; i++ ) {
+    cache_buf_t* t;
+
+    if( DISK_SUCCESS != csum_set( journal_txn[ i ]->addr, journal_txn[ i ]->data, &t ) ) {
+      return DISK_FAILURE;
+    }
+    if( t != NULL && !t->pinned ) {
+      cache_dirty( t ); cache_pin( t, true ); journal_txn[ journal_count++ ] = t;
+    }
+  }
+
+  // 1. descriptor and blocks, plus any dirty data blocks
+  h = journal_header_init( FS_JOURNAL_DESC );
+
+  for( int i = 0; i < journal_count; i++ ) {
+    ( ( uint32_t* )( h + 1 ) )[ i ] = journal_txn[ i ]->addr;
+  }
+
+  ios_submit( IOS_WR, journal_start, journal_buf, &journal_done, NULL );
+
+  for( int i = 0; i < journal_count; i++ ) {
+    ios_submit( IOS_WR, journal_start + 1 + i, journal_txn[ i ]->data, &journal_done, NULL );
+  }
+
+  if( DISK_SUCCESS != cache_sync() || journal_errors != 0 ) {
+    return DISK_FAILURE;
+  }
+
+  // 2. commit record
+  journal_header_init( FS_JOURNAL_COMMIT );
+
+  ios_submit( IOS_WR, journal_start + 1 + journal_count, journal_buf, &journal_done, NULL );
+  ios_run( true );
+
+  if( journal_errors != 0 ) {
+    return DISK_FAILURE;
+  }
+
+  // 3. checkpoint
+  for( int i = 0; i < journal_count; i++ ) {
+    cache_pin( journal_txn[ i ], false );
+  }
+
+  journal_stats.commits++;
+  journal_stats.blocks += journal_count;
+
+  journal_count = 0; journal_seq++;
+
+  return cache_sync();
+}
@@ -0,0 +1,77 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#ifndef __JOURNAL_H
+#define __JOURNAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string.h>
+
+#include "disk.h"
+#include "cache.h"
+#include "csum.h"
+#include "fs_layout.h"
+
+/* The journal makes metadata updates crash-consistent: rather than being
+ * written back one block at a time whenever the cache sees fit, a block
+ * of metadata modified via journal_dirty joins the running transaction,
+ * and is pinned in the cache until that transaction commits.  A commit
+ *
+ * 1. writes a descriptor, plus a copy of every block in the transaction,
+ *    into the journal region (i.e., one sequential run of blocks, which
+ *    the I/O scheduler merges into a few large requests), together with
+ *    any dirty data blocks (so metadata never refers to stale data),
+ * 2. writes the commit record, once all of the above is on the disk,
+ * 3. writes each block home, i.e., checkpoints the transaction, before
+ *    the journal region can be reused.
+ *
+ * If the system dies before step 2 the transaction is simply lost, and
+ * after it the transaction is replayed by journal_replay at mount, so in
+ * either case the metadata on the disk is consistent.  One transaction
+ * collects the updates of many operations, so a block updated over and
+ * over (e.g., a bitmap or the superblock) is written once per commit.
+ * A transaction is committed by fs_sync, or before an operation if the
+ * blocks it may modify might not fit (per journal_fits), i.e., take more
+ * than the journal (or half the cache) can, so an operation is never split
+ * between two transactions.  A block is passed to journal_access before
+ * it is modified, since a write-back queued for it earlier would otherwise
+ * carry the modification home before the transaction commits.
+ *
+ * If checksums are in use, the commit first updates the checksum of each
+ * block in the transaction, and the table blocks this modifies join it;
+ * at most one table block is needed per block, so a transaction is then
+ * committed once it fills half of the space.
+ */
+
+#define JOURNAL_TXN_MAX ( 64 )
+
+typedef struct {
+  uint32_t commits;                 // transactions committed
+  uint32_t blocks;                  // blocks written via the journal
+  uint32_t replays;                 // transactions replayed at mount
+} journal_stat_t;
+
+extern journal_stat_t journal_stats;
+
+// use the len blocks from address s onward as the journal (or none, iff. len = 0), numbering transactions after q
+extern void journal_init( uint32_t s, uint32_t len, uint32_t q );
+// replay the committed transaction (if any) in the journal of len blocks from address s onward; its sequence number is returned via q
+extern int  journal_replay( uint32_t s, uint32_t len, uint32_t* q );
+
+// return true iff. n more blocks fit in the running transaction (or there is no journal), i.e., it need not be committed first
+extern bool journal_fits( int n );
+// prepare buffer b, which holds a metadata block, to be modified, i.e., send any write-back queued for it
+extern void journal_access( cache_buf_t* b );
+// add buffer b, which holds a modified metadata block, to the running transaction
+extern void journal_dirty( cache_buf_t* b );
+// commit the running transaction, and write any other dirty buffer back to the disk
+extern int  journal_commit();
+
+#endif
@@ -0,0 +1,333 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#include "loader.h"
+
+#define LOADER_PHDRS  ( 12 )
+#define LOADER_DYNS   ( 32 )
+
+loader_image_t loader_images[ LOADER_IMAGES ];
+loader_stat_t  loader_stats;
+
+uint8_t* loader_next = NULL;             // first unused byte of image space
+uint8_t* loader_end  = NULL;             // end of image space
+
+void loader_init( void* start, void* end ) {
+  loader_next = ( uint8_t* )( start );
+  loader_end  = ( uint8_t* )( end );
+
+  memset( loader_images, 0, sizeof( loader_images ) );
+  memset( &loader_stats,  0, sizeof( loader_stats   ) );
+}
+
+// read n bytes at offset off of file f into x; return true iff. they were all read
+static bool read_at( fs_file_t* f, uint32_t off, void* x, uint32_t n ) {
+  f->off = off;
+
+  return ( int )( n ) == fs_read( f, ( uint8_t* )( x ), n );
+}
+
+// check that the n bytes at offset off lie within an image of size bytes
+static bool within( uint32_t off, uint32_t n, uint32_t size ) {
+  return off <= size && n <= size - off;
+}
+
+// apply the relocations listed by the dynamic segment at offset off, of n bytes, in the image at base
+static bool relocate( uint8_t* base, uint32_t size, uint32_t off, uint32_t n ) {
+  uint32_t rel = 0, relsz = 0, relent = sizeof( elf32_rel );
+
+  for( elf32_dyn* d = ( elf32_dyn* )( base + off ); n >= sizeof( elf32_dyn ) && d->d_tag != DT_NULL; d++, n -= sizeof( elf32_dyn ) ) {
+    switch( d->d_tag ) {
+      case DT_REL    : rel    = d->d_val; break;
+      case DT_RELSZ  : relsz  = d->d_val; break;
+      case DT_RELENT : relent = d->d_val; break;
+      default        :                    break;
+    }
+  }
+
+  if( relsz == 0 ) {
+    return true;
+  }
+  if( relent != sizeof( elf32_rel ) || !within( rel, relsz, size ) || ( rel & 3 ) ) {
+    return false;
+  }
+
+  for( elf32_rel* r = ( elf32_rel* )( base + rel ); relsz >= sizeof( elf32_rel ); r++, relsz -= sizeof( elf32_rel ) ) {
+    switch( r->r_info & 0xFF ) {
+      case R_ARM_NONE     : {
+        break;
+      }
+      case R_ARM_RELATIVE : {
+        if( !within( r->r_offset, sizeof( uint32_t ), size ) ) {
+          return false;
+        }
+
+        // the word may be unaligned (e.g., in packed data), so is updated byte-wise
+        uint8_t* p = base + r->r_offset;
+        uint32_t x = ( p[ 0 ] <<  0 ) | ( p[ 1 ] <<  8 ) | ( p[ 2 ] << 16 ) | ( p[ 3 ] << 24 );
+
+        x += ( uint32_t )( base );
+
+        p[ 0 ] = x >>  0; p[ 1 ] = x >>  8; p[ 2 ] = x >> 16; p[ 3 ] = x >> 24;
+
+        break;
+      }
+      default             : {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+// take n bytes of image space, aligned to a (a power of 2); return them, or NULL if there is not enough space
+static uint8_t* space( uint32_t n, uint32_t a ) {
+  uint8_t* x = ( uint8_t* )( ( ( uintptr_t )( loader_next ) + a - 1 ) & ~( ( uintptr_t )( a ) - 1 ) );
+
+  if( x > loader_end || n > ( uint32_t )( loader_end - x ) ) {
+    return NULL;
+  }
+
+  return x;
+}
+
+// mark image space up to x, as returned by space, as used
+static void space_take( uint8_t* x ) {
+  loader_stats.used += x - loader_next; loader_next = x;
+}
+
+// copy the n segments p of the image in file f, of size bytes, into image space then relocate them; return the base, or NULL on failure
+static uint8_t* copy( fs_file_t* f, elf32_phdr* p, int n, uint32_t size ) {
+  uint8_t* base = space( size, LOADER_ALIGN );
+
+  if( base == NULL ) {
+    return NULL;
+  }
+
+  // anything not covered by a segment, e.g., .bss, starts off as zero
+  memset( base, 0, size );
+
+  for( int i = 0; i < n; i++ ) {
+    if( p[ i ].p_type == PT_LOAD && p[ i ].p_filesz > 0 ) {
+      if( !read_at( f, p[ i ].p_offset, base + p[ i ].p_vaddr, p[ i ].p_filesz ) ) {
+        return NULL;
+      }
+    }
+  }
+
+  for( int i = 0; i < n; i++ ) {
+    if( p[ i ].p_type == PT_DYNAMIC ) {
+      if( !within( p[ i ].p_vaddr, p[ i ].p_memsz, size ) || ( p[ i ].p_vaddr & 3 ) ) {
+        return NULL;
+      }
+      if( !relocate( base, size, p[ i ].p_vaddr, p[ i ].p_memsz ) ) {
+        return NULL;
+      }
+    }
+  }
+
+  // only now is the image known to be valid, so the space it occupies is taken
+  space_take( base + size );
+
+  return base;
+}
+
+/* Mapping an image means describing each PT_LOAD segment as a segment of
+ * a region, and turning the relocation table into a list of offsets that
+ * is kept in image space (so the table itself is read up front, but the
+ * segments are not).  A relocation must update one aligned word, which is
+ * therefore within one page; anything else means the image is copied.
+ */
+
+// map the n segments p of the image in file f, of size bytes, into the mapping window; return the base, or NULL on failure
+static uint8_t* map( fs_file_t* f, elf32_phdr* p, int n, uint32_t size ) {
+  elf32_dyn d[ LOADER_DYNS ]; vm_seg_t seg[ VM_SEGS ]; int segs = 0;
+
+  uint32_t rel = 0, relsz = 0, relent = sizeof( elf32_rel ), relocs = 0; uint32_t* reloc = NULL;
+
+  for( int i = 0; i < n; i++ ) {
+    if( p[ i ].p_type == PT_LOAD ) {
+      if( segs == VM_SEGS ) {
+        return NULL;
+      }
+
+      seg[ segs ].off  = p[ i ].p_vaddr;
+      seg[ segs ].len  = p[ i ].p_memsz;
+      seg[ segs ].pos  = p[ i ].p_offset;
+      seg[ segs ].size = p[ i ].p_filesz;
+
+      segs++;
+    }
+    if( p[ i ].p_type == PT_DYNAMIC ) {
+      if( p[ i ].p_filesz > sizeof( d ) || !read_at( f, p[ i ].p_offset, d, p[ i ].p_filesz ) ) {
+        return NULL;
+      }
+
+      for( uint32_t j = 0; j < p[ i ].p_filesz / sizeof( elf32_dyn ) && d[ j ].d_tag != DT_NULL; j++ ) {
+        switch( d[ j ].d_tag ) {
+          case DT_REL    : rel    = d[ j ].d_val; break;
+          case DT_RELSZ  : relsz  = d[ j ].d_val; break;
+          case DT_RELENT : relent = d[ j ].d_val; break;
+          default        :                        break;
+        }
+      }
+    }
+  }
+
+  if( relsz > 0 ) {
+    uint32_t pos = 0;
+
+    // the relocation table is found in the file via the segment that holds it
+    for( int i = 0; i < segs; i++ ) {
+      if( rel >= seg[ i ].off && within( rel - seg[ i ].off, relsz, seg[ i ].size ) ) {
+        pos = seg[ i ].pos + ( rel - seg[ i ].off );
+      }
+    }
+
+    elf32_rel* r = ( elf32_rel* )( reloc = ( uint32_t* )( space( relsz, sizeof( uint32_t ) ) ) );
+
+    if( pos == 0 || relent != sizeof( elf32_rel ) || r == NULL || !read_at( f, pos, r, relsz ) ) {
+      return NULL;
+    }
+
+    // reloc[ k ] overwrites r[ k / 2 ], which has been read by then
+    for( uint32_t j = 0; j < relsz / sizeof( elf32_rel ); j++ ) {
+      uint32_t t = r[ j ].r_info & 0xFF, o = r[ j ].r_offset;
+
+      if     ( t == R_ARM_RELATIVE && !( o & 3 ) && within( o, sizeof( uint32_t ), size ) ) {
+        reloc[ relocs++ ] = o;
+      }
+      else if( t != R_ARM_NONE ) {
+        return NULL;
+      }
+    }
+  }
+
+  fs_file_t* g = fs_reopen( f, FS_O_RDONLY );
+
+  vm_region_t* v = ( g == NULL ) ? NULL : vm_map( VM_SHARED, g, size, true );
+
+  if( v == NULL ) {
+    fs_close( g ); return NULL;
+  }
+
+  memcpy( v->seg, seg, sizeof( seg ) );
+
+  v->segs   = segs;
+  v->reloc  = reloc;
+  v->relocs = relocs;
+
+  if( reloc != NULL ) {
+    space_take( ( uint8_t* )( reloc + relocs ) );
+  }
+
+  return ( uint8_t* )( v->base );
+}
+
+// load the image in file f, by copying or mapping it, into image table entry e; return e, or NULL on failure
+static loader_image_t* load( fs_file_t* f, loader_image_t* e ) {
+  elf32_ehdr h; elf32_phdr p[ LOADER_PHDRS ];
+
+  if( !read_at( f, 0, &h, sizeof( h ) ) ) {
+    return NULL;
+  }
+
+  if( h.e_ident[ 0 ] != 0x7F || h.e_ident[ 1 ] != 'E'         || h.e_ident[ 2 ] != 'L' || h.e_ident[ 3 ] != 'F' ||
+      h.e_ident[ 4 ] != ELFCLASS32 || h.e_ident[ 5 ] != ELFDATA2LSB ||
+      h.e_type != ET_DYN || h.e_machine != EM_ARM || h.e_phentsize != sizeof( elf32_phdr ) ||
+      h.e_phnum == 0 || h.e_phnum > LOADER_PHDRS ) {
+    return NULL;
+  }
+
+  if( !read_at( f, h.e_phoff, p, h.e_phnum * sizeof( elf32_phdr ) ) ) {
+    return NULL;
+  }
+
+  // the image spans from address 0 up to the end of the highest segment
+  uint32_t size = 0;
+
+  for( int i = 0; i < h.e_phnum; i++ ) {
+    if( p[ i ].p_type == PT_LOAD ) {
+      if( p[ i ].p_filesz > p[ i ].p_memsz || p[ i ].p_vaddr + p[ i ].p_memsz < p[ i ].p_vaddr ) {
+        return NULL;
+      }
+      if( p[ i ].p_vaddr + p[ i ].p_memsz > size ) {
+        size = p[ i ].p_vaddr + p[ i ].p_memsz;
+      }
+    }
+  }
+
+  if( size == 0 || !within( h.e_entry, sizeof( uint32_t ), size ) ) {
+    return NULL;
+  }
+
+  // a large image is mapped, so only the pages actually used are ever read; otherwise, or if that is not possible, it is copied
+  uint8_t* base = ( size >= LOADER_PAGED ) ? map( f, p, h.e_phnum, size ) : NULL;
+
+  if( base != NULL ) {
+    loader_stats.mapped++;
+  }
+  else if( NULL == ( base = copy( f, p, h.e_phnum, size ) ) ) {
+    return NULL;
+  }
+
+  e->ino   = f->ip->i_ino;
+  e->base  = base;
+  e->size  = size;
+  e->entry = base + h.e_entry;
+
+  return e;
+}
+
+// record image e, loaded from path, as TRACE_IMAGE events: its base address, then its path 4 characters at a time
+static void record( const char* path, loader_image_t* e ) {
+  int n = strlen( path );
+
+  trace_word( TRACE_IMAGE, 0, e->ino, ( uint32_t )( e->base ) );
+
+  for( int i = 0; i <= n && i / 4 < UINT8_MAX; i += 4 ) {
+    uint32_t w = 0;
+
+    for( int j = 0; j < 4 && i + j < n; j++ ) {
+      w |= ( uint32_t )( ( uint8_t )( path[ i + j ] ) ) << ( 8 * j );
+    }
+
+    trace_word( TRACE_IMAGE, 1 + i / 4, e->ino, w );
+  }
+}
+
+void* loader_load( const char* path ) {
+  fs_file_t* f = fs_open( path, FS_O_RDONLY );
+
+  if( f == NULL ) {
+    return NULL;
+  }
+
+  uint32_t ino = f->ip->i_ino; loader_image_t* e = NULL;
+
+  for( int i = 0; i < LOADER_IMAGES; i++ ) {
+    if( loader_images[ i ].ino == ino ) {
+      fs_close( f ); loader_stats.hits++; return loader_images[ i ].entry;
+    }
+    if( loader_images[ i ].ino == 0 && e == NULL ) {
+      e = &loader_images[ i ];
+    }
+  }
+
+  loader_stats.misses++;
+
+  if( e == NULL || f->ip->i_type != FS_TYPE_FILE || NULL == load( f, e ) ) {
+    fs_close( f ); loader_stats.rejected++; return NULL;
+  }
+
+  fs_close( f );
+
+  record( path, e );
+
+  return e->entry;
+}
@@ -0,0 +1,140 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#ifndef __LOADER_H
+#define __LOADER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string.h>
+
+#include "fs.h"
+#include "vm.h"
+#include "trace.h"
+
+/* The loader reads a program image from the file system into memory, so
+ * that a program need not be linked into the kernel image to be executed.
+ * It accepts a (very) minimal subset of ELF, namely a 32-bit, little-endian
+ * ARM shared object or position-independent executable (ET_DYN) with
+ *
+ * - PT_LOAD segments, which are copied into one contiguous, page aligned
+ *   region of memory taken from the image space (with any part of a
+ *   segment not present in the file, e.g., .bss, zeroed), and
+ * - optionally a PT_DYNAMIC segment, whose DT_REL table may only contain
+ *   R_ARM_RELATIVE relocations, i.e., words that hold an address relative
+ *   to the start of the image and so are adjusted by adding the address it
+ *   was loaded at.
+ *
+ * Anything else (e.g., an unresolved symbol) means the image is rejected.
+ *
+ * An image of at least LOADER_PAGED bytes is not read up front: it is
+ * mapped into the mapping window instead (see vm.h), so each page is only
+ * read and relocated when first touched, e.g., once the first instruction
+ * is fetched.  Only the relocation table, as a list of offsets, has to be
+ * resident beforehand.  A smaller image, or one that cannot be mapped, is
+ * copied (and relocated) into image space as a whole.
+ *
+ * Each image loaded is recorded (by base address and path) as TRACE_IMAGE
+ * events, so a profile can resolve addresses within it.
+ * Once loaded, an image stays resident in a table of LOADER_IMAGES entries
+ * indexed by inode number: executing the same program again, from any
+ * process, uses the resident copy (or mapping) rather than reading it again.
+ * As with programs linked into the kernel image, every process executing
+ * a program therefore shares one copy of its text *and* data.  Neither
+ * image space nor a mapped image is ever reclaimed, so a program replaced
+ * on disk is only reloaded after a reset.
+ */
+
+#define LOADER_IMAGES ( 16 )
+#define LOADER_ALIGN  ( 0x1000 )
+#define LOADER_PAGED  ( 0x4000 )
+
+#define LOADER_SUCCESS (  0 )
+#define LOADER_FAILURE ( -1 )
+
+// ELF definitions, per the ELF and ARM ELF specifications
+
+#define EI_NIDENT     ( 16 )
+#define ELFCLASS32    (  1 )
+#define ELFDATA2LSB   (  1 )
+#define ET_DYN        (  3 )
+#define EM_ARM        ( 40 )
+
+#define PT_LOAD       (  1 )
+#define PT_DYNAMIC    (  2 )
+
+#define DT_NULL       (  0 )
+#define DT_REL        ( 17 )
+#define DT_RELSZ      ( 18 )
+#define DT_RELENT     ( 19 )
+
+#define R_ARM_NONE     (  0 )
+#define R_ARM_RELATIVE ( 23 )
+
+typedef struct {
+  uint8_t    e_ident[ EI_NIDENT ];
+  uint16_t   e_type;
+  uint16_t   e_machine;
+  uint32_t   e_version;
+  uint32_t   e_entry;
+  uint32_t   e_phoff;
+  uint32_t   e_shoff;
+  uint32_t   e_flags;
+  uint16_t   e_ehsize;
+  uint16_t   e_phentsize;
+  uint16_t   e_phnum;
+  uint16_t   e_shentsize;
+  uint16_t   e_shnum;
+  uint16_t   e_shstrndx;
+} elf32_ehdr;
+
+typedef struct {
+  uint32_t   p_type;
+  uint32_t   p_offset;
+  uint32_t   p_vaddr;
+  uint32_t   p_paddr;
+  uint32_t   p_filesz;
+  uint32_t   p_memsz;
+  uint32_t   p_flags;
+  uint32_t   p_align;
+} elf32_phdr;
+
+typedef struct {
+  int32_t    d_tag;
+  uint32_t   d_val;
+} elf32_dyn;
+
+typedef struct {
+  uint32_t   r_offset;
+  uint32_t   r_info;
+} elf32_rel;
+
+typedef struct {
+  uint32_t   ino;       // inode number of image file, or 0 if entry unused
+  uint8_t*   base;      // address image was loaded at
+  uint32_t   size;      // size of image in memory
+  void*      entry;     // address of entry point
+} loader_image_t;
+
+typedef struct {
+  uint32_t   hits;      // loads served by a resident image
+  uint32_t   misses;    // loads that read an image from disk
+  uint32_t   mapped;    // images mapped, rather than copied
+  uint32_t   rejected;  // images that could not be loaded
+  uint32_t   used;      // bytes of image space in use
+} loader_stat_t;
+
+extern loader_stat_t loader_stats;
+
+// use the memory from start up to (but excluding) end as image space, and empty the image table
+extern void  loader_init( void* start, void* end );
+// load the program image at path (if not resident already); return its entry point, or NULL on failure
+extern void* loader_load( const char* path );
+
+#endif
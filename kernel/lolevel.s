@@ -13,11 +13,15 @@
 .global lolevel_handler_rst
 .global lolevel_handler_svc
 .global lolevel_handler_irq
+.global lolevel_handler_pab
+.global lolevel_handler_dab
 	
 lolevel_handler_rst: bl    int_init                @ initialise interrupt vector table
 
                      msr   cpsr, #0xD2             @ enter IRQ mode with IRQ and FIQ interrupts disabled
                      ldr   sp, =tos_irq            @ intialise IRQ mode stack
+                     msr   cpsr, #0xD7             @ enter ABT mode with IRQ and FIQ interrupts disabled
+                     ldr   sp, =tos_abt            @ initialise ABT mode stack
                      msr   cpsr, #0xD3             @ enter SVC mode with IRQ and FIQ interrupts disabled
                      ldr   sp, =tos_svc            @ initialise SVC mode stack
 
@@ -63,3 +67,33 @@ lolevel_handler_irq: sub   lr, lr, #4              @ correct return address
                      ldmia sp, { r0-r12, sp, lr }^ @ restore  USR mode registers
                      add   sp, sp, #60             @ update   IRQ mode SP
                      movs  pc, lr                  @ return from interrupt
+
+lolevel_handler_pab: sub   lr, lr, #4              @ correct return address, i.e., retry instruction
+                     sub   sp, sp, #60             @ update   ABT mode stack
+                     stmia sp, { r0-r12, sp, lr }^ @ preserve USR registers
+                     mrs   r0, spsr                @ move     USR        CPSR
+                     stmdb sp!, { r0, lr }         @ store    USR PC and CPSR
+
+                     mov   r0, sp                  @ set    high-level C function arg. = SP
+                     bl    hilevel_handler_pab     @ invoke high-level C function
+
+                     ldmia sp!, { r0, lr }         @ load     USR mode PC and CPSR
+                     msr   spsr, r0                @ move     USR mode        CPSR
+                     ldmia sp, { r0-r12, sp, lr }^ @ restore  USR mode registers
+                     add   sp, sp, #60             @ update   ABT mode SP
+                     movs  pc, lr                  @ return from interrupt
+
+lolevel_handler_dab: sub   lr, lr, #8              @ correct return address, i.e., retry instruction
+                     sub   sp, sp, #60             @ update   ABT mode stack
+                     stmia sp, { r0-r12, sp, lr }^ @ preserve USR registers
+                     mrs   r0, spsr                @ move     USR        CPSR
+                     stmdb sp!, { r0, lr }         @ store    USR PC and CPSR
+
+                     mov   r0, sp                  @ set    high-level C function arg. = SP
+                     bl    hilevel_handler_dab     @ invoke high-level C function
+
+                     ldmia sp!, { r0, lr }         @ load     USR mode PC and CPSR
+                     msr   spsr, r0                @ move     USR mode        CPSR
+                     ldmia sp, { r0-r12, sp, lr }^ @ restore  USR mode registers
+                     add   sp, sp, #60             @ update   ABT mode SP
+                     movs  pc, lr                  @ return from interrupt
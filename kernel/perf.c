@@ -0,0 +1,62 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#include "perf.h"
+
+hist_t   perf_hist[ PERF_SCOPES ];
+uint32_t perf_event[ PMU_EVENTS ];  // event selected for each event counter
+uint32_t perf_events;               // event counters available
+
+void perf_init() {
+  pmu_enable();
+
+  perf_events = pmu_get_num();
+
+  if( perf_events > PMU_EVENTS ) {
+    perf_events = PMU_EVENTS;
+  }
+
+  for( int i = 0; i < perf_events; i++ ) {
+    pmu_set_event( i, perf_event[ i ] = PMU_EVENT_INST_RETIRED );
+  }
+
+  for( int i = 0; i < PERF_SCOPES; i++ ) {
+    hist_reset( &perf_hist[ i ] );
+  }
+}
+
+int perf_stat( int id, hist_t* x, bool reset ) {
+  if( id < 0 || id >= PERF_SCOPES ) {
+    return -1;
+  }
+
+  memcpy( x, &perf_hist[ id ], sizeof( hist_t ) );
+
+  if( reset ) {
+    hist_reset( &perf_hist[ id ] );
+  }
+
+  return 0;
+}
+
+int perf_read( perf_pmu_t* x, const uint32_t* events ) {
+  if( events != NULL ) {
+    for( int i = 0; i < perf_events; i++ ) {
+      pmu_set_event( i, perf_event[ i ] = events[ i ] );
+    }
+  }
+
+  x->cycles = pmu_get_cycles();
+  x->events = perf_events;
+
+  for( int i = 0; i < PMU_EVENTS; i++ ) {
+    x->event[ i ] = ( i < perf_events ) ? perf_event[ i ] : 0;
+    x->count[ i ] = ( i < perf_events ) ? pmu_get_event( i ) : 0;
+  }
+
+  return perf_events;
+}
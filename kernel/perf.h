@@ -0,0 +1,63 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#ifndef __PERF_H
+#define __PERF_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string.h>
+
+#include "PMU.h"
+
+#include "hist.h"
+
+/* Short kernel paths are measured in cycles, via the PMU cycle counter,
+ * since the 24MHz counter is too coarse: wrapping a statement in a scope
+ *
+ * PERF_SCOPE( PERF_DISPATCH ) {
+ *   dispatch( ctx, prev, next );
+ * }
+ *
+ * adds the cycles it took to the histogram of that scope, which can be
+ * read (and reset) via pmu_stat.  A scope costs two reads of the cycle
+ * counter plus a hist_add, i.e., a few tens of cycles, which is included
+ * in what it measures; leaving a scope early (via break, goto or return)
+ * means it is not measured at all.
+ *
+ * The PMU event counters are left for user benchmarks, which select the
+ * events counted and read every counter via the pmu system call.  Note
+ * that the counters are global rather than per process, so a reading
+ * includes any other process (and the kernel) run in between.
+ */
+
+#define PERF_DISPATCH ( 0 ) // dispatch, i.e., a context switch
+#define PERF_SCHEDULE ( 1 ) // mlfqSchedule, i.e., selecting the process to execute next
+#define PERF_PUTC     ( 2 ) // PL011_putc of a character written to the console
+#define PERF_SCOPES   ( 3 )
+
+typedef struct {
+  uint32_t cycles;                  // cycle counter
+  uint32_t events;                  // event counters available (at most PMU_EVENTS)
+  uint32_t event[ PMU_EVENTS ];     // event selected for each event counter
+  uint32_t count[ PMU_EVENTS ];     // each event counter
+} perf_pmu_t;
+
+extern hist_t perf_hist[ PERF_SCOPES ];
+
+#define PERF_SCOPE( id ) for( uint32_t perf_t = pmu_get_cycles(), perf_i = 1; perf_i; perf_i = 0, hist_add( &perf_hist[ id ], pmu_get_cycles() - perf_t ) )
+
+// enable the PMU, and clear the histogram of every scope
+extern void perf_init();
+// copy the histogram of scope id into x, then clear it iff. reset; return 0 on success or -1 on failure
+extern int  perf_stat( int id, hist_t* x, bool reset );
+// select the event counted by each event counter iff. events != NULL (resetting them), then copy every counter into x; return the number of event counters
+extern int  perf_read( perf_pmu_t* x, const uint32_t* events );
+
+#endif
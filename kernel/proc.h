@@ -0,0 +1,81 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#ifndef __PROC_H
+#define __PROC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string.h>
+
+#include "fd.h"
+#include "wheel.h"
+
+/* The kernel source code is made simpler and more consistent by using 
+ * some human-readable type definitions:
+ *
+ * - a type that captures a Process IDentifier (PID), which is really
+ *   just an integer,
+ * - an enumerated type that captures the status of a process, e.g.,
+ *   whether it is currently executing,
+ * - a type that captures each component of an execution context (i.e.,
+ *   processor state) in a compatible order wrt. the low-level handler
+ *   preservation and restoration prologue and epilogue,
+ * - a type that captures the CPU accounting of a process, i.e., how long
+ *   it has executed and waited in a ready queue (measured in ticks of
+ *   the 24MHz counter, by dispatch and enqueue), how often it has been
+ *   switched away from, and how many system calls it has made, and
+ * - a type that captures a process PCB, including the timer which wakes
+ *   it iff. it is sleeping (i.e., has status STATUS_WAITING).
+ */
+
+#define MAX_PROCS 20 
+#define PRIORITY_LEVELS 3
+#define STACK_SIZE 0x1000
+
+typedef int pid_t;
+typedef int prty_t;
+
+typedef enum { 
+  STATUS_INVALID,
+
+  STATUS_CREATED,
+  STATUS_TERMINATED,
+
+  STATUS_READY,
+  STATUS_EXECUTING,
+  STATUS_WAITING
+} status_t;
+
+typedef struct {
+  uint32_t cpsr, pc, gpr[ 13 ], sp, lr;
+} ctx_t;
+
+typedef struct {
+  uint64_t    run; // time spent executing
+  uint64_t   wait; // time spent ready, i.e., in a queue
+  uint32_t   vcsw; // switches away from process by yield  (voluntary)
+  uint32_t  ivcsw; // switches away from process by timer (involuntary)
+  uint32_t   svcs; // system calls made
+  uint32_t  t_run; // counter value at last dispatch
+  uint32_t t_wait; // counter value at last enqueue
+} acct_t;
+
+typedef struct {
+     pid_t    pid; // Process IDentifier (PID)
+  status_t status; // current status
+  uint32_t    tos; // address of Top of Stack (ToS)
+     ctx_t    ctx; // execution context
+    prty_t   prty; // priority level of process
+fd_table_t     fd; // descriptor table
+    acct_t   acct; // CPU accounting
+wheel_timer_t timer; // wake-up timer, pending iff. sleeping
+} pcb_t;
+
+#endif
@@ -0,0 +1,41 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#include "prof.h"
+
+prof_stat_t prof_stats;
+
+uint32_t prof_start( uint32_t hz ) {
+  TIMER1->Timer1Ctrl = 0x00000000; // disable timer (and interrupt), so it can be reprogrammed
+  TIMER1->Timer1IntClr = 0x01;
+
+  if( hz > PROF_HZ_MAX ) {
+    hz = PROF_HZ_MAX;
+  }
+
+  prof_stats.hz = hz;
+
+  if( hz == 0 ) {
+    return 0;
+  }
+
+  TIMER1->Timer1Load  = PROF_CLOCK / hz; // select period
+  TIMER1->Timer1Ctrl  = 0x00000002; // select 32-bit   timer
+  TIMER1->Timer1Ctrl |= 0x00000040; // select periodic timer
+  TIMER1->Timer1Ctrl |= 0x00000020; // enable          timer interrupt
+  TIMER1->Timer1Ctrl |= 0x00000080; // enable          timer
+
+  return hz;
+}
+
+void prof_sample( uint32_t pc, uint32_t cpsr, uint32_t pid ) {
+  trace_word( TRACE_SAMPLE, cpsr & 0x1F, pid, pc );
+
+  prof_stats.samples++;
+
+  TIMER1->Timer1IntClr = 0x01;
+}
@@ -0,0 +1,52 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#ifndef __PROF_H
+#define __PROF_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string.h>
+
+#include "SP804.h"
+
+#include "trace.h"
+
+/* The profiler samples whatever the processor was doing when an interrupt
+ * from TIMER1 (i.e., SP804 timer #2) is taken, at a rate set by prof_start:
+ * each sample is the interrupted address, processor mode and process ID,
+ * recorded as a TRACE_SAMPLE event.  So the trace ring buffer doubles as
+ * the sample buffer, and samples reach the host over UART3 alongside any
+ * other events; there, tools/profsym resolves each address to a function
+ * (using the symbols in image.elf, plus those of any program the loader
+ * read from disk, whose base address is recorded as a TRACE_IMAGE event),
+ * and prints a flat profile or folded stacks.
+ *
+ * Since a sample is taken by an interrupt, code that runs with interrupts
+ * disabled (i.e., the kernel's handlers) is never sampled: its time is
+ * instead charged to whatever was interrupted.  If the ring buffer fills,
+ * samples are dropped (and counted), so a high rate may need a lower one.
+ */
+
+#define PROF_CLOCK    ( 1000000 ) // SP804 clock frequency (Hz)
+#define PROF_HZ_MAX   (   10000 ) // highest sample rate    (Hz)
+
+typedef struct {
+  uint32_t hz;                      // sample rate, or 0 iff. stopped
+  uint32_t samples;                 // samples taken
+} prof_stat_t;
+
+extern prof_stat_t prof_stats;
+
+// sample at hz samples per second, or stop iff. hz = 0; return the rate actually set
+extern uint32_t prof_start( uint32_t hz );
+// take a sample of address pc in processor mode (per cpsr) of process pid, then clear the TIMER1 interrupt
+extern void prof_sample( uint32_t pc, uint32_t cpsr, uint32_t pid );
+
+#endif
@@ -0,0 +1,148 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#include "sched.h"
+
+mlf_queues mlfq;                   // Multi-level feedback queue structure
+
+// create queue node for given PCB
+node* newNode(pcb_t* pcb) { 
+    node* temp = (node*)malloc(sizeof(node)); 
+    temp->pcb = pcb; 
+    temp->next = NULL; 
+    return temp; 
+} 
+
+bool isEmpty(queue* q) {
+	return q->tail == NULL;
+}
+
+// place PCB node onto end of given queue
+void enqueue(queue* q, pcb_t* pcb) {
+    node* temp = newNode(pcb);
+
+    sched_enqueued(q, pcb);
+
+    if (isEmpty(q)) {
+        q->head = q->tail = temp;
+        return;
+    }
+
+    q->tail->next = temp;
+    q->tail = temp;
+}
+
+// remove head node from given queue
+void dequeue(queue* q) {
+	if (isEmpty(q)) {
+		return;
+	}
+
+	sched_dequeued(q, q->head->pcb);
+
+    node* temp = q->head;
+	q->head = q->head->next;
+
+	if (q->head == NULL) {
+		q->tail = NULL;
+	}
+
+	free(temp);
+}
+
+// delete PCB node from any point in a queue
+void delPCBNode(queue* q, pcb_t* pcb) {
+
+	if (pcb->status != STATUS_READY) {return;} // only PCBs with ready status are in a queue
+
+	if (q->head->pcb == pcb) {
+		dequeue(q);
+		return;
+	}
+
+	node* temp1 = q->head;
+	node* temp2;
+
+	while (temp1->next->pcb != pcb) {
+		temp1 = temp1->next;
+	}
+
+	temp2 = temp1->next;
+	temp1->next = temp1->next->next;
+
+	sched_dequeued(q, pcb);
+	
+	if (temp1->next == NULL) {
+		q->tail = temp1;
+	}
+
+	free(temp2);
+}
+
+// retrieve highest priority PCB node from within the multi-level queue structure
+node* mlfqHighestNode(mlf_queues* mlfq) {
+	for (int i = 0; i < PRIORITY_LEVELS; i++) {
+		if (!isEmpty(&mlfq->queues[i])) {
+	      return mlfq->queues[i].head;
+		}
+	}
+	return NULL;
+}
+
+// Place given PCB node (that has just finished being executed) into a queue 
+void reQueue(pcb_t* pcb) {
+	if (pcb->prty < PRIORITY_LEVELS) { 
+		pcb->prty++;
+	}
+	enqueue(&mlfq.queues[pcb->prty-1], pcb);
+}
+
+void mlfqInit(pcb_t* procs, int n) {
+  // place all ready processes into correct priority queue
+  for (int i = 0; i < n; i++) {
+    if (procs[i].status == STATUS_READY) {
+      enqueue(&mlfq.queues[procs[i].prty-1], &procs[i]);
+	}
+  }
+
+  // Each priority queue is assigned double the time slot for processes than the queue above
+  mlfq.queueTime[0] = 1;
+  for (int i = 1; i < PRIORITY_LEVELS; i++) {
+	  mlfq.queueTime[i] = mlfq.queueTime[i-1]*2;
+  }
+
+  mlfq.timeCount = 0;
+}
+
+// Scheduler
+pcb_t* mlfqSchedule(pcb_t* prev) {
+	// a process no longer executing (e.g., sleeping) is not requeued
+	if (prev != NULL && prev->status == STATUS_EXECUTING) {
+		// increment no. time slices used by process
+		mlfq.timeCount++;
+
+		// Check process has not used up allocated time slices at current priority level
+		if (mlfq.timeCount < mlfq.queueTime[prev->prty-1]) { return prev; }
+
+		// If process has used allocated time slice, requeue it
+		reQueue(prev);
+		prev->status = STATUS_READY;
+	}
+
+	// select next highest priority process, which starts a new time slice
+	mlfq.timeCount = 0;
+
+	node* top = mlfqHighestNode(&mlfq);
+
+	if (top == NULL) { return NULL; }
+
+	pcb_t* next = top->pcb;
+	dequeue(&mlfq.queues[next->prty-1]);
+	next->status = STATUS_EXECUTING;
+
+	return next;
+}
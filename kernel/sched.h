@@ -0,0 +1,74 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#ifndef __SCHED_H
+#define __SCHED_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <stdlib.h>
+
+#include "proc.h"
+
+/* The multi-level feedback queue (MLFQ) scheduler keeps one FIFO queue of
+ * ready processes per priority level 1 to PRIORITY_LEVELS; a process at
+ * level p may execute for queueTime[ p - 1 ] consecutive ticks before it
+ * is demoted to the next level (if any) and the head of the highest
+ * non-empty queue selected in its place.
+ *
+ * None of this touches the hardware, so it compiles for the host as well
+ * as the target (see tools/schedbench.c): whatever the kernel does when a
+ * process enters or leaves a queue (e.g., tracing, accounting) is left to
+ * the sched_enqueued and sched_dequeued hooks, which it must define.
+ */
+
+typedef struct node { 
+	pcb_t* pcb;
+	struct node* next;
+} node;
+
+typedef struct queue {
+    node* head;
+    node* tail;
+} queue;
+
+typedef struct {
+    queue queues[PRIORITY_LEVELS];
+	int queueTime[PRIORITY_LEVELS];
+	int timeCount;
+} mlf_queues;
+
+extern mlf_queues mlfq;
+
+// create queue node for given PCB
+extern node* newNode(pcb_t* pcb);
+// true iff. given queue is empty
+extern bool isEmpty(queue* q);
+// place PCB node onto end of given queue
+extern void enqueue(queue* q, pcb_t* pcb);
+// remove head node from given queue
+extern void dequeue(queue* q);
+// delete PCB node from any point in a queue
+extern void delPCBNode(queue* q, pcb_t* pcb);
+// retrieve highest priority PCB node from within the multi-level queue structure
+extern node* mlfqHighestNode(mlf_queues* mlfq);
+// place given PCB (that has just finished being executed) into a queue, one level lower
+extern void reQueue(pcb_t* pcb);
+
+// place the n ready processes in procs into the queue of their priority level, and set the time slices
+extern void mlfqInit(pcb_t* procs, int n);
+// one tick of the scheduler with prev executing (or NULL, or no longer executing): return the process to execute next (or NULL, if none is ready)
+extern pcb_t* mlfqSchedule(pcb_t* prev);
+
+// called as pcb is placed onto q
+extern void sched_enqueued(queue* q, pcb_t* pcb);
+// called as pcb is removed from q
+extern void sched_dequeued(queue* q, pcb_t* pcb);
+
+#endif
@@ -0,0 +1,102 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#include "trace.h"
+
+trace_event_t     trace_buf[ TRACE_EVENTS ]; // ring buffer
+volatile uint32_t trace_head = 0;            // events recorded,   i.e., next slot to fill (producer only)
+volatile uint32_t trace_tail = 0;            // bytes transmitted, i.e., next byte to send (consumer only)
+uint32_t          trace_lost = 0;            // events dropped since the last TRACE_LOST
+bool              trace_on   = false;
+bool              trace_busy = false;        // transmit interrupt enabled?
+trace_stat_t      trace_stats;
+
+// stop or start the UART3 transmit interrupt
+static void trace_irq( bool x ) {
+  trace_busy = x;
+
+  if( x ) {
+    UART3->IMSC |=  0x20;
+  }
+  else {
+    UART3->IMSC &= ~0x20; UART3->ICR = 0x20;
+  }
+}
+
+// append event to the buffer, iff. there is space for it
+static bool trace_put( trace_type_t t, uint8_t a, uint16_t b, uint32_t w ) {
+  uint32_t h = trace_head;
+
+  // full iff. a record would overwrite bytes not yet transmitted (counting in bytes, modulo 2^32)
+  if( h * sizeof( trace_event_t ) - trace_tail > sizeof( trace_buf ) - sizeof( trace_event_t ) ) {
+    return false;
+  }
+
+  trace_event_t* e = &trace_buf[ h % TRACE_EVENTS ];
+
+  e->type = t;
+  e->a    = a;
+  e->b    = b;
+  e->t    = w;
+
+  trace_head = h + 1; trace_stats.events++;
+
+  return true;
+}
+
+void trace_init() {
+  trace_head = 0;
+  trace_tail = 0;
+  trace_lost = 0;
+
+  memset( &trace_stats, 0, sizeof( trace_stats ) );
+
+  trace_irq( false );
+
+  trace_on = true;
+
+  trace( TRACE_START, 0, TRACE_KHZ );
+}
+
+void trace( trace_type_t t, uint8_t a, uint16_t b ) {
+  trace_word( t, a, b, SYSCONF->COUNTER_24MHZ );
+}
+
+void trace_word( trace_type_t t, uint8_t a, uint16_t b, uint32_t w ) {
+  if( !trace_on ) {
+    return;
+  }
+
+  if( trace_lost != 0 ) {
+    if( !trace_put( TRACE_LOST, 0, ( trace_lost > UINT16_MAX ) ? UINT16_MAX : trace_lost, SYSCONF->COUNTER_24MHZ ) ) {
+      trace_lost++; trace_stats.lost++; return;
+    }
+
+    trace_lost = 0;
+  }
+
+  if( !trace_put( t, a, b, w ) ) {
+    trace_lost++; trace_stats.lost++; return;
+  }
+
+  if( !trace_busy ) {
+    trace_drain();
+  }
+}
+
+void trace_drain() {
+  uint32_t n = trace_head * sizeof( trace_event_t ), t = trace_tail;
+
+  for( int i = 0; i < TRACE_BURST && t != n && PL011_can_putc( UART3 ); i++, t++ ) {
+    PL011_putc( UART3, ( ( uint8_t* )( trace_buf ) )[ t % sizeof( trace_buf ) ], false );
+  }
+
+  trace_stats.bytes += t - trace_tail; trace_tail = t;
+
+  // keep the interrupt enabled iff. there is more to send
+  trace_irq( t != n );
+}
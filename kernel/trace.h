@@ -0,0 +1,65 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#ifndef __TRACE_H
+#define __TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string.h>
+
+#include "PL011.h"
+#include   "SYS.h"
+
+#include "trace_format.h"
+
+/* The kernel records events (e.g., each dispatch, system call, interrupt
+ * and change to a ready queue) in a trace ring buffer, which is drained
+ * in the background over UART3, so tracing costs a few stores per event
+ * rather than the time taken to transmit a message:
+ *
+ * - each event is a fixed-size, 8-byte record (see trace_format.h): the
+ *   type, two arguments and the value of the 24MHz counter when it took
+ *   place, transmitted as is for tools/tracedec to decode,
+ * - the buffer has one producer (trace) and one consumer (trace_drain),
+ *   each of which only advances its own index, so neither ever waits for
+ *   the other: if the buffer is full, the event is dropped and counted,
+ *   and the number dropped is recorded as an event once there is space,
+ * - the consumer is driven by the UART3 transmit interrupt, which fires
+ *   as the transmit FIFO empties: each interrupt moves at most one FIFO's
+ *   worth of bytes, and the interrupt is only enabled while there is
+ *   something to send.  The first event after the buffer empties writes
+ *   to the FIFO directly, to start things off.
+ *
+ * The trace is written (and drained) with interrupts disabled, i.e., by
+ * the kernel's own handlers, so events never interleave; and interrupts
+ * from UART3 itself are not traced, or draining would never finish.
+ */
+
+#define TRACE_EVENTS    ( 1024 )  // a power of two
+#define TRACE_BURST     (   16 )  // bytes moved per interrupt, i.e., the FIFO depth
+
+typedef struct {
+  uint32_t events;                // events recorded
+  uint32_t lost;                  // events dropped because the buffer was full
+  uint32_t bytes;                 // bytes transmitted
+} trace_stat_t;
+
+extern trace_stat_t trace_stats;
+
+// start tracing, i.e., reset the buffer and record a TRACE_START event
+extern void trace_init();
+// record an event of type t with arguments a and b
+extern void trace( trace_type_t t, uint8_t a, uint16_t b );
+// record an event of type t with arguments a and b, and word w in place of the timestamp
+extern void trace_word( trace_type_t t, uint8_t a, uint16_t b, uint32_t w );
+// transmit what the UART3 transmit FIFO can take of the buffer (i.e., on a UART3 interrupt)
+extern void trace_drain();
+
+#endif
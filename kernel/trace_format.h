@@ -0,0 +1,52 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#ifndef __TRACE_FORMAT_H
+#define __TRACE_FORMAT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* The trace is a stream of fixed-size, 8-byte event records, each of them
+ * little-endian.  The timestamp is the 24MHz counter, so wraps around
+ * every 179s or so: a decoder unwraps it by assuming consecutive events
+ * are less than one period apart.  A stream starts with TRACE_START (if
+ * it was captured from reset), which records the counter frequency.  The
+ * records of TRACE_SAMPLE and TRACE_IMAGE hold an address (or characters)
+ * rather than a timestamp, so are skipped when unwrapping: an image is
+ * described by a run of TRACE_IMAGE records, the first (a = 0) holding
+ * its base address and the rest (a = 1, 2, ...) its path, 4 characters
+ * per record, up to and including the terminating NUL.
+ *
+ * This header is shared with the host-side tools.
+ */
+
+#define TRACE_KHZ       ( 24000 ) // frequency of the timestamp counter
+
+typedef enum {
+  TRACE_START = 1,                // tracing started            : b = TRACE_KHZ
+  TRACE_LOST,                     // events dropped             : b = count
+  TRACE_DISPATCH,                 // context switch             : a = prev PID, b = next PID (0 = none)
+  TRACE_SVC_ENTER,                // system call made           : a = id, b = PID
+  TRACE_SVC_EXIT,                 // system call completed      : a = id, b = PID
+  TRACE_IRQ_ENTER,                // interrupt taken            : b = source
+  TRACE_IRQ_EXIT,                 // interrupt handled          : b = source
+  TRACE_ENQUEUE,                  // process made ready         : a = queue, b = PID
+  TRACE_DEQUEUE,                  // process removed from queue : a = queue, b = PID
+  TRACE_SAMPLE,                   // profiler sample            : a = mode, b = PID, t = PC
+  TRACE_IMAGE                     // program image loaded       : a = index, b = inode, t = base address or path
+} trace_type_t;
+
+typedef struct {
+  uint8_t  type;                  // trace_type_t
+  uint8_t  a;                     // first  argument
+  uint16_t b;                     // second argument
+  uint32_t t;                     // timestamp, i.e., COUNTER_24MHZ (or an address)
+} trace_event_t;
+
+#endif
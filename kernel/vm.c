@@ -0,0 +1,291 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#include "vm.h"
+
+/* Descriptors, per the ARMv7-A short-descriptor translation table format:
+ * everything is in domain 0, non-cacheable, and accessible from USR mode
+ * (or, for a read-only page, readable from USR mode).
+ */
+
+#define L1_SECTION( a ) ( ( ( a ) & 0xFFF00000 ) | 0x00000C02 ) // AP = 11, section
+#define L1_COARSE(  a ) ( ( ( a ) & 0xFFFFFC00 ) | 0x00000001 ) //          level 2 table
+#define L2_PAGE_RW( a ) ( ( ( a ) & 0xFFFFF000 ) | 0x00000032 ) // AP = 11, small page
+#define L2_PAGE_RO( a ) ( ( ( a ) & 0xFFFFF000 ) | 0x00000022 ) // AP = 10, small page
+
+#define VM_L2         ( VM_LEN >> 20 )  // level 2 tables, each covering 1 MiB of 256 pages
+
+uint32_t    vm_l1[ 4096 ]          __attribute__( ( aligned( 0x4000 ) ) );
+uint32_t    vm_l2[ VM_L2 ][ 256 ]  __attribute__( ( aligned( 0x0400 ) ) );
+
+vm_region_t vm_regions[ VM_REGIONS ];
+vm_stat_t   vm_stats;
+
+uint8_t*    vm_frames    = NULL;    // first frame
+uint32_t    vm_frame_num = 0;       // number of frames
+void*       vm_free      = NULL;    // list of free frames, each holding a pointer to the next
+
+void vm_init( void* start, void* end ) {
+  uintptr_t x = ( ( uintptr_t )( start ) + VM_PAGE - 1 ) & ~( VM_PAGE - 1 );
+
+  vm_frames    = ( uint8_t* )( x );
+  vm_frame_num = ( ( uintptr_t )( end ) > x ) ? ( ( uintptr_t )( end ) - x ) / VM_PAGE : 0;
+  vm_free      = NULL;
+
+  for( int i = vm_frame_num - 1; i >= 0; i-- ) {
+    void** f = ( void** )( vm_frames + i * VM_PAGE ); *f = vm_free; vm_free = f;
+  }
+
+  memset( vm_regions, 0, sizeof( vm_regions ) );
+  memset( &vm_stats,   0, sizeof( vm_stats    ) );
+  memset( vm_l2,      0, sizeof( vm_l2      ) );
+
+  for( uint32_t i = 0; i < 4096; i++ ) {
+    vm_l1[ i ] = L1_SECTION( i << 20 );
+  }
+  for( uint32_t i = 0; i < VM_L2; i++ ) {
+    vm_l1[ ( VM_BASE >> 20 ) + i ] = L1_COARSE( ( uint32_t )( uintptr_t )( vm_l2[ i ] ) );
+  }
+
+  mmu_set_ptr0( vm_l1 );
+  mmu_set_dom( 0, 0x1 ); // domain 0 = client, i.e., check access permissions
+  mmu_flush();
+  mmu_enable();
+}
+
+// get the level 2 descriptor for address x, which must be within the mapping window
+static uint32_t* pte( uint32_t x ) {
+  return &vm_l2[ 0 ][ 0 ] + ( ( x - VM_BASE ) / VM_PAGE );
+}
+
+// get the frame that level 2 descriptor d maps
+static uint8_t* pte_frame( uint32_t d ) {
+  return vm_frames + ( ( d & 0xFFFFF000 ) - ( uint32_t )( uintptr_t )( vm_frames ) );
+}
+
+// check whether address x is within the mapping window
+static bool in_window( uint32_t x ) {
+  return x >= VM_BASE && x - VM_BASE < VM_LEN;
+}
+
+// get the region that address x is within, or NULL if there is none
+static vm_region_t* region( uint32_t x ) {
+  for( int i = 0; i < VM_REGIONS; i++ ) {
+    vm_region_t* r = &vm_regions[ i ];
+
+    if( r->used && x >= r->base && x - r->base < r->len ) {
+      return r;
+    }
+  }
+
+  return NULL;
+}
+
+// fill frame f with the page at offset p in region r, i.e., read whatever segments overlap it then relocate it
+static bool page_in( vm_region_t* r, uint32_t p, uint8_t* f ) {
+  memset( f, 0, VM_PAGE );
+
+  for( int i = 0; i < r->segs; i++ ) {
+    vm_seg_t* s = &r->seg[ i ];
+
+    uint32_t lo = ( p           > s->off           ) ? p           : s->off;
+    uint32_t hi = ( p + VM_PAGE < s->off + s->size ) ? p + VM_PAGE : s->off + s->size;
+
+    if( lo < hi ) {
+      r->file->off = s->pos + ( lo - s->off );
+
+      if( fs_read( r->file, f + ( lo - p ), hi - lo ) < 0 ) {
+        return false;
+      }
+    }
+  }
+
+  for( uint32_t i = 0; i < r->relocs; i++ ) {
+    if( r->reloc[ i ] >= p && r->reloc[ i ] - p < VM_PAGE ) {
+      *( uint32_t* )( f + ( r->reloc[ i ] - p ) ) += r->base;
+    }
+  }
+
+  vm_stats.pageins++;
+
+  return true;
+}
+
+bool vm_fault( uint32_t x, bool write ) {
+  vm_stats.faults++;
+
+  vm_region_t* r = in_window( x ) ? region( x ) : NULL;
+
+  // a fault on a page already mapped is a permission fault, i.e., a write to a read-only region
+  if( r == NULL || *pte( x ) != 0 || ( write && !r->write ) || vm_free == NULL ) {
+    vm_stats.failed++; return false;
+  }
+
+  uint8_t* f = vm_free; vm_free = *( void** )( f );
+
+  if( !page_in( r, ( x - r->base ) & ~( VM_PAGE - 1 ), f ) ) {
+    *( void** )( f ) = vm_free; vm_free = f;
+
+    vm_stats.failed++; return false;
+  }
+
+  uint32_t a = ( uint32_t )( uintptr_t )( f );
+
+  *pte( x ) = r->write ? L2_PAGE_RW( a ) : L2_PAGE_RO( a );
+
+  vm_stats.frames++;
+
+  mmu_flush();
+
+  return true;
+}
+
+bool vm_touch( uint32_t x, uint32_t n, bool write ) {
+  if( n == 0 ) {
+    return true;
+  }
+  if( x + n - 1 < x ) {
+    return false;
+  }
+
+  uint32_t p = x & ~( VM_PAGE - 1 ), q = ( x + n - 1 ) & ~( VM_PAGE - 1 );
+
+  for( ; true; p += VM_PAGE ) {
+    if( in_window( p ) ) {
+      if( *pte( p ) == 0 && !vm_fault( p, write ) ) {
+        return false;
+      }
+      if( write && ( *pte( p ) & 0x30 ) != 0x30 ) {
+        return false;
+      }
+    }
+    if( p == q ) {
+      break;
+    }
+  }
+
+  return true;
+}
+
+bool vm_touch_str( uint32_t x, uint32_t n ) {
+  for( uint32_t i = 0; i < n; i++ ) {
+    // the length is unknown, so each page is touched once the string reaches it
+    if( ( i == 0 || ( ( x + i ) % VM_PAGE ) == 0 ) && !vm_touch( x + i, 1, false ) ) {
+      return false;
+    }
+    if( *( const char* )( x + i ) == '\0' ) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+vm_region_t* vm_map( int owner, fs_file_t* f, uint32_t n, bool write ) {
+  vm_region_t* r = NULL;
+
+  if( vm_frames == NULL || n == 0 || n > VM_LEN ) {
+    return NULL;
+  }
+
+  for( int i = 0; i < VM_REGIONS && r == NULL; i++ ) {
+    r = vm_regions[ i ].used ? NULL : &vm_regions[ i ];
+  }
+
+  if( r == NULL ) {
+    return NULL;
+  }
+
+  n = ( n + VM_PAGE - 1 ) & ~( VM_PAGE - 1 );
+
+  // first fit: move past any region that overlaps the candidate, until none does
+  uint32_t x = VM_BASE;
+
+  for( int i = 0; i < VM_REGIONS; i++ ) {
+    vm_region_t* s = &vm_regions[ i ];
+
+    if( s->used && x < s->base + s->len && s->base < x + n ) {
+      x = s->base + s->len; i = -1;
+    }
+    if( x - VM_BASE > VM_LEN - n ) {
+      return NULL;
+    }
+  }
+
+  memset( r, 0, sizeof( vm_region_t ) );
+
+  r->used  = true;
+  r->owner = owner;
+  r->base  = x;
+  r->len   = n;
+  r->write = write;
+  r->file  = f;
+
+  return r;
+}
+
+uint32_t vm_mmap( int owner, fs_file_t* f, uint32_t off, uint32_t n, bool write ) {
+  if( f == NULL || n == 0 || ( off & ( VM_PAGE - 1 ) ) ) {
+    return 0;
+  }
+
+  // the region reads via a handle of its own, so neither disturbs the offset of, nor depends on, f
+  fs_file_t* g = fs_reopen( f, FS_O_RDONLY );
+
+  vm_region_t* r = ( g == NULL ) ? NULL : vm_map( owner, g, n, write );
+
+  if( r == NULL ) {
+    fs_close( g ); return 0;
+  }
+
+  uint32_t size = g->ip->i_size;
+
+  r->segs = 1;
+  r->seg[ 0 ].off  = 0;
+  r->seg[ 0 ].len  = n;
+  r->seg[ 0 ].pos  = off;
+  r->seg[ 0 ].size = ( off >= size ) ? 0 : ( size - off < n ) ? size - off : n;
+
+  return r->base;
+}
+
+// unmap region r, freeing any frame it had mapped
+static void unmap( vm_region_t* r ) {
+  for( uint32_t p = 0; p < r->len; p += VM_PAGE ) {
+    uint32_t* d = pte( r->base + p );
+
+    if( *d != 0 ) {
+      void** f = ( void** )( pte_frame( *d ) ); *f = vm_free; vm_free = f;
+
+      *d = 0; vm_stats.frames--;
+    }
+  }
+
+  mmu_flush();
+
+  fs_close( r->file ); r->used = false;
+}
+
+int vm_unmap( int owner, uint32_t x ) {
+  vm_region_t* r = in_window( x ) ? region( x ) : NULL;
+
+  if( r == NULL || r->owner != owner || r->base != x ) {
+    return VM_FAILURE;
+  }
+
+  unmap( r );
+
+  return VM_SUCCESS;
+}
+
+void vm_exit( int owner ) {
+  for( int i = 0; i < VM_REGIONS; i++ ) {
+    if( vm_regions[ i ].used && vm_regions[ i ].owner == owner && owner != VM_SHARED ) {
+      unmap( &vm_regions[ i ] );
+    }
+  }
+}
@@ -0,0 +1,111 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#ifndef __VM_H
+#define __VM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string.h>
+
+#include "MMU.h"
+#include "fs.h"
+
+/* Every process shares one address space, translated by the MMU via one
+ * level 1 page table in which
+ *
+ * - every 1 MiB section outside the mapping window is mapped onto itself,
+ *   i.e., the kernel and programs see memory and devices exactly as they
+ *   would with the MMU disabled, whereas
+ * - the mapping window, i.e., VM_LEN bytes from VM_BASE, is translated via
+ *   level 2 page tables of 4 KiB pages.
+ *
+ * Parts of the window are handed out as regions, each of which is backed
+ * by a file: pages start off unmapped, so the first access to each one
+ * raises an abort, and the abort handler calls vm_fault to read that page
+ * (and only that page) from the file into a free frame, map it, and have
+ * the access retried.  A region is made of up to VM_SEGS segments, each a
+ * range of the region that holds a range of the file (anything else reads
+ * as zero), and may list words to be relocated by adding the region base
+ * to them as each page is read: this is enough to describe either a file
+ * mapped via mmap, or a program image, which the loader maps this way if
+ * it is large enough that reading it all up front is not worthwhile.
+ *
+ * Mappings are private, i.e., a page written to is never written back,
+ * and pages are not reclaimed until the region is unmapped: a fault with
+ * no free frame, or an access outside any region or that a region does not
+ * allow, fails, so the process responsible is terminated.  The kernel
+ * itself must not fault part way through a system call, so every system
+ * call touches (so pages in) each buffer or string it is passed before
+ * using it, and fails (returning -1) if that is not possible.
+ */
+
+#define VM_BASE       ( 0xA0000000 )
+#define VM_LEN        ( 0x01000000 )
+#define VM_PAGE       ( 0x1000 )
+#define VM_REGIONS    ( 32 )
+#define VM_SEGS       (  4 )
+
+#define VM_SHARED     ( -1 )         // owner of a region that is not unmapped on exit
+
+#define VM_SUCCESS    (  0 )
+#define VM_FAILURE    ( -1 )
+
+typedef struct {
+  uint32_t   off;                   // offset of segment in region
+  uint32_t   len;                   // length of segment in region
+  uint32_t   pos;                   // offset of segment in file
+  uint32_t   size;                  // bytes of segment held by file, the rest being zero
+} vm_seg_t;
+
+typedef struct {
+  bool       used;                  // region in use?
+  int        owner;                 // PID of process that mapped region, or VM_SHARED
+  uint32_t   base;                  // first address of region
+  uint32_t   len;                   // length of region, a multiple of VM_PAGE
+  bool       write;                 // region writable?
+  fs_file_t* file;                  // file backing region, closed when region is unmapped
+
+  int        segs;                  // number of segments
+  vm_seg_t   seg[ VM_SEGS ];        // parts of region backed by file
+
+  uint32_t*  reloc;                 // offsets of words that hold an address relative to base
+  uint32_t   relocs;                // number of such words
+} vm_region_t;
+
+typedef struct {
+  uint32_t   faults;                // aborts handled
+  uint32_t   pageins;               // pages read from a file
+  uint32_t   frames;                // frames currently mapped
+  uint32_t   failed;                // aborts that terminated a process
+} vm_stat_t;
+
+extern vm_region_t vm_regions[ VM_REGIONS ];
+extern vm_stat_t   vm_stats;
+
+// use the memory from start up to (but excluding) end as frames, build the page tables, then enable the MMU
+extern void         vm_init ( void* start, void* end );
+
+// reserve a region of n bytes for owner, backed by file f but with no segments; return it, or NULL on failure
+extern vm_region_t* vm_map  ( int owner, fs_file_t* f, uint32_t n, bool write );
+// map n bytes of open file f for owner, from offset off (a multiple of VM_PAGE); return the address, or 0 on failure
+extern uint32_t     vm_mmap ( int owner, fs_file_t* f, uint32_t off, uint32_t n, bool write );
+// unmap the region owner mapped at address x
+extern int          vm_unmap( int owner, uint32_t x );
+// unmap every region owner mapped
+extern void         vm_exit ( int owner );
+
+// handle an abort caused by an access (a write iff. write) to address x; return true iff. it should be retried
+extern bool         vm_fault( uint32_t x, bool write );
+// make sure n bytes from address x can be accessed (written iff. write) without an abort; return true iff. so
+extern bool         vm_touch( uint32_t x, uint32_t n, bool write );
+// make sure the string at address x, terminated within n bytes, can be read without an abort; return true iff. so
+extern bool         vm_touch_str( uint32_t x, uint32_t n );
+
+#endif
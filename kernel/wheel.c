@@ -0,0 +1,101 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#include "wheel.h"
+
+wheel_t wheel;
+
+void wheel_init() {
+  memset( &wheel, 0, sizeof( wheel_t ) );
+}
+
+// place timer t at the head of the slot for its expiry, which is at most WHEEL_SLOTS^WHEEL_LEVELS - 1 ticks away (so in the last slot of the top level, if not)
+static void place( wheel_timer_t* t ) {
+  uint32_t d = t->expires - wheel.now, e = t->expires;
+  int      k = 0;
+
+  while( k < WHEEL_LEVELS - 1 && d >= ( 1UL << ( WHEEL_BITS * ( k + 1 ) ) ) ) {
+    k++;
+  }
+
+  if( d >= ( 1UL << ( WHEEL_BITS * WHEEL_LEVELS ) ) ) {
+    e = wheel.now + ( 1UL << ( WHEEL_BITS * WHEEL_LEVELS ) ) - 1;
+  }
+
+  wheel_timer_t** s = &wheel.slot[ k ][ ( e >> ( WHEEL_BITS * k ) ) & ( WHEEL_SLOTS - 1 ) ];
+
+  t->next = *s;
+  t->prev =  s;
+
+  if( t->next != NULL ) {
+    t->next->prev = &t->next;
+  }
+
+  *s = t;
+}
+
+// detach and return every timer in the slot s
+static wheel_timer_t* detach( wheel_timer_t** s ) {
+  wheel_timer_t* t = *s;
+
+  if( t != NULL ) {
+    t->prev = NULL;
+  }
+
+  *s = NULL;
+
+  return t;
+}
+
+void wheel_add( wheel_timer_t* t, uint32_t expires, void ( *f )( void* x ), void* x ) {
+  if( ( int32_t )( expires - wheel.now ) < 1 ) {
+    expires = wheel.now + 1;
+  }
+
+  t->expires = expires;
+  t->f       = f;
+  t->x       = x;
+
+  place( t );
+}
+
+void wheel_del( wheel_timer_t* t ) {
+  if( t->prev == NULL ) {
+    return;
+  }
+
+  *t->prev = t->next;
+
+  if( t->next != NULL ) {
+    t->next->prev = t->prev;
+  }
+
+  t->next = NULL;
+  t->prev = NULL;
+}
+
+void wheel_tick() {
+  wheel.now++;
+
+  // when level k - 1 wraps around, cascade the current slot of level k, which holds the timers that expire before level k - 1 wraps around again
+  for( int k = 1; k < WHEEL_LEVELS; k++ ) {
+    if( 0 != ( ( wheel.now >> ( WHEEL_BITS * ( k - 1 ) ) ) & ( WHEEL_SLOTS - 1 ) ) ) {
+      break;
+    }
+
+    for( wheel_timer_t* t = detach( &wheel.slot[ k ][ ( wheel.now >> ( WHEEL_BITS * k ) ) & ( WHEEL_SLOTS - 1 ) ] ), * n; t != NULL; t = n ) {
+      n = t->next; place( t );
+    }
+  }
+
+  // then expire each timer in the current slot of level 0, any of which may add a timer (but only to a later slot)
+  for( wheel_timer_t* t = detach( &wheel.slot[ 0 ][ wheel.now & ( WHEEL_SLOTS - 1 ) ] ), * n; t != NULL; t = n ) {
+    n = t->next; t->next = NULL; t->prev = NULL;
+
+    t->f( t->x );
+  }
+}
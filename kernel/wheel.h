@@ -0,0 +1,65 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#ifndef __WHEEL_H
+#define __WHEEL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string.h>
+
+/* The timer wheel keeps every pending timer (e.g., the wake-up of a
+ * sleeping process) in a hierarchy of WHEEL_LEVELS wheels, each of
+ * WHEEL_SLOTS slots: level 0 has one slot per tick, so holds the timers
+ * that expire in the next WHEEL_SLOTS ticks; level 1 has one slot per
+ * WHEEL_SLOTS ticks, so holds those that expire in the next WHEEL_SLOTS^2,
+ * and so on.  Each time level k - 1 wraps around, the next slot of level
+ * k is cascaded, i.e., its timers are placed again, now one level lower.
+ * So adding and deleting a timer takes constant time, as does a tick, bar
+ * the occasional cascade (at most once per timer per level), however many
+ * timers are pending; a timer beyond the top level is placed in its last
+ * slot, and cascaded until it is in range.
+ *
+ * Time is measured in ticks of WHEEL_HZ, as counted by wheel_tick (which
+ * the kernel calls on each interrupt of TIMER0), and wraps around after
+ * 2^32 ticks: an expiry is compared to the current time modulo 2^32, so
+ * must be less than 2^31 ticks away.  None of this touches the hardware,
+ * so it compiles for the host as well as the target.
+ */
+
+#define WHEEL_HZ     ( 1000 )   // ticks per second
+#define WHEEL_LEVELS (    4 )
+#define WHEEL_BITS   (    6 )
+#define WHEEL_SLOTS  ( 1 << WHEEL_BITS )
+
+typedef struct wheel_timer {
+  struct wheel_timer*  next;        // next timer in slot
+  struct wheel_timer** prev;        // pointer to this timer in slot, or NULL iff. not pending
+  uint32_t          expires;        // tick at which f is called
+  void ( *f )( void* x );           // function to call on expiry ...
+  void*                   x;        // ... and its argument
+} wheel_timer_t;
+
+typedef struct {
+  uint32_t       now;                                  // ticks so far
+  wheel_timer_t* slot[ WHEEL_LEVELS ][ WHEEL_SLOTS ];  // pending timers
+} wheel_t;
+
+extern wheel_t wheel;
+
+// forget every pending timer, and restart time from 0
+extern void wheel_init();
+// add timer t, such that f( x ) is called at tick expires (or the next tick, if that has passed); t must not be pending
+extern void wheel_add( wheel_timer_t* t, uint32_t expires, void ( *f )( void* x ), void* x );
+// delete timer t, iff. it is pending
+extern void wheel_del( wheel_timer_t* t );
+// advance time by one tick, calling the function of each timer which then expires
+extern void wheel_tick();
+
+#endif
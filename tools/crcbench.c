@@ -0,0 +1,174 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+/* This is a host-side benchmark for the CRC-32 used to checksum metadata
+ * blocks (see kernel/crc32.c), comparing, per block of --block-len bytes,
+ *
+ * bitwise     => the definition, i.e., 8 shift-and-XOR steps per byte,
+ * sarwate     => one table lookup per byte (i.e., crc32_table[ 0 ] only),
+ * slice-by-8  => the kernel implementation, 8 lookups per 8 bytes,
+ *
+ * with memcpy of the same block as a yardstick: the cost of checking a
+ * block read from the disk is best judged against the cost of copying it
+ * out of the cache.  Each implementation is first checked against the
+ * others (and the standard check value), so a faster but wrong variant
+ * cannot go unnoticed.  The numbers are for the host, of course, but the
+ * ratios between the variants are a guide to those on the target.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <getopt.h>
+#include <time.h>
+
+#include "crc32.h"
+
+extern uint32_t crc32_table[ 8 ][ 256 ];
+
+struct {
+  uint32_t block_len;
+  uint32_t blocks;
+} args = { 512, 200000 };
+
+static uint32_t crc32_bitwise( uint32_t c, const uint8_t* x, size_t n ) {
+  c = ~c;
+
+  while( n-- > 0 ) {
+    c ^= *x++;
+
+    for( int j = 0; j < 8; j++ ) {
+      c = ( c >> 1 ) ^ ( ( c & 1 ) ? CRC32_POLY : 0 );
+    }
+  }
+
+  return ~c;
+}
+
+static uint32_t crc32_sarwate( uint32_t c, const uint8_t* x, size_t n ) {
+  c = ~c;
+
+  while( n-- > 0 ) {
+    c = crc32_table[ 0 ][ ( c ^ *x++ ) & 0xFF ] ^ ( c >> 8 );
+  }
+
+  return ~c;
+}
+
+static uint32_t crc32_slice8( uint32_t c, const uint8_t* x, size_t n ) {
+  return crc32( c, x, n );
+}
+
+uint8_t* src;                       // blocks to checksum
+uint8_t* dst;                       // blocks to copy into
+volatile uint32_t sink;             // accumulated results, so no work is optimised away
+
+static double now() {
+  struct timespec t;
+
+  clock_gettime( CLOCK_MONOTONIC, &t );
+
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// report the time taken for args.blocks blocks, over a working set of 64 blocks (i.e., as if cached)
+static void report( const char* id, double t, double base ) {
+  double ns = t * 1e9 / args.blocks;
+
+  printf( "%-12s %10.1f ns/block %10.1f MiB/s", id, ns, ( ( double )( args.blocks ) * args.block_len ) / t / ( 1 << 20 ) );
+
+  if( base > 0 ) {
+    printf( " %8.2fx memcpy", t / base );
+  }
+
+  printf( "\n" );
+}
+
+static double bench_crc( uint32_t ( *f )( uint32_t, const uint8_t*, size_t ) ) {
+  double t = now();
+
+  for( uint32_t i = 0; i < args.blocks; i++ ) {
+    sink ^= f( 0, src + ( i % 64 ) * args.block_len, args.block_len );
+  }
+
+  return now() - t;
+}
+
+static double bench_copy() {
+  double t = now();
+
+  for( uint32_t i = 0; i < args.blocks; i++ ) {
+    memcpy( dst + ( i % 64 ) * args.block_len, src + ( i % 64 ) * args.block_len, args.block_len ); sink ^= dst[ i % args.block_len ];
+  }
+
+  return now() - t;
+}
+
+int main( int argc, char* argv[] ) {
+  static struct option opts[] = {
+    { "block-len", required_argument, NULL, 'l' },
+    { "blocks",    required_argument, NULL, 'n' },
+    { NULL,                        0, NULL,  0  }
+  };
+
+  for( int c; -1 != ( c = getopt_long( argc, argv, "", opts, NULL ) ); ) {
+    switch( c ) {
+      case 'l' : args.block_len = atoi( optarg ); break;
+      case 'n' : args.blocks    = atoi( optarg ); break;
+      default  : fprintf( stderr, "usage: %s [--block-len=N] [--blocks=N]\n", argv[ 0 ] ); return EXIT_FAILURE;
+    }
+  }
+
+  if( args.block_len == 0 || args.blocks == 0 ) {
+    fprintf( stderr, "block length and count must be non-zero\n" ); return EXIT_FAILURE;
+  }
+
+  crc32_init();
+
+  src = malloc( 64 * args.block_len );
+  dst = malloc( 64 * args.block_len );
+
+  if( src == NULL || dst == NULL ) {
+    perror( "malloc" ); return EXIT_FAILURE;
+  }
+
+  srand( 1 );
+
+  for( uint32_t i = 0; i < 64 * args.block_len; i++ ) {
+    src[ i ] = rand();
+  }
+
+  // check every variant agrees, including on unaligned starts and odd lengths
+  if( crc32_slice8( 0, ( const uint8_t* )( "123456789" ), 9 ) != CRC32_CHECK ) {
+    fprintf( stderr, "check value mismatch\n" ); return EXIT_FAILURE;
+  }
+
+  for( uint32_t o = 0; o < 8; o++ ) {
+    for( uint32_t n = 0; n + o <= args.block_len; n += 1 + n / 4 ) {
+      uint32_t a = crc32_bitwise( 0, src + o, n ), b = crc32_sarwate( 0, src + o, n ), c = crc32_slice8( 0, src + o, n );
+
+      if( a != b || a != c ) {
+        fprintf( stderr, "mismatch at offset %u, length %u: %08X %08X %08X\n", o, n, a, b, c ); return EXIT_FAILURE;
+      }
+    }
+  }
+
+  printf( "%u blocks of %u bytes\n", args.blocks, args.block_len );
+
+  double base = bench_copy();
+
+  report( "memcpy",     base,                          0    );
+  report( "bitwise",    bench_crc( &crc32_bitwise ), base );
+  report( "sarwate",    bench_crc( &crc32_sarwate ), base );
+  report( "slice-by-8", bench_crc( &crc32_slice8  ), base );
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,402 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+/* This is a drop-in replacement for device/disk.py, i.e., a host-side
+ * server that connects to the (emulated) UART used by device/disk.c and
+ * services the same line-based protocol:
+ *
+ * 00                    => query block count and length
+ * 01 <address> <data>   => write block
+ * 02 <address>          => read  block
+ *
+ * where each field is hexified, and each acknowledgement is 00 (okay) or
+ * 01 (fail) plus any hexified data.  Unlike disk.py, it
+ *
+ * - memory-maps the disk image, so reads and writes are just memcpy,
+ * - is event-driven: one poll loop reads whatever the socket has, decodes
+ *   every complete request in the buffer, and queues the acknowledgements
+ *   for a single write, and
+ * - makes durability configurable via --sync:
+ *   op    => msync the modified block after every write,
+ *   group => msync once --group-ops writes have accumulated, or once the
+ *            link has been idle for --group-ms milliseconds, and
+ *   none  => never msync (the kernel page cache decides), for benchmarks.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define REQ_CONF ( 0x00 )
+#define REQ_WR   ( 0x01 )
+#define REQ_RD   ( 0x02 )
+
+#define ACK_OKAY ( 0x00 )
+#define ACK_FAIL ( 0x01 )
+
+#define TELNET_IAC ( 0xFF )
+
+typedef enum { SYNC_OP, SYNC_GROUP, SYNC_NONE } sync_t;
+
+struct {
+  const char* host;
+  int         port;
+  const char* file;
+  uint32_t    block_num;
+  uint32_t    block_len;
+  sync_t      sync;
+  int         group_ops;
+  int         group_ms;
+  bool        debug;
+} args = { "127.0.0.1", 1236, "disk.bin", 8192, 512, SYNC_GROUP, 64, 10, false };
+
+uint8_t* disk;                      // memory-mapped disk image
+size_t   disk_size;
+
+size_t   dirty_lo = SIZE_MAX;       // byte range written since last msync
+size_t   dirty_hi = 0;
+int      dirty_ops = 0;             // writes since last msync
+
+typedef struct {
+  uint8_t* data;
+  size_t   size, used;
+} buf_t;
+
+buf_t rx, tx;
+
+static void buf_reserve( buf_t* b, size_t n ) {
+  if( b->used + n <= b->size ) {
+    return;
+  }
+  while( b->used + n > b->size ) {
+    b->size = ( b->size == 0 ) ? 65536 : 2 * b->size;
+  }
+  if( NULL == ( b->data = realloc( b->data, b->size ) ) ) {
+    perror( "realloc" ); exit( EXIT_FAILURE );
+  }
+}
+
+static int hex_nibble( uint8_t x ) {
+  if( x >= '0' && x <= '9' ) { return x - '0'; }
+  if( x >= 'a' && x <= 'f' ) { return x - 'a' + 10; }
+  if( x >= 'A' && x <= 'F' ) { return x - 'A' + 10; }
+  return -1;
+}
+
+// decode 2n hex characters from x into n bytes at r; false if malformed
+static bool unhex( uint8_t* r, const uint8_t* x, size_t n ) {
+  for( size_t i = 0; i < n; i++ ) {
+    int hi = hex_nibble( x[ 2 * i + 0 ] );
+    int lo = hex_nibble( x[ 2 * i + 1 ] );
+
+    if( hi < 0 || lo < 0 ) {
+      return false;
+    }
+    r[ i ] = ( hi << 4 ) | lo;
+  }
+  return true;
+}
+
+static void put_hex( const uint8_t* x, size_t n ) {
+  static const char digits[] = "0123456789abcdef";
+
+  buf_reserve( &tx, 2 * n );
+
+  for( size_t i = 0; i < n; i++ ) {
+    tx.data[ tx.used++ ] = digits[ x[ i ] >> 4  ];
+    tx.data[ tx.used++ ] = digits[ x[ i ] & 0xF ];
+  }
+}
+
+static void put_ack( uint8_t ack, const uint8_t* x, size_t n ) {
+  put_hex( &ack, 1 );
+
+  if( x != NULL ) {
+    buf_reserve( &tx, 1 ); tx.data[ tx.used++ ] = ' ';
+    put_hex( x, n );
+  }
+
+  buf_reserve( &tx, 1 ); tx.data[ tx.used++ ] = '\n';
+}
+
+static void disk_commit() {
+  if( dirty_ops == 0 ) {
+    return;
+  }
+
+  // msync needs a page-aligned start address
+  size_t page = sysconf( _SC_PAGESIZE ), lo = dirty_lo & ~( page - 1 );
+
+  if( 0 != msync( disk + lo, dirty_hi - lo, MS_SYNC ) ) {
+    perror( "msync" );
+  }
+
+  dirty_lo = SIZE_MAX; dirty_hi = 0; dirty_ops = 0;
+}
+
+// decode 4-byte little-endian address at x, as written by addr_puth
+static bool get_addr( uint32_t* a, const uint8_t* x, size_t n ) {
+  uint8_t t[ 4 ];
+
+  if( n < 8 || !unhex( t, x, 4 ) ) {
+    return false;
+  }
+
+  *a = ( ( uint32_t )( t[ 0 ] ) <<  0 ) | ( ( uint32_t )( t[ 1 ] ) <<  8 ) |
+       ( ( uint32_t )( t[ 2 ] ) << 16 ) | ( ( uint32_t )( t[ 3 ] ) << 24 ) ;
+
+  return *a < args.block_num;
+}
+
+// process one request line x of length n (excluding EOL)
+static void process( const uint8_t* x, size_t n ) {
+  uint8_t  cmd;
+  uint32_t a;
+
+  if( n < 2 || !unhex( &cmd, x, 1 ) ) {
+    put_ack( ACK_FAIL, NULL, 0 ); return;
+  }
+
+  if     ( cmd == REQ_CONF ) {
+    uint8_t t[ 8 ];
+
+    for( int i = 0; i < 4; i++ ) {
+      t[ i + 0 ] = ( args.block_num >> ( 8 * i ) ) & 0xFF;
+      t[ i + 4 ] = ( args.block_len >> ( 8 * i ) ) & 0xFF;
+    }
+
+    put_ack( ACK_OKAY, t, 8 );
+  }
+  else if( cmd == REQ_WR   ) {
+    if( n != 3 + 8 + 1 + 2 * args.block_len || !get_addr( &a, x + 3, n - 3 ) ) {
+      put_ack( ACK_FAIL, NULL, 0 ); return;
+    }
+
+    size_t o = ( size_t )( a ) * args.block_len;
+
+    if( !unhex( disk + o, x + 12, args.block_len ) ) {
+      put_ack( ACK_FAIL, NULL, 0 ); return;
+    }
+
+    dirty_lo = ( o < dirty_lo ) ? o : dirty_lo;
+    dirty_hi = ( o + args.block_len > dirty_hi ) ? o + args.block_len : dirty_hi;
+    dirty_ops++;
+
+    if( args.sync == SYNC_OP || ( args.sync == SYNC_GROUP && dirty_ops >= args.group_ops ) ) {
+      disk_commit();
+    }
+
+    if( args.debug ) {
+      printf( "diskd : wr %u bytes -> address %X\n", args.block_len, a );
+    }
+
+    put_ack( ACK_OKAY, NULL, 0 );
+  }
+  else if( cmd == REQ_RD   ) {
+    if( n != 3 + 8 || !get_addr( &a, x + 3, n - 3 ) ) {
+      put_ack( ACK_FAIL, NULL, 0 ); return;
+    }
+
+    if( args.debug ) {
+      printf( "diskd : rd %u bytes <- address %X\n", args.block_len, a );
+    }
+
+    put_ack( ACK_OKAY, disk + ( size_t )( a ) * args.block_len, args.block_len );
+  }
+  else {
+    put_ack( ACK_FAIL, NULL, 0 );
+  }
+}
+
+/* Decode every complete line in the receive buffer, then shift any partial
+ * line down to the start.  Telnet negotiation (IAC, command, option) from
+ * the QEMU end of the socket is skipped, as is any CR before an EOL.
+ */
+
+static void process_all() {
+  size_t s = 0;
+
+  for( size_t i = 0; i < rx.used; i++ ) {
+    if( rx.data[ i ] == TELNET_IAC ) {
+      if( i + 3 > rx.used ) {
+        break;
+      }
+      memmove( rx.data + i, rx.data + i + 3, rx.used - i - 3 ); rx.used -= 3; i--;
+    }
+    else if( rx.data[ i ] == '\n' ) {
+      size_t e = i;
+
+      while( e > s && ( rx.data[ e - 1 ] == '\r' || rx.data[ e - 1 ] == ' ' ) ) {
+        e--;
+      }
+      while( s < e && ( rx.data[ s ] == '\r' || rx.data[ s ] == '\0' ) ) {
+        s++;
+      }
+
+      if( e > s ) {
+        process( rx.data + s, e - s );
+      }
+
+      s = i + 1;
+    }
+  }
+
+  memmove( rx.data, rx.data + s, rx.used - s ); rx.used -= s;
+}
+
+static void usage( const char* x ) {
+  fprintf( stderr, "usage: %s --host=H --port=P --file=F --block-num=N --block-len=L\n", x );
+  fprintf( stderr, "          [--sync=op|group|none] [--group-ops=N] [--group-ms=T] [--debug]\n" );
+  exit( EXIT_FAILURE );
+}
+
+int main( int argc, char* argv[] ) {
+  // parse command line arguments
+
+  static struct option opts[] = {
+    { "host",      required_argument, NULL, 'h' },
+    { "port",      required_argument, NULL, 'p' },
+    { "file",      required_argument, NULL, 'f' },
+    { "block-num", required_argument, NULL, 'n' },
+    { "block-len", required_argument, NULL, 'l' },
+    { "sync",      required_argument, NULL, 's' },
+    { "group-ops", required_argument, NULL, 'o' },
+    { "group-ms",  required_argument, NULL, 't' },
+    { "debug",           no_argument, NULL, 'd' },
+    { NULL,                        0, NULL,  0  }
+  };
+
+  for( int c; -1 != ( c = getopt_long( argc, argv, "", opts, NULL ) ); ) {
+    switch( c ) {
+      case 'h' : args.host      =       optarg;   break;
+      case 'p' : args.port      = atoi( optarg ); break;
+      case 'f' : args.file      =       optarg;   break;
+      case 'n' : args.block_num = atoi( optarg ); break;
+      case 'l' : args.block_len = atoi( optarg ); break;
+      case 'o' : args.group_ops = atoi( optarg ); break;
+      case 't' : args.group_ms  = atoi( optarg ); break;
+      case 'd' : args.debug     = true;           break;
+      case 's' : {
+        if     ( 0 == strcmp( optarg, "op"    ) ) { args.sync = SYNC_OP;    }
+        else if( 0 == strcmp( optarg, "group" ) ) { args.sync = SYNC_GROUP; }
+        else if( 0 == strcmp( optarg, "none"  ) ) { args.sync = SYNC_NONE;  }
+        else                                      { usage( argv[ 0 ] );     }
+        break;
+      }
+      default  : usage( argv[ 0 ] );
+    }
+  }
+
+  // the kernel accepts power-of-two block lengths from 16 bytes to 4 KiB
+
+  if( args.block_len < 16 || args.block_len > 4096 || ( args.block_len & ( args.block_len - 1 ) ) ) {
+    fprintf( stderr, "block length must be a power of two between 16 and 4096\n" ); return EXIT_FAILURE;
+  }
+
+  // open and map disk image, growing the file if it is too small
+
+  int fd = open( args.file, O_RDWR );
+
+  if( fd < 0 ) {
+    perror( "open" ); return EXIT_FAILURE;
+  }
+
+  disk_size = ( size_t )( args.block_num ) * args.block_len;
+
+  struct stat st;
+
+  if( 0 != fstat( fd, &st ) || ( ( size_t )( st.st_size ) < disk_size && 0 != ftruncate( fd, disk_size ) ) ) {
+    perror( "ftruncate" ); return EXIT_FAILURE;
+  }
+  if( MAP_FAILED == ( disk = mmap( NULL, disk_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 ) ) ) {
+    perror( "mmap" ); return EXIT_FAILURE;
+  }
+
+  // open network connection
+
+  int sd = socket( AF_INET, SOCK_STREAM, 0 ), one = 1;
+
+  struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons( args.port ) };
+
+  if( sd < 0 || 1 != inet_pton( AF_INET, args.host, &addr.sin_addr ) ) {
+    perror( "socket" ); return EXIT_FAILURE;
+  }
+  if( 0 != connect( sd, ( struct sockaddr* )( &addr ), sizeof( addr ) ) ) {
+    perror( "connect" ); return EXIT_FAILURE;
+  }
+
+  setsockopt( sd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof( one ) );
+
+  fcntl( sd, F_SETFL, fcntl( sd, F_GETFL ) | O_NONBLOCK );
+
+  // read requests, process them and write acknowledgements until the link closes
+
+  while( true ) {
+    struct pollfd p = { .fd = sd, .events = POLLIN | ( tx.used > 0 ? POLLOUT : 0 ) };
+
+    int timeout = ( args.sync == SYNC_GROUP && dirty_ops > 0 ) ? args.group_ms : -1;
+    int r       = poll( &p, 1, timeout );
+
+    if( r < 0 ) {
+      perror( "poll" ); break;
+    }
+    if( r == 0 ) {
+      disk_commit(); continue;  // link idle: commit the group
+    }
+
+    if( p.revents & POLLIN ) {
+      buf_reserve( &rx, 65536 );
+
+      ssize_t n = read( sd, rx.data + rx.used, rx.size - rx.used );
+
+      if( n == 0 || ( n < 0 && errno != EAGAIN ) ) {
+        break;
+      }
+      if( n > 0 ) {
+        rx.used += n; process_all();
+      }
+    }
+    if( tx.used > 0 ) {
+      ssize_t n = write( sd, tx.data, tx.used );
+
+      if( n < 0 && errno != EAGAIN ) {
+        perror( "write" ); break;
+      }
+      if( n > 0 ) {
+        memmove( tx.data, tx.data + n, tx.used - n ); tx.used -= n;
+      }
+    }
+    if( p.revents & ( POLLERR | POLLHUP ) ) {
+      break;
+    }
+  }
+
+  // commit outstanding writes, close network connection and disk image
+
+  if( args.sync != SYNC_NONE ) {
+    disk_commit();
+  }
+
+  close( sd ); munmap( disk, disk_size ); close( fd );
+
+  return EXIT_SUCCESS;
+}
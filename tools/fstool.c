@@ -0,0 +1,980 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+/* This is a host-side tool that works directly on a memory-mapped disk
+ * image, using the on-disk layout shared with the kernel via
+ * kernel/fs_layout.h, so images can be prepared (and checked) without
+ * going through the kernel one block at a time over UART:
+ *
+ * format                 => write an empty file system, i.e., just a root
+ *                           directory (the only way to create one),
+ * import <src> [<dst>]   => copy the host file or directory tree src into
+ *                           the directory dst (default /), creating dst if
+ *                           need be,
+ * fsck                   => check the file system is consistent, and
+ *                           that each metadata block matches its checksum.
+ *
+ * Files are laid out as the kernel would (e.g., a file is one extent if
+ * there is a free run long enough), and directories are hash tables with
+ * the same bucket placement and growth policy, so the kernel can mount
+ * and use the image as is.  A committed transaction left in the journal
+ * is replayed before anything else is done, then the journal is emptied:
+ * otherwise the kernel would replay it over any changes made here.
+ * Likewise, the checksum of every metadata block is recomputed after an
+ * import, since the blocks are modified in place rather than via the
+ * journal (which is where the kernel updates them).
+ *
+ * The image is little-endian, as is every host this is expected to run
+ * on, so the structures in it are accessed in place.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "crc32.h"
+#include "fs_layout.h"
+
+struct {
+  const char* file;
+  uint32_t    block_num;
+  uint32_t    block_len;
+  bool        verbose;
+  bool        csum;
+} args = { "disk.bin", 8192, 512, false, true };
+
+uint8_t* disk;                      // memory-mapped disk image
+size_t   disk_size;
+s_block* sb;                        // superblock, in place
+
+uint32_t dhint;                     // next-fit hint for data  block allocation
+uint32_t ihint;                     // next-fit hint for inode       allocation
+
+int      errors = 0;                // inconsistencies found by fsck
+
+/* The following functions give access to blocks, bitmaps and inodes */
+
+static uint8_t* blk( uint32_t a ) {
+  return disk + ( size_t )( a ) * args.block_len;
+}
+
+static inode* iget( uint32_t ino ) {
+  uint32_t ipb = args.block_len / FS_INODE_LEN;
+
+  return ( inode* )( blk( sb->itable_start + ino / ipb ) + ( ino % ipb ) * FS_INODE_LEN );
+}
+
+static bool bit_get( uint32_t s, uint32_t i ) {
+  uint32_t  bpb = 8 * args.block_len;
+  uint32_t* w   = ( uint32_t* )( blk( s + i / bpb ) );
+
+  return 0 != ( w[ ( i % bpb ) / 32 ] & ( 0x80000000 >> ( i % 32 ) ) );
+}
+
+static void bit_put( uint32_t s, uint32_t i, bool x ) {
+  uint32_t  bpb = 8 * args.block_len;
+  uint32_t* w   = ( uint32_t* )( blk( s + i / bpb ) );
+
+  if( x ) {
+    w[ ( i % bpb ) / 32 ] |=  ( 0x80000000 >> ( i % 32 ) );
+  }
+  else {
+    w[ ( i % bpb ) / 32 ] &= ~( 0x80000000 >> ( i % 32 ) );
+  }
+}
+
+/* Allocate a run of up to n free data blocks, the first at or after the
+ * hint; the start address is returned (or 0 if the disk is full) and the
+ * run length via m.  Content is zeroed.
+ */
+
+static uint32_t balloc( uint32_t n, uint32_t* m ) {
+  uint32_t span = sb->block_num - sb->data_start;
+
+  for( uint32_t k = 0; k < span; k++ ) {
+    uint32_t a = sb->data_start + ( dhint - sb->data_start + k ) % span;
+
+    if( bit_get( sb->dbitmap_start, a ) ) {
+      continue;
+    }
+
+    for( *m = 0; *m < n && a + *m < sb->block_num && !bit_get( sb->dbitmap_start, a + *m ); ( *m )++ ) {
+      bit_put( sb->dbitmap_start, a + *m, true );
+    }
+
+    memset( blk( a ), 0, ( size_t )( *m ) * args.block_len );
+
+    sb->free_blocks -= *m; dhint = a + *m;
+
+    return a;
+  }
+
+  return 0;
+}
+
+static void bfree( uint32_t a ) {
+  bit_put( sb->dbitmap_start, a, false ); sb->free_blocks++;
+}
+
+// allocate and initialise an inode of type t; return inode number or 0 on failure
+static uint32_t ialloc( uint8_t t ) {
+  for( uint32_t k = 0; k < sb->inode_num; k++ ) {
+    uint32_t ino = ( ihint + k ) % sb->inode_num;
+
+    if( ino == 0 || bit_get( sb->ibitmap_start, ino ) ) {
+      continue;
+    }
+
+    bit_put( sb->ibitmap_start, ino, true ); sb->inode_count++; ihint = ino + 1;
+
+    inode* x = iget( ino );
+
+    memset( x, 0, sizeof( inode ) );
+    x->i_ino   = ino;
+    x->i_type  = t;
+    x->i_nlink = 1;
+
+    return ino;
+  }
+
+  return 0;
+}
+
+/* The following functions deal with extents, as in kernel/fs.c */
+
+static uint32_t ext_max() {
+  return FS_EXTENTS + args.block_len / sizeof( extent );
+}
+
+static extent* ext_ref( inode* x, uint32_t k ) {
+  return ( k < FS_EXTENTS ) ? &x->i_extents[ k ] : &( ( extent* )( blk( x->i_ext_block ) ) )[ k - FS_EXTENTS ];
+}
+
+// map block i of inode x to a disk block address, or 0 if there is no such block
+static uint32_t bmap( inode* x, uint32_t i ) {
+  for( uint32_t k = 0; k < x->i_nextents; k++ ) {
+    extent* e = ext_ref( x, k );
+
+    if( i < e->e_len ) {
+      return e->e_start + i;
+    }
+
+    i -= e->e_len;
+  }
+
+  return 0;
+}
+
+// grow inode x to n (zeroed) blocks, extending the last extent where possible
+static bool iextend( inode* x, uint32_t n ) {
+  while( x->i_blocks < n ) {
+    uint32_t m, a = balloc( n - x->i_blocks, &m );
+
+    if( a == 0 ) {
+      return false;
+    }
+
+    extent* e = ( x->i_nextents > 0 ) ? ext_ref( x, x->i_nextents - 1 ) : NULL;
+
+    if( e != NULL && e->e_start + e->e_len == a ) {
+      e->e_len += m;
+    }
+    else {
+      if( x->i_nextents >= ext_max() ) {
+        return false;
+      }
+      if( x->i_nextents == FS_EXTENTS ) {
+        uint32_t k;
+
+        if( 0 == ( x->i_ext_block = balloc( 1, &k ) ) ) {
+          return false;
+        }
+      }
+
+      e = ext_ref( x, x->i_nextents++ ); e->e_start = a; e->e_len = m;
+    }
+
+    x->i_blocks += m;
+  }
+
+  return true;
+}
+
+// release every data block of inode x
+static void itrunc( inode* x ) {
+  for( uint32_t k = 0; k < x->i_nextents; k++ ) {
+    extent* e = ext_ref( x, k );
+
+    for( uint32_t i = 0; i < e->e_len; i++ ) {
+      bfree( e->e_start + i );
+    }
+  }
+
+  if( x->i_ext_block != 0 ) {
+    bfree( x->i_ext_block );
+  }
+
+  memset( x->i_extents, 0, sizeof( x->i_extents ) );
+
+  x->i_ext_block = 0;
+  x->i_nextents  = 0;
+  x->i_size      = 0;
+  x->i_blocks    = 0;
+}
+
+/* The following functions deal with directories, as in kernel/fs.c */
+
+static dir_entry* dir_bucket( inode* d, uint32_t k ) {
+  return ( dir_entry* )( blk( bmap( d, k ) ) );
+}
+
+// look up name n of length l in directory d; return inode number or 0
+static uint32_t dir_lookup( inode* d, const char* n, int l ) {
+  uint32_t epb = args.block_len / sizeof( dir_entry ), h = fs_name_hash( n, l );
+
+  for( uint32_t p = 0; p < d->i_buckets; p++ ) {
+    dir_entry* b = dir_bucket( d, ( h + p ) % d->i_buckets );
+    bool       f = false;
+
+    for( uint32_t i = 0; i < epb; i++ ) {
+      if( b[ i ].d_ino != 0 && b[ i ].d_len == l && 0 == memcmp( b[ i ].d_name, n, l ) ) {
+        return b[ i ].d_ino;
+      }
+
+      f |= ( b[ i ].d_ino == 0 && b[ i ].d_len == 0 );
+    }
+
+    if( f ) {
+      break;
+    }
+  }
+
+  return 0;
+}
+
+static bool dir_place( inode* d, const dir_entry* x ) {
+  uint32_t epb = args.block_len / sizeof( dir_entry ), h = fs_name_hash( x->d_name, x->d_len );
+
+  for( uint32_t p = 0; p < d->i_buckets; p++ ) {
+    dir_entry* b = dir_bucket( d, ( h + p ) % d->i_buckets );
+
+    for( uint32_t i = 0; i < epb; i++ ) {
+      if( b[ i ].d_ino == 0 ) {
+        b[ i ] = *x; return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+// give directory d a table of m buckets, rehashing any entries it has into it
+static bool dir_resize( inode* d, uint32_t m ) {
+  uint32_t epb = args.block_len / sizeof( dir_entry );
+  inode    o   = *d;
+
+  memset( d->i_extents, 0, sizeof( d->i_extents ) );
+
+  d->i_ext_block = 0;
+  d->i_nextents  = 0;
+  d->i_blocks    = 0;
+
+  if( !iextend( d, m ) ) {
+    return false;
+  }
+
+  d->i_buckets = m;
+  d->i_size    = m * args.block_len;
+
+  for( uint32_t k = 0; k < o.i_buckets; k++ ) {
+    for( uint32_t i = 0; i < epb; i++ ) {
+      dir_entry* e = &dir_bucket( &o, k )[ i ];
+
+      if( e->d_ino != 0 && !dir_place( d, e ) ) {
+        return false;
+      }
+    }
+  }
+
+  itrunc( &o );
+
+  return true;
+}
+
+// add entry mapping name n of length l to inode number ino in directory d, doubling the table once 3/4 full
+static bool dir_add( inode* d, const char* n, int l, uint32_t ino ) {
+  uint32_t  epb = args.block_len / sizeof( dir_entry );
+  dir_entry e;
+
+  if( 4 * ( d->i_entries + 1 ) > 3 * d->i_buckets * epb && !dir_resize( d, 2 * d->i_buckets ) ) {
+    return false;
+  }
+
+  memset( &e, 0, sizeof( dir_entry ) );
+  e.d_ino = ino;
+  e.d_len = l;
+  memcpy( e.d_name, n, l );
+
+  if( !dir_place( d, &e ) ) {
+    return false;
+  }
+
+  d->i_entries++;
+
+  return true;
+}
+
+// create a directory d's content: a one-bucket table holding the entries . and .. (whose parent is p)
+static bool dir_init( inode* d, uint32_t p ) {
+  d->i_nlink = 2;
+
+  return dir_resize( d, 1 ) && dir_add( d, ".", 1, d->i_ino ) && dir_add( d, "..", 2, p );
+}
+
+// create a directory named n of length l in directory p; return inode number or 0 on failure
+static uint32_t dir_make( inode* p, const char* n, int l ) {
+  uint32_t ino = ialloc( FS_TYPE_DIR );
+
+  if( ino == 0 || !dir_init( iget( ino ), p->i_ino ) || !dir_add( p, n, l, ino ) ) {
+    return 0;
+  }
+
+  p->i_nlink++;
+
+  return ino;
+}
+
+/* The following functions deal with the journal, as in kernel/journal.c */
+
+// copy a committed transaction (if any) home, then empty the journal
+static void journal_replay() {
+  journal_header* h = ( journal_header* )( blk( sb->journal_start ) );
+
+  if( sb->journal_len <= 2 || h->j_magic != FS_JOURNAL_MAGIC || h->j_type != FS_JOURNAL_DESC || h->j_count + 2 > sb->journal_len ) {
+    return;
+  }
+
+  uint32_t        n = h->j_count;
+  journal_header* c = ( journal_header* )( blk( sb->journal_start + 1 + n ) );
+
+  if( c->j_magic == FS_JOURNAL_MAGIC && c->j_type == FS_JOURNAL_COMMIT && c->j_seq == h->j_seq && c->j_count == n ) {
+    uint32_t* a = ( uint32_t* )( h + 1 );
+
+    printf( "replaying journal transaction %u (%u blocks)\n", h->j_seq, n );
+
+    for( uint32_t i = 0; i < n; i++ ) {
+      if( a[ i ] < sb->block_num ) {
+        memmove( blk( a[ i ] ), blk( sb->journal_start + 1 + i ), args.block_len );
+      }
+    }
+  }
+
+  memset( blk( sb->journal_start ), 0, args.block_len );
+}
+
+/* The following functions deal with checksums, as in kernel/csum.c */
+
+// checksum table entry of block a
+static uint32_t* csum_ref( uint32_t a ) {
+  uint32_t epb = args.block_len / sizeof( uint32_t );
+
+  return &( ( uint32_t* )( blk( sb->csum_start + a / epb ) ) )[ a % epb ];
+}
+
+// checksum of the content of block a
+static uint32_t csum_of( uint32_t a ) {
+  return fs_csum_tag( crc32( 0, blk( a ), args.block_len ) );
+}
+
+/* Call f for each metadata block with a checksum, i.e., the bitmaps and
+ * inode table, plus the extent block and (for a directory) the buckets
+ * of each allocated inode.
+ */
+
+static void csum_walk( void ( *f )( uint32_t a ) ) {
+  for( uint32_t a = sb->ibitmap_start; a < sb->csum_start; a++ ) {
+    f( a );
+  }
+
+  for( uint32_t i = 1; i < sb->inode_num; i++ ) {
+    inode* x = iget( i );
+
+    if( !bit_get( sb->ibitmap_start, i ) || x->i_nextents > ext_max() ) {
+      continue;
+    }
+    if( x->i_ext_block != 0 && x->i_ext_block < sb->block_num ) {
+      f( x->i_ext_block );
+    }
+    if( x->i_type == FS_TYPE_DIR ) {
+      for( uint32_t k = 0; k < x->i_buckets && k < x->i_blocks; k++ ) {
+        uint32_t a = bmap( x, k );
+
+        if( a != 0 && a < sb->block_num ) {
+          f( a );
+        }
+      }
+    }
+  }
+}
+
+static void csum_put( uint32_t a ) {
+  *csum_ref( a ) = csum_of( a );
+}
+
+// recompute the whole checksum table (iff. there is one)
+static void csum_rebuild() {
+  if( sb->csum_len == 0 ) {
+    return;
+  }
+
+  memset( blk( sb->csum_start ), 0, ( size_t )( sb->csum_len ) * args.block_len );
+
+  csum_walk( &csum_put );
+}
+
+/* The following functions implement each command */
+
+static int cmd_format() {
+  uint32_t n   = args.block_num;
+  uint32_t bpb = 8 * args.block_len;
+
+  if( args.block_len < FS_BLOCK_MIN ) {
+    fprintf( stderr, "block length must be at least %d\n", FS_BLOCK_MIN ); return EXIT_FAILURE;
+  }
+
+  // the layout computed here is the one kernel/fs.c expects, per fs_layout.h
+
+  s_block s;
+
+  memset( &s, 0, sizeof( s_block ) );
+
+  s.magic         = FS_MAGIC;
+  s.block_len     = args.block_len;
+  s.block_num     = n;
+  s.inode_num     = ( n / FS_INODE_RATIO > 65535 ) ? 65535 : n / FS_INODE_RATIO;
+  s.root_inode    = FS_ROOT_INO;
+
+  s.ibitmap_start = 1;
+  s.dbitmap_start = s.ibitmap_start + ( s.inode_num + bpb - 1 ) / bpb;
+  s.itable_start  = s.dbitmap_start + ( s.block_num + bpb - 1 ) / bpb;
+  s.csum_start    = s.itable_start  + ( s.inode_num * FS_INODE_LEN + args.block_len - 1 ) / args.block_len;
+  s.csum_len      = args.csum ? fs_csum_len( n, args.block_len ) : 0;
+  s.journal_start = s.csum_start    + s.csum_len;
+  s.journal_len   = ( n / 16 > FS_JOURNAL_LEN ) ? FS_JOURNAL_LEN : n / 16;
+  s.data_start    = s.journal_start + s.journal_len;
+
+  if( s.data_start >= n ) {
+    fprintf( stderr, "disk too small\n" ); return EXIT_FAILURE;
+  }
+
+  s.free_blocks   = n - s.data_start;
+
+  memset( disk, 0, ( size_t )( s.data_start ) * args.block_len );
+  memcpy( disk, &s, sizeof( s_block ) );
+
+  bit_put( sb->ibitmap_start, 0, true );
+
+  for( uint32_t i = sb->inode_num; i < ( sb->dbitmap_start - sb->ibitmap_start ) * bpb; i++ ) {
+    bit_put( sb->ibitmap_start, i, true );
+  }
+  for( uint32_t i = 0;             i < sb->data_start;                                   i++ ) {
+    bit_put( sb->dbitmap_start, i, true );
+  }
+  for( uint32_t i = sb->block_num; i < ( sb->itable_start  - sb->dbitmap_start ) * bpb; i++ ) {
+    bit_put( sb->dbitmap_start, i, true );
+  }
+
+  dhint = sb->data_start;
+  ihint = FS_ROOT_INO;
+
+  // create the root directory, which is its own parent
+  if( FS_ROOT_INO != ialloc( FS_TYPE_DIR ) || !dir_init( iget( FS_ROOT_INO ), FS_ROOT_INO ) ) {
+    fprintf( stderr, "cannot create root directory\n" ); return EXIT_FAILURE;
+  }
+
+  csum_rebuild();
+
+  printf( "formatted %u blocks of %u bytes: %u inodes, %u data blocks\n", n, args.block_len, sb->inode_num, sb->free_blocks );
+
+  return EXIT_SUCCESS;
+}
+
+// copy the host file at path into a new file named n of length l in directory d
+static bool import_file( inode* d, const char* n, int l, const char* path, off_t size ) {
+  uint32_t ino;
+  int      fd = open( path, O_RDONLY );
+
+  if( fd < 0 ) {
+    perror( path ); return false;
+  }
+  if( 0 == ( ino = ialloc( FS_TYPE_FILE ) ) || !iextend( iget( ino ), ( size + args.block_len - 1 ) / args.block_len ) || !dir_add( d, n, l, ino ) ) {
+    fprintf( stderr, "%s: file system full\n", path ); close( fd ); return false;
+  }
+
+  inode* x = iget( ino );
+
+  x->i_size = size;
+
+  // read straight into the image, one extent at a time
+  for( uint32_t k = 0, r = 0; k < x->i_nextents && r < size; k++ ) {
+    extent* e = ext_ref( x, k );
+    size_t  m = ( size_t )( e->e_len ) * args.block_len;
+
+    m = ( m < size - r ) ? m : size - r;
+
+    if( ( ssize_t )( m ) != read( fd, blk( e->e_start ), m ) ) {
+      perror( path ); close( fd ); return false;
+    }
+
+    r += m;
+  }
+
+  close( fd );
+
+  return true;
+}
+
+// copy the host file or directory tree at path into directory d, as name n of length l
+static bool import_tree( inode* d, const char* n, int l, const char* path ) {
+  struct stat st;
+
+  if( l == 0 || l > FS_NAME_MAX ) {
+    fprintf( stderr, "%s: name too long, skipped\n", path ); return true;
+  }
+  if( 0 != stat( path, &st ) ) {
+    perror( path ); return false;
+  }
+  if( 0 != dir_lookup( d, n, l ) ) {
+    fprintf( stderr, "%s: already exists, skipped\n", path ); return true;
+  }
+
+  if( args.verbose ) {
+    printf( "%s\n", path );
+  }
+
+  if( S_ISREG( st.st_mode ) ) {
+    return import_file( d, n, l, path, st.st_size );
+  }
+  if( !S_ISDIR( st.st_mode ) ) {
+    fprintf( stderr, "%s: not a file or directory, skipped\n", path ); return true;
+  }
+
+  uint32_t ino = dir_make( d, n, l );
+  DIR*     dp  = opendir( path );
+  bool     r   = true;
+
+  if( ino == 0 || dp == NULL ) {
+    fprintf( stderr, "%s: cannot create directory\n", path ); return false;
+  }
+
+  for( struct dirent* e; r && NULL != ( e = readdir( dp ) ); ) {
+    if( 0 == strcmp( e->d_name, "." ) || 0 == strcmp( e->d_name, ".." ) ) {
+      continue;
+    }
+
+    char* p = malloc( strlen( path ) + strlen( e->d_name ) + 2 );
+
+    sprintf( p, "%s/%s", path, e->d_name );
+
+    r = import_tree( iget( ino ), e->d_name, strlen( e->d_name ), p );
+
+    free( p );
+  }
+
+  closedir( dp );
+
+  return r;
+}
+
+static int cmd_import( const char* src, const char* dst ) {
+  inode* d = iget( sb->root_inode );
+
+  dhint = sb->data_start;
+  ihint = FS_ROOT_INO;
+
+  // resolve the destination, creating any directory that is missing
+  for( const char* p = dst; *p != '\0'; ) {
+    while( *p == '/' ) {
+      p++;
+    }
+
+    const char* c = p;
+
+    while( *p != '/' && *p != '\0' ) {
+      p++;
+    }
+
+    if( p == c ) {
+      break;
+    }
+    if( p - c > FS_NAME_MAX ) {
+      fprintf( stderr, "%s: name too long\n", dst ); return EXIT_FAILURE;
+    }
+
+    uint32_t ino = dir_lookup( d, c, p - c );
+
+    if( ino == 0 && 0 == ( ino = dir_make( d, c, p - c ) ) ) {
+      fprintf( stderr, "%s: cannot create directory\n", dst ); return EXIT_FAILURE;
+    }
+    if( iget( ino )->i_type != FS_TYPE_DIR ) {
+      fprintf( stderr, "%s: not a directory\n", dst ); return EXIT_FAILURE;
+    }
+
+    d = iget( ino );
+  }
+
+  // the name is the last component of the source path
+  char* s = strdup( src ); size_t l = strlen( s );
+
+  while( l > 1 && s[ l - 1 ] == '/' ) {
+    s[ --l ] = '\0';
+  }
+
+  const char* n = strrchr( s, '/' );
+
+  n = ( n == NULL ) ? s : n + 1;
+
+  bool r = import_tree( d, n, strlen( n ), s );
+
+  free( s ); csum_rebuild();
+
+  printf( "imported %s: %u inodes in use, %u data blocks free\n", src, sb->inode_count, sb->free_blocks );
+
+  return r ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#define FSCK_ERROR( ... ) { fprintf( stderr, __VA_ARGS__ ); fputc( '\n', stderr ); errors++; }
+
+uint32_t* fsck_owner;               // inode owning each block (or ~0 for metadata)
+uint32_t* fsck_links;               // directory entries referring to each inode
+bool*     fsck_seen;                // inodes checked
+
+// check the checksum of metadata block a (if it has one) matches its content
+static void fsck_csum( uint32_t a ) {
+  uint32_t c = *csum_ref( a );
+
+  if( c != FS_CSUM_NONE && c != csum_of( a ) ) {
+    FSCK_ERROR( "block %u: checksum %08X, but content has %08X", a, c, csum_of( a ) );
+  }
+}
+
+// check block a is in the data region and not used twice, then record it as used by inode ino
+static void fsck_block( uint32_t ino, uint32_t a ) {
+  if( a < sb->data_start || a >= sb->block_num ) {
+    FSCK_ERROR( "inode %u: block %u outside data region", ino, a );
+  }
+  else if( fsck_owner[ a ] != 0 ) {
+    FSCK_ERROR( "inode %u: block %u already used by inode %u", ino, a, fsck_owner[ a ] );
+  }
+  else {
+    fsck_owner[ a ] = ino;
+  }
+}
+
+static void fsck_inode( uint32_t ino ) {
+  inode*   x = iget( ino );
+  uint32_t n = 0;
+
+  if( x->i_ino != ino ) {
+    FSCK_ERROR( "inode %u: number recorded as %u", ino, x->i_ino );
+  }
+  if( x->i_type != FS_TYPE_FILE && x->i_type != FS_TYPE_DIR ) {
+    FSCK_ERROR( "inode %u: bad type %u", ino, x->i_type ); return;
+  }
+  if( x->i_nextents > ext_max() || ( x->i_nextents > FS_EXTENTS && x->i_ext_block == 0 ) ) {
+    FSCK_ERROR( "inode %u: bad extent count %u", ino, x->i_nextents ); return;
+  }
+
+  if( x->i_ext_block != 0 ) {
+    fsck_block( ino, x->i_ext_block );
+  }
+
+  for( uint32_t k = 0; k < x->i_nextents; k++ ) {
+    extent* e = ext_ref( x, k );
+
+    if( e->e_len == 0 || e->e_start + e->e_len > sb->block_num ) {
+      FSCK_ERROR( "inode %u: bad extent %u (%u, %u)", ino, k, e->e_start, e->e_len ); return;
+    }
+
+    for( uint32_t i = 0; i < e->e_len; i++ ) {
+      fsck_block( ino, e->e_start + i );
+    }
+
+    n += e->e_len;
+  }
+
+  if( n != x->i_blocks ) {
+    FSCK_ERROR( "inode %u: %u blocks recorded, but extents hold %u", ino, x->i_blocks, n );
+  }
+  if( x->i_size > ( uint64_t )( n ) * args.block_len ) {
+    FSCK_ERROR( "inode %u: size %u exceeds %u blocks", ino, x->i_size, n );
+  }
+}
+
+static void fsck_dir( uint32_t ino, uint32_t parent ) {
+  uint32_t epb = args.block_len / sizeof( dir_entry ), n = 0;
+  inode*   d   = iget( ino );
+
+  if( d->i_buckets == 0 || d->i_blocks != d->i_buckets || d->i_size != d->i_buckets * args.block_len ) {
+    FSCK_ERROR( "directory %u: %u buckets in %u blocks (%u bytes)", ino, d->i_buckets, d->i_blocks, d->i_size ); return;
+  }
+
+  for( uint32_t k = 0; k < d->i_buckets; k++ ) {
+    for( uint32_t i = 0; i < epb; i++ ) {
+      dir_entry e = dir_bucket( d, k )[ i ];
+
+      if( e.d_ino == 0 ) {
+        continue;
+      }
+
+      n++;
+
+      if( e.d_len == 0 || e.d_len > FS_NAME_MAX ) {
+        FSCK_ERROR( "directory %u: entry with bad name length %u", ino, e.d_len ); continue;
+      }
+
+      char s[ FS_NAME_MAX + 1 ] = { 0 };
+
+      memcpy( s, e.d_name, e.d_len );
+
+      if( e.d_ino >= sb->inode_num ) {
+        FSCK_ERROR( "directory %u: entry %s refers to bad inode %u", ino, s, e.d_ino ); continue;
+      }
+      if( dir_lookup( d, e.d_name, e.d_len ) != e.d_ino ) {
+        FSCK_ERROR( "directory %u: entry %s cannot be found by lookup", ino, s );
+      }
+
+      fsck_links[ e.d_ino ]++;
+
+      if( 0 == strcmp( s, "." ) ) {
+        if( e.d_ino != ino ) {
+          FSCK_ERROR( "directory %u: . refers to %u", ino, e.d_ino );
+        }
+        continue;
+      }
+      if( 0 == strcmp( s, ".." ) ) {
+        if( e.d_ino != parent ) {
+          FSCK_ERROR( "directory %u: .. refers to %u, not %u", ino, e.d_ino, parent );
+        }
+        continue;
+      }
+
+      if( !bit_get( sb->ibitmap_start, e.d_ino ) ) {
+        FSCK_ERROR( "directory %u: entry %s refers to free inode %u", ino, s, e.d_ino );
+      }
+
+      if( fsck_seen[ e.d_ino ] ) {
+        if( iget( e.d_ino )->i_type == FS_TYPE_DIR ) {
+          FSCK_ERROR( "directory %u: entry %s is a second link to directory %u", ino, s, e.d_ino );
+        }
+        continue;
+      }
+
+      fsck_seen[ e.d_ino ] = true; fsck_inode( e.d_ino );
+
+      if( iget( e.d_ino )->i_type == FS_TYPE_DIR ) {
+        fsck_dir( e.d_ino, ino );
+      }
+    }
+  }
+
+  if( n != d->i_entries ) {
+    FSCK_ERROR( "directory %u: %u entries recorded, but %u found", ino, d->i_entries, n );
+  }
+}
+
+static int cmd_fsck() {
+  uint32_t bpb = 8 * args.block_len, files = 0, dirs = 0, used = 0, unused = 0, inodes = 0;
+
+  if( sb->block_len != args.block_len || sb->block_num > args.block_num || sb->data_start >= sb->block_num || sb->root_inode != FS_ROOT_INO ) {
+    fprintf( stderr, "bad superblock geometry\n" ); return EXIT_FAILURE;
+  }
+  if( sb->dbitmap_start != sb->ibitmap_start + ( sb->inode_num + bpb - 1 ) / bpb || sb->itable_start != sb->dbitmap_start + ( sb->block_num + bpb - 1 ) / bpb || sb->data_start != sb->journal_start + sb->journal_len ) {
+    fprintf( stderr, "bad superblock layout\n" ); return EXIT_FAILURE;
+  }
+  if( sb->csum_len != 0 && ( sb->csum_len < fs_csum_len( sb->block_num, args.block_len ) || sb->journal_start != sb->csum_start + sb->csum_len ) ) {
+    fprintf( stderr, "bad superblock layout\n" ); return EXIT_FAILURE;
+  }
+
+  fsck_owner = calloc( sb->block_num, sizeof( uint32_t ) );
+  fsck_links = calloc( sb->inode_num, sizeof( uint32_t ) );
+  fsck_seen  = calloc( sb->inode_num, sizeof( bool     ) );
+
+  // walk the tree from the root, checking each inode and directory reached
+  fsck_seen[ sb->root_inode ] = true;
+
+  fsck_inode( sb->root_inode );
+  fsck_dir  ( sb->root_inode, sb->root_inode );
+
+  for( uint32_t i = 1; i < sb->inode_num; i++ ) {
+    bool   b = bit_get( sb->ibitmap_start, i );
+    inode* x = iget( i );
+
+    inodes += b;
+
+    if( b && !fsck_seen[ i ] ) {
+      FSCK_ERROR( "inode %u: allocated, but not in any directory", i );
+    }
+    if( !b && fsck_seen[ i ] ) {
+      FSCK_ERROR( "inode %u: in use, but free in bitmap", i );
+    }
+    if( !fsck_seen[ i ] ) {
+      continue;
+    }
+
+    if( x->i_type == FS_TYPE_DIR ) {
+      dirs++;
+    }
+    else {
+      files++;
+    }
+
+    if( x->i_nlink != fsck_links[ i ] ) {
+      FSCK_ERROR( "inode %u: link count %u, but %u links found", i, x->i_nlink, fsck_links[ i ] );
+    }
+  }
+
+  if( inodes != sb->inode_count ) {
+    FSCK_ERROR( "superblock: %u inodes recorded, but %u allocated", sb->inode_count, inodes );
+  }
+
+  for( uint32_t a = sb->data_start; a < sb->block_num; a++ ) {
+    bool b = bit_get( sb->dbitmap_start, a );
+
+    if( b ) {
+      used++;
+    }
+    else {
+      unused++;
+    }
+
+    if( b && fsck_owner[ a ] == 0 ) {
+      FSCK_ERROR( "block %u: allocated, but not used", a );
+    }
+    if( !b && fsck_owner[ a ] != 0 ) {
+      FSCK_ERROR( "block %u: used by inode %u, but free in bitmap", a, fsck_owner[ a ] );
+    }
+  }
+
+  if( unused != sb->free_blocks ) {
+    FSCK_ERROR( "superblock: %u free blocks recorded, but %u free", sb->free_blocks, unused );
+  }
+
+  if( sb->csum_len != 0 ) {
+    csum_walk( &fsck_csum );
+  }
+
+  printf( "%u files, %u directories, %u/%u data blocks used: %d errors\n", files, dirs, used, used + unused, errors );
+
+  free( fsck_owner ); free( fsck_links ); free( fsck_seen );
+
+  return ( errors == 0 ) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static void usage( const char* x ) {
+  fprintf( stderr, "usage: %s [--file=FILE] [--block-num=N] [--block-len=N] [--verbose] [--no-checksums] format | import SRC [DST] | fsck\n", x );
+
+  exit( EXIT_FAILURE );
+}
+
+int main( int argc, char* argv[] ) {
+  // parse command line arguments
+
+  static struct option opts[] = {
+    { "file",      required_argument, NULL, 'f' },
+    { "block-num", required_argument, NULL, 'n' },
+    { "block-len", required_argument, NULL, 'l' },
+    { "verbose",         no_argument, NULL, 'v' },
+    { "no-checksums",    no_argument, NULL, 'c' },
+    { NULL,                        0, NULL,  0  }
+  };
+
+  for( int c; -1 != ( c = getopt_long( argc, argv, "", opts, NULL ) ); ) {
+    switch( c ) {
+      case 'f' : args.file      =       optarg;   break;
+      case 'n' : args.block_num = atoi( optarg ); break;
+      case 'l' : args.block_len = atoi( optarg ); break;
+      case 'v' : args.verbose   = true;           break;
+      case 'c' : args.csum      = false;          break;
+      default  : usage( argv[ 0 ] );
+    }
+  }
+
+  if( optind >= argc ) {
+    usage( argv[ 0 ] );
+  }
+
+  const char* cmd = argv[ optind++ ];
+
+  if( args.block_len < 16 || args.block_len > 4096 || ( args.block_len & ( args.block_len - 1 ) ) ) {
+    fprintf( stderr, "block length must be a power of two between 16 and 4096\n" ); return EXIT_FAILURE;
+  }
+
+  // open and map disk image, creating or growing the file if it is too small
+
+  int fd = open( args.file, O_RDWR | O_CREAT, 0644 );
+
+  if( fd < 0 ) {
+    perror( "open" ); return EXIT_FAILURE;
+  }
+
+  disk_size = ( size_t )( args.block_num ) * args.block_len;
+
+  struct stat st;
+
+  if( 0 != fstat( fd, &st ) || ( ( size_t )( st.st_size ) < disk_size && 0 != ftruncate( fd, disk_size ) ) ) {
+    perror( "ftruncate" ); return EXIT_FAILURE;
+  }
+  if( MAP_FAILED == ( disk = mmap( NULL, disk_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 ) ) ) {
+    perror( "mmap" ); return EXIT_FAILURE;
+  }
+
+  sb = ( s_block* )( disk );
+
+  crc32_init();
+
+  int r;
+
+  if( 0 == strcmp( cmd, "format" ) ) {
+    r = cmd_format();
+  }
+  else {
+    if( sb->magic != FS_MAGIC || sb->block_len != args.block_len ) {
+      fprintf( stderr, "%s: not formatted (with block length %u)\n", args.file, args.block_len ); return EXIT_FAILURE;
+    }
+
+    journal_replay();
+
+    if     ( 0 == strcmp( cmd, "import" ) && optind < argc ) {
+      r = cmd_import( argv[ optind ], ( optind + 1 < argc ) ? argv[ optind + 1 ] : "/" );
+    }
+    else if( 0 == strcmp( cmd, "fsck"   ) ) {
+      r = cmd_fsck();
+    }
+    else {
+      usage( argv[ 0 ] );
+    }
+  }
+
+  if( 0 != msync( disk, disk_size, MS_SYNC ) ) {
+    perror( "msync" ); return EXIT_FAILURE;
+  }
+
+  munmap( disk, disk_size ); close( fd );
+
+  return r;
+}
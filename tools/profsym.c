@@ -0,0 +1,412 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+
+/* This is a host-side symbolizer for the samples the kernel profiler (see
+ * kernel/prof.h) records in the event trace, e.g., as captured by QEMU
+ * into a file.  Each sample is resolved to a function using the symbol
+ * table of
+ *
+ * - the kernel image (--image, i.e., image.elf), which holds the kernel
+ *   plus any programs linked into it, or
+ * - a program image loaded from disk, as described by TRACE_IMAGE events:
+ *   the image loaded from path /x/y/P is read from --programs/P (i.e.,
+ *   the copy imported onto the disk by make install-disk), and its
+ *   symbols offset by the base address it was loaded at.
+ *
+ * By default it writes a flat profile, i.e., the number (and share) of
+ * samples per function, most first; with --folded it instead writes one
+ * line per distinct process, mode, image and function, in the folded
+ * stack format flamegraph.pl (or https://www.speedscope.app) takes.  The
+ * kernel does not unwind the stack, so each "stack" is that sequence of
+ * four frames rather than a chain of callers.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <getopt.h>
+
+#include "trace_format.h"
+
+#define IMAGES   ( 64 )
+#define ENTRIES  ( 1 << 16 )
+#define PATH_MAX ( 1024 )
+
+// ELF definitions, per the ELF specification (see also kernel/loader.h)
+
+#define SHT_SYMTAB ( 2 )
+#define STT_NOTYPE ( 0 )
+#define STT_FUNC   ( 2 )
+#define PT_LOAD    ( 1 )
+#define SHF_EXEC   ( 4 )
+
+typedef struct {
+  uint8_t  e_ident[ 16 ];
+  uint16_t e_type, e_machine;
+  uint32_t e_version, e_entry, e_phoff, e_shoff, e_flags;
+  uint16_t e_ehsize, e_phentsize, e_phnum, e_shentsize, e_shnum, e_shstrndx;
+} elf32_ehdr;
+
+typedef struct {
+  uint32_t p_type, p_offset, p_vaddr, p_paddr, p_filesz, p_memsz, p_flags, p_align;
+} elf32_phdr;
+
+typedef struct {
+  uint32_t sh_name, sh_type, sh_flags, sh_addr, sh_offset, sh_size, sh_link, sh_info, sh_addralign, sh_entsize;
+} elf32_shdr;
+
+typedef struct {
+  uint32_t st_name, st_value, st_size;
+  uint8_t  st_info, st_other;
+  uint16_t st_shndx;
+} elf32_sym;
+
+typedef struct {
+  uint32_t    addr;               // address, i.e., offset by base
+  uint32_t    size;               // size
+  const char* name;
+} sym_t;
+
+typedef struct {
+  char        name[ PATH_MAX ];   // e.g., image.elf or P3
+  uint32_t    ino;                // inode number, or 0 iff. kernel image
+  uint32_t    base, size;         // extent in memory (size = 0 iff. unknown)
+  sym_t*      syms;               // symbols, in order of address
+  int         n;
+} image_t;
+
+typedef struct {
+  uint32_t    pid, mode;
+  image_t*    image;              // NULL iff. unresolved
+  const char* func;               // function, or image and offset iff. unresolved
+  uint32_t    count;
+} entry_t;
+
+struct {
+  const char* file;
+  const char* image;
+  const char* programs;
+  bool        folded;
+} args = { "trace.bin", "image.elf", "user/bin", false };
+
+image_t images[ IMAGES ]; int images_n = 0;
+entry_t entries[ ENTRIES ]; int entries_n = 0;
+
+static int sym_cmp( const void* a, const void* b ) {
+  uint32_t x = ( ( const sym_t* )( a ) )->addr, y = ( ( const sym_t* )( b ) )->addr;
+
+  return ( x > y ) - ( x < y );
+}
+
+// read the function symbols (and extent) of the ELF file at path into image i, offset by i->base; return true iff. successful
+static bool elf_read( image_t* i, const char* path ) {
+  FILE* fd = fopen( path, "rb" ); long n; uint8_t* x;
+
+  if( fd == NULL ) {
+    return false;
+  }
+
+  fseek( fd, 0, SEEK_END ); n = ftell( fd ); fseek( fd, 0, SEEK_SET );
+
+  if( n < ( long )( sizeof( elf32_ehdr ) ) || NULL == ( x = malloc( n ) ) || 1 != fread( x, n, 1, fd ) ) {
+    fclose( fd ); return false;
+  }
+
+  fclose( fd );
+
+  elf32_ehdr* h = ( elf32_ehdr* )( x );
+
+  if( memcmp( h->e_ident, "\x7F" "ELF", 4 ) || h->e_ident[ 4 ] != 1 || h->e_ident[ 5 ] != 1 ||
+      h->e_shentsize != sizeof( elf32_shdr ) || ( uint64_t )( h->e_shoff ) + h->e_shnum * sizeof( elf32_shdr ) > ( uint64_t )( n ) ||
+      h->e_phentsize != sizeof( elf32_phdr ) || ( uint64_t )( h->e_phoff ) + h->e_phnum * sizeof( elf32_phdr ) > ( uint64_t )( n ) ) {
+    free( x ); return false;
+  }
+
+  elf32_phdr* p = ( elf32_phdr* )( x + h->e_phoff );
+  elf32_shdr* s = ( elf32_shdr* )( x + h->e_shoff );
+
+  // the extent of a loaded image runs from its base to the end of the highest segment
+  if( i->ino != 0 ) {
+    for( int j = 0; j < h->e_phnum; j++ ) {
+      if( p[ j ].p_type == PT_LOAD && p[ j ].p_vaddr + p[ j ].p_memsz > i->size ) {
+        i->size = p[ j ].p_vaddr + p[ j ].p_memsz;
+      }
+    }
+  }
+
+  for( int j = 0; j < h->e_shnum; j++ ) {
+    if( s[ j ].sh_type != SHT_SYMTAB || s[ j ].sh_link >= h->e_shnum ) {
+      continue;
+    }
+
+    elf32_shdr* t = &s[ s[ j ].sh_link ];
+
+    if( ( uint64_t )( s[ j ].sh_offset ) + s[ j ].sh_size > ( uint64_t )( n ) || ( uint64_t )( t->sh_offset ) + t->sh_size > ( uint64_t )( n ) ) {
+      continue;
+    }
+
+    elf32_sym* y = ( elf32_sym* )( x + s[ j ].sh_offset ); int m = s[ j ].sh_size / sizeof( elf32_sym );
+
+    i->syms = realloc( i->syms, ( i->n + m ) * sizeof( sym_t ) );
+
+    for( int k = 0; k < m; k++ ) {
+      int         type = y[ k ].st_info & 0xF;
+      const char* name = ( const char* )( x + t->sh_offset ) + y[ k ].st_name;
+
+      // keep functions, plus labels in assembly language (but not mapping symbols such as $a or $d), in executable sections
+      if( y[ k ].st_shndx == 0 || y[ k ].st_shndx >= h->e_shnum || !( s[ y[ k ].st_shndx ].sh_flags & SHF_EXEC ) || y[ k ].st_name >= t->sh_size ||
+          !( type == STT_FUNC || ( type == STT_NOTYPE && name[ 0 ] != '$' && name[ 0 ] != '\0' ) ) ) {
+        continue;
+      }
+
+      elf32_shdr* z = &s[ y[ k ].st_shndx ]; uint32_t a = y[ k ].st_value & ~1;
+
+      // a label has no size, so extends (at most) to the end of its section
+      i->syms[ i->n ].addr = i->base + a;
+      i->syms[ i->n ].size = ( y[ k ].st_size != 0 || a >= z->sh_addr + z->sh_size ) ? y[ k ].st_size : z->sh_addr + z->sh_size - a;
+      i->syms[ i->n ].name = name;
+      i->n++;
+    }
+  }
+
+  qsort( i->syms, i->n, sizeof( sym_t ), sym_cmp );
+
+  return true;
+}
+
+// return the name of the function in image i containing address x, or NULL if there is none
+static const char* sym_find( image_t* i, uint32_t x ) {
+  int l = 0, h = i->n - 1, r = -1;
+
+  while( l <= h ) {
+    int m = ( l + h ) / 2;
+
+    if( i->syms[ m ].addr <= x ) {
+      r = m; l = m + 1;
+    }
+    else {
+      h = m - 1;
+    }
+  }
+
+  // any of the symbols at the same address will do, if its size covers x
+  for( int j = r; j >= 0 && i->syms[ j ].addr == i->syms[ r ].addr; j-- ) {
+    if( x - i->syms[ j ].addr < i->syms[ j ].size ) {
+      return i->syms[ j ].name;
+    }
+  }
+
+  return NULL;
+}
+
+// resolve address x to an image and function, either of which may be NULL
+static void resolve( uint32_t x, image_t** image, const char** func ) {
+  *image = NULL; *func = NULL;
+
+  // first a loaded image whose extent covers x, then the kernel image, then the loaded image nearest below x
+  for( int j = 1; j < images_n; j++ ) {
+    if( images[ j ].size != 0 && x - images[ j ].base < images[ j ].size ) {
+      *image = &images[ j ]; *func = sym_find( *image, x ); return;
+    }
+  }
+
+  if( images_n > 0 && NULL != ( *func = sym_find( &images[ 0 ], x ) ) ) {
+    *image = &images[ 0 ]; return;
+  }
+
+  for( int j = 1; j < images_n; j++ ) {
+    if( images[ j ].base <= x && ( *image == NULL || images[ j ].base > ( *image )->base ) ) {
+      *image = &images[ j ];
+    }
+  }
+}
+
+static const char* mode_name( uint32_t x ) {
+  switch( x ) {
+    case 0x10 : return "usr";
+    case 0x11 : return "fiq";
+    case 0x12 : return "irq";
+    case 0x13 : return "svc";
+    case 0x17 : return "abt";
+    case 0x1B : return "und";
+    case 0x1F : return "sys";
+    default   : return "?";
+  }
+}
+
+// count a sample of address x in mode by process pid, under its function or, failing that, the image and offset (or just x)
+static void count( uint32_t pid, uint32_t mode, uint32_t x ) {
+  image_t* image; const char* func; char s[ PATH_MAX + 16 ];
+
+  resolve( x, &image, &func );
+
+  if( func == NULL ) {
+    if( image != NULL ) {
+      snprintf( s, sizeof( s ), "%s+0x%X", image->name, x - image->base );
+    }
+    else {
+      snprintf( s, sizeof( s ), "0x%08X", x );
+    }
+  }
+
+  for( int j = 0; j < entries_n; j++ ) {
+    entry_t* e = &entries[ j ];
+
+    if( e->pid == pid && e->mode == mode && e->image == image && 0 == strcmp( e->func, ( func != NULL ) ? func : s ) ) {
+      e->count++; return;
+    }
+  }
+
+  if( entries_n < ENTRIES ) {
+    entry_t* e = &entries[ entries_n++ ];
+
+    e->pid = pid; e->mode = mode; e->image = image; e->func = ( func != NULL ) ? func : strdup( s ); e->count = 1;
+  }
+}
+
+// start, or continue, image ino per record e of type TRACE_IMAGE
+static void image_record( trace_event_t* e ) {
+  image_t* i = NULL;
+
+  for( int j = 1; j < images_n; j++ ) {
+    if( images[ j ].ino == e->b ) {
+      i = &images[ j ];
+    }
+  }
+
+  if( e->a == 0 ) {
+    if( i == NULL ) {
+      if( images_n == IMAGES ) {
+        return;
+      }
+
+      i = &images[ images_n++ ];
+    }
+
+    memset( i, 0, sizeof( image_t ) ); i->ino = e->b; i->base = e->t;
+  }
+  else if( i != NULL && i->syms == NULL && ( e->a - 1 ) * 4 + 4 < PATH_MAX ) {
+    memcpy( i->name + ( e->a - 1 ) * 4, &e->t, 4 );
+
+    // once the path is complete, read the symbols of the copy in --programs with the same name
+    if( memchr( &e->t, '\0', 4 ) != NULL ) {
+      char  p[ PATH_MAX + 64 ], * r = strrchr( i->name, '/' );
+
+      memmove( i->name, ( r == NULL ) ? i->name : r + 1, strlen( ( r == NULL ) ? i->name : r + 1 ) + 1 );
+
+      snprintf( p, sizeof( p ), "%s/%s", args.programs, i->name );
+
+      if( !elf_read( i, p ) ) {
+        fprintf( stderr, "%s: cannot read symbols\n", p );
+      }
+
+      i->syms = ( i->syms == NULL ) ? malloc( 1 ) : i->syms; // done, even if there are no symbols
+    }
+  }
+}
+
+static int flat_cmp( const void* a, const void* b ) {
+  uint32_t x = ( ( const entry_t* )( a ) )->count, y = ( ( const entry_t* )( b ) )->count;
+
+  return ( x < y ) - ( x > y );
+}
+
+int main( int argc, char* argv[] ) {
+  static struct option opts[] = {
+    { "file",      required_argument, NULL, 'f' },
+    { "image",     required_argument, NULL, 'i' },
+    { "programs",  required_argument, NULL, 'p' },
+    { "folded",          no_argument, NULL, 'F' },
+    { NULL,                        0, NULL,  0  }
+  };
+
+  for( int c; -1 != ( c = getopt_long( argc, argv, "", opts, NULL ) ); ) {
+    switch( c ) {
+      case 'f' : args.file     = optarg; break;
+      case 'i' : args.image    = optarg; break;
+      case 'p' : args.programs = optarg; break;
+      case 'F' : args.folded   = true;   break;
+      default  : fprintf( stderr, "usage: %s [--file=FILE] [--image=FILE] [--programs=DIR] [--folded]\n", argv[ 0 ] ); return EXIT_FAILURE;
+    }
+  }
+
+  image_t* k = &images[ images_n++ ];
+
+  snprintf( k->name, sizeof( k->name ), "%s", args.image );
+
+  if( !elf_read( k, args.image ) ) {
+    fprintf( stderr, "%s: cannot read symbols\n", args.image );
+  }
+
+  FILE* fd = fopen( args.file, "rb" );
+
+  if( fd == NULL ) {
+    perror( args.file ); return EXIT_FAILURE;
+  }
+
+  trace_event_t e; uint32_t n = 0, lost = 0;
+
+  while( 1 == fread( &e, sizeof( e ), 1, fd ) ) {
+    if     ( e.type == TRACE_SAMPLE ) {
+      count( e.b, e.a, e.t ); n++;
+    }
+    else if( e.type == TRACE_IMAGE  ) {
+      image_record( &e );
+    }
+    else if( e.type == TRACE_LOST   ) {
+      lost += e.b;
+    }
+  }
+
+  fclose( fd );
+
+  if( args.folded ) {
+    for( int j = 0; j < entries_n; j++ ) {
+      entry_t* x = &entries[ j ];
+
+      printf( "pid %u;%s;%s;%s %u\n", x->pid, mode_name( x->mode ), ( x->image != NULL ) ? x->image->name : "?", x->func, x->count );
+    }
+  }
+  else {
+    // merge entries by function (i.e., over processes and modes), then order by count
+    entry_t* f = malloc( ( entries_n + 1 ) * sizeof( entry_t ) ); int m = 0;
+
+    for( int j = 0; j < entries_n; j++ ) {
+      int l = 0;
+
+      while( l < m && !( f[ l ].image == entries[ j ].image && 0 == strcmp( f[ l ].func, entries[ j ].func ) ) ) {
+        l++;
+      }
+
+      if( l == m ) {
+        f[ m++ ] = entries[ j ];
+      }
+      else {
+        f[ l ].count += entries[ j ].count;
+      }
+    }
+
+    qsort( f, m, sizeof( entry_t ), flat_cmp );
+
+    printf( "  samples       %%  function                          image\n" );
+
+    for( int j = 0; j < m; j++ ) {
+      printf( "%9u %6.2f%%  %-32s  %s\n", f[ j ].count, 100.0 * f[ j ].count / n, f[ j ].func, ( f[ j ].image != NULL ) ? f[ j ].image->name : "?" );
+    }
+
+    free( f );
+  }
+
+  fprintf( stderr, "%u samples, %u events lost\n", n, lost );
+
+  return EXIT_SUCCESS;
+}
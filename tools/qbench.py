@@ -0,0 +1,320 @@
+# Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+#
+# Use of this source code is restricted per the CC BY-NC-ND license, a copy of
+# which can be found via http://creativecommons.org (and should be included as
+# LICENSE.txt within the associated archive or repository).
+
+# This is a host-side benchmark runner: it boots the kernel image in QEMU
+# headlessly (i.e., not halted for GDB, and with no terminal or telnet
+# client involved), drives the console from a script, and collects any
+# machine-readable results.  So
+#
+# run     => boots the image --runs times, executing --script each time,
+#            and writes the results (per run, and summarised) as JSON, and
+# compare => reads the JSON written by two runs, e.g., of two builds, and
+#            reports the change in each metric.
+#
+# Everything is local: UART0 (program output) and UART1 (the console) are
+# named pipes, UART3 (the trace) is a file, and UART2 (the disk) is only
+# used with --disk, in which case tools/diskd serves a scratch copy of the
+# disk image over the loopback interface, as with make launch-disk.
+#
+# A script has one command per line (a line starting with # is a comment):
+#
+# send <text>           => wait for the console prompt, then write text
+#                          (after the last command, the runner also waits
+#                          for a prompt, so its output is complete),
+# wait <regex> [<s>]    => wait (at most s seconds) until the output so far
+#                          matches regex,
+# sleep <s>             => let the image run for s seconds.
+#
+# and results are taken from the output of UART0 and UART1, namely
+#
+# - lines of the form "BENCH <name> <key>=<value> ...", as written by a
+#   benchmark program (possibly after other output), giving the metrics
+#   <name>.<key>, and
+# - the tables written by the lat and irq console commands, giving (e.g.)
+#   metrics svc.0x01.mean or irq.lat.p99.
+#
+# If a metric appears more than once in a run, the last value is kept.
+
+import argparse, json, os, re, select, shutil, signal, socket, statistics, subprocess, sys, tempfile, time
+
+PROMPT = b'console$ '
+
+BENCH  = re.compile( rb'BENCH\s+(\S+)\s+(.*)$' )
+TABLE  = re.compile( rb'^\s*(SVC|IRQ)\s+COUNT\s+MIN\s+MEAN\s+P50\s+P90\s+P99\s+MAX\s*$' )
+ROW    = re.compile( rb'^\s*(\S+)((?:\s+\d+){7})\s*$' )
+
+COLUMNS = [ 'count', 'min', 'mean', 'p50', 'p90', 'p99', 'max' ]
+
+class Fail( Exception ) :
+  pass
+
+# The image under test, with its UARTs attached to a temporary directory.
+
+class Target :
+  def __init__( self, args, d ) :
+    self.args = args ; self.d = d ; self.out = { 0 : b'', 1 : b'' } ; self.prompts = 0 ; self.qemu = None ; self.diskd = None ; self.fd = {}
+
+  def start( self ) :
+    args = self.args ; d = self.d
+
+    # open both ends of each pipe read-write, so neither open blocks whatever QEMU does first
+
+    for i in [ 0, 1 ] :
+      for x in [ 'in', 'out' ] :
+        os.mkfifo( os.path.join( d, 'uart%d.%s' % ( i, x ) ) )
+
+      self.fd[ i ] = ( os.open( os.path.join( d, 'uart%d.in'  % ( i ) ), os.O_RDWR | os.O_NONBLOCK ),
+                       os.open( os.path.join( d, 'uart%d.out' % ( i ) ), os.O_RDWR | os.O_NONBLOCK ) )
+
+    uart = [ 'pipe:' + os.path.join( d, 'uart0' ), 'pipe:' + os.path.join( d, 'uart1' ), 'null', 'file:' + os.path.join( d, 'trace.bin' ) ]
+
+    if ( args.disk ) :
+      shutil.copyfile( args.disk, os.path.join( d, 'disk.bin' ) )
+
+      s = socket.socket( socket.AF_INET, socket.SOCK_STREAM ) ; s.bind( ( '127.0.0.1', 0 ) ) ; port = s.getsockname()[ 1 ] ; s.close()
+
+      uart[ 2 ] = 'telnet:127.0.0.1:%d,server' % ( port )
+
+    cmd  = [ args.qemu, '-nodefaults', '-M', 'realview-pb-a8', '-m', '512M', '-display', 'none', '-monitor', 'none' ]
+    cmd += sum( [ [ '-serial', x ] for x in uart ], [] )
+    cmd += [ '-icount', args.icount ] if ( args.icount ) else []
+    cmd += [ '-kernel', args.image ]
+
+    self.qemu = subprocess.Popen( cmd, stdin = subprocess.DEVNULL, stdout = subprocess.DEVNULL, stderr = open( os.path.join( d, 'qemu.log' ), 'wb' ) )
+
+    # QEMU waits for a connection to the disk UART before it starts, so diskd can connect once it listens
+
+    if ( args.disk ) :
+      cmd = [ args.diskd, '--host=127.0.0.1', '--port=%d' % ( port ), '--file=' + os.path.join( d, 'disk.bin' ),
+              '--block-num=%d' % ( args.block_num ), '--block-len=%d' % ( args.block_len ), '--sync=none' ]
+
+      for i in range( 100 ) :
+        self.diskd = subprocess.Popen( cmd, stdin = subprocess.DEVNULL, stdout = subprocess.DEVNULL, stderr = subprocess.DEVNULL )
+
+        try :
+          self.diskd.wait( 0.1 )
+        except subprocess.TimeoutExpired :
+          break
+      else :
+        raise Fail( 'diskd cannot connect' )
+
+  def close( self ) :
+    for p in [ self.qemu, self.diskd ] :
+      if ( p != None and p.poll() == None ) :
+        p.terminate() ; p.wait()
+
+    for i in self.fd :
+      os.close( self.fd[ i ][ 0 ] ) ; os.close( self.fd[ i ][ 1 ] )
+
+    for i in self.out :
+      with open( os.path.join( self.d, 'uart%d.log' % ( i ) ), 'wb' ) as fd :
+        fd.write( self.out[ i ] )
+
+  # read whatever output there is, for at most t seconds
+
+  def pump( self, t ) :
+    r = { self.fd[ i ][ 1 ] : i for i in self.fd }
+
+    for fd in select.select( list( r ), [], [], max( t, 0 ) )[ 0 ] :
+      try :
+        x = os.read( fd, 4096 )
+      except BlockingIOError :
+        continue
+
+      self.out[ r[ fd ] ] += x
+
+    if ( self.qemu.poll() != None ) :
+      raise Fail( 'QEMU exited with status %d' % ( self.qemu.returncode ) )
+
+  # run until f() holds, or fail after t seconds
+
+  def until( self, f, t, what ) :
+    limit = time.time() + t
+
+    while ( not f() ) :
+      if ( time.time() > limit ) :
+        raise Fail( 'timed out waiting for ' + what )
+
+      self.pump( min( 0.1, limit - time.time() ) )
+
+  # wait for the console to write a prompt after the last command, i.e., to finish it
+
+  def ready( self ) :
+    self.until( lambda : self.out[ 1 ].count( PROMPT ) > self.prompts, self.args.timeout, 'console prompt' )
+
+    self.prompts = self.out[ 1 ].count( PROMPT )
+
+  def send( self, x ) :
+    self.ready()
+
+    os.write( self.fd[ 1 ][ 0 ], x.encode() + b'\n' )
+
+  def wait( self, x, t ) :
+    r = re.compile( x.encode() )
+
+    self.until( lambda : r.search( self.out[ 0 ] ) or r.search( self.out[ 1 ] ), t, repr( x ) )
+
+  def sleep( self, t ) :
+    limit = time.time() + t
+
+    while ( time.time() < limit ) :
+      self.pump( min( 0.1, limit - time.time() ) )
+
+# Extract metrics from output x into r.
+
+def metrics( x, r ) :
+  table = None
+
+  # the console writes the prompt, then (since it does not echo) the output of the next command on the same line
+
+  for l in x.replace( b'\r', b'' ).replace( PROMPT, b'\n' ).split( b'\n' ) :
+    m = BENCH.search( l )
+
+    if ( m ) :
+      for kv in m.group( 2 ).split() :
+        k, _, v = kv.partition( b'=' )
+
+        try :
+          r[ '%s.%s' % ( m.group( 1 ).decode(), k.decode() ) ] = float( v )
+        except ValueError :
+          pass
+
+      continue
+
+    m = TABLE.match( l )
+
+    if ( m ) :
+      table = m.group( 1 ).decode().lower() ; continue
+
+    m = ROW.match( l ) if ( table ) else None
+
+    if ( m ) :
+      for k, v in zip( COLUMNS, m.group( 2 ).split() ) :
+        r[ '%s.%s.%s' % ( table, m.group( 1 ).decode(), k ) ] = float( v )
+    else :
+      table = None
+
+def run( args ) :
+  script = []
+
+  with open( args.script ) as fd :
+    for n, l in enumerate( fd, 1 ) :
+      l = l.strip()
+
+      if ( l and not l.startswith( '#' ) ) :
+        script.append( ( n, l.split( None, 1 ) ) )
+
+  runs = []
+
+  for i in range( args.runs ) :
+    d = tempfile.mkdtemp( prefix = 'qbench.' ) ; t = None ; r = {}
+
+    try :
+      t = Target( args, d ) ; t.start()
+
+      for n, ( op, x ) in [ ( n, ( c + [ '' ] )[ : 2 ] ) for n, c in script ] :
+        if   ( op == 'send'  ) :
+          t.send( x )
+        elif ( op == 'wait'  ) :
+          m = re.match( r'^(.*?)(?:\s+(\d+(?:\.\d+)?))?$', x )
+          t.wait( m.group( 1 ), float( m.group( 2 ) ) if ( m.group( 2 ) ) else args.timeout )
+        elif ( op == 'sleep' ) :
+          t.sleep( float( x ) )
+        else :
+          raise Fail( '%s:%d: unknown command %s' % ( args.script, n, op ) )
+
+      t.ready() ; metrics( t.out[ 0 ], r ) ; metrics( t.out[ 1 ], r )
+    except ( Fail, OSError ) as e :
+      print( 'run %d: %s (see %s)' % ( i + 1, e, d ), file = sys.stderr ) ; args.keep = True ; r = None
+    finally :
+      if ( t ) :
+        t.close()
+
+    if ( args.keep ) :
+      print( 'run %d: output kept in %s' % ( i + 1, d ), file = sys.stderr )
+    else :
+      shutil.rmtree( d )
+
+    if ( r == None ) :
+      return 1
+
+    print( 'run %d: %d metrics' % ( i + 1, len( r ) ), file = sys.stderr ) ; runs.append( r )
+
+  # summarise each metric over the runs it appears in
+
+  summary = {}
+
+  for k in sorted( set().union( *runs ) ) :
+    x = [ r[ k ] for r in runs if k in r ]
+
+    summary[ k ] = { 'median' : statistics.median( x ), 'min' : min( x ), 'max' : max( x ), 'n' : len( x ) }
+
+  try :
+    rev = subprocess.run( [ 'git', 'describe', '--always', '--dirty' ], capture_output = True, text = True ).stdout.strip()
+  except OSError :
+    rev = ''
+
+  with open( args.out, 'w' ) as fd :
+    json.dump( { 'meta' : { 'image' : args.image, 'script' : args.script, 'icount' : args.icount, 'rev' : rev, 'time' : time.strftime( '%Y-%m-%d %H:%M:%S' ) },
+                 'runs' : runs, 'summary' : summary }, fd, indent = 2 )
+
+  return 0
+
+# Report the change in the median of each metric from a to b; a change is
+# marked as noise (~) if the median of b lies within the range of a, or
+# vice versa.
+
+def compare( args ) :
+  with open( args.a ) as fd :
+    a = json.load( fd )
+  with open( args.b ) as fd :
+    b = json.load( fd )
+
+  print( 'a = %s (%s)' % ( args.a, a[ 'meta' ].get( 'rev', '' ) ) )
+  print( 'b = %s (%s)' % ( args.b, b[ 'meta' ].get( 'rev', '' ) ) )
+  print()
+  print( '%-32s %14s %14s %9s' % ( 'metric', 'a', 'b', 'change' ) )
+
+  for k in sorted( set( a[ 'summary' ] ) | set( b[ 'summary' ] ) ) :
+    x = a[ 'summary' ].get( k ) ; y = b[ 'summary' ].get( k )
+
+    if ( x == None or y == None ) :
+      print( '%-32s %14s %14s %9s' % ( k, '-' if ( x == None ) else '%.6g' % ( x[ 'median' ] ), '-' if ( y == None ) else '%.6g' % ( y[ 'median' ] ), '' ) ) ; continue
+
+    noise = ( x[ 'min' ] <= y[ 'median' ] <= x[ 'max' ] ) or ( y[ 'min' ] <= x[ 'median' ] <= y[ 'max' ] )
+    delta = '%+.1f%%' % ( 100.0 * ( y[ 'median' ] - x[ 'median' ] ) / x[ 'median' ] ) if ( x[ 'median' ] != 0 ) else ''
+
+    print( '%-32s %14.6g %14.6g %9s%s' % ( k, x[ 'median' ], y[ 'median' ], delta, ' ~' if ( noise and x[ 'n' ] > 1 ) else '' ) )
+
+  return 0
+
+if ( __name__ == '__main__' ) :
+  parser = argparse.ArgumentParser()
+  modes  = parser.add_subparsers( dest = 'mode', required = True )
+
+  p = modes.add_parser( 'run' )
+  p.add_argument( '--image',     action = 'store', default = 'image.bin'               )
+  p.add_argument( '--script',    action = 'store', default = 'tools/bench/default.txt' )
+  p.add_argument( '--out',       action = 'store', default = 'bench.json'              )
+  p.add_argument( '--runs',      action = 'store', default = 3,    type = int          )
+  p.add_argument( '--timeout',   action = 'store', default = 30.0, type = float        )
+  p.add_argument( '--icount',    action = 'store', default = None                      )
+  p.add_argument( '--disk',      action = 'store', default = None                      )
+  p.add_argument( '--block-num', action = 'store', default = 8192, type = int          )
+  p.add_argument( '--block-len', action = 'store', default =  512, type = int          )
+  p.add_argument( '--qemu',      action = 'store', default = 'qemu-system-arm'         )
+  p.add_argument( '--diskd',     action = 'store', default = 'tools/diskd'             )
+  p.add_argument( '--keep',      action = 'store_true'                                 )
+
+  p = modes.add_parser( 'compare' )
+  p.add_argument( 'a' )
+  p.add_argument( 'b' )
+
+  args = parser.parse_args()
+
+  signal.signal( signal.SIGTERM, lambda n, f : sys.exit( 1 ) )
+
+  sys.exit( run( args ) if ( args.mode == 'run' ) else compare( args ) )
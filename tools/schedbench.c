@@ -0,0 +1,401 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+/* This is a host-side microbenchmark of the scheduler (see kernel/sched.c),
+ * which is compiled as is for the host, so a change to the queues or to
+ * the MLFQ policy can be measured (and profiled, e.g., with perf) without
+ * the target.  Each benchmark is run for n processes, with n from --procs,
+ *
+ * enqueue_dequeue/n => place n processes onto a queue, then remove them,
+ * delPCBNode/n      => remove the middle process of a queue of n, then
+ *                      place it back at the end,
+ * schedule/n        => one tick of mlfqSchedule with n ready processes,
+ * schedule_churn/n  => ditto, but with a process created or killed (i.e.,
+ *                      enqueued at level 1 or removed) each tick,
+ *
+ * and reported in the format of Google Benchmark, i.e., wall-clock and
+ * CPU time per iteration, where the number of iterations grows until a
+ * run takes at least --min-time seconds.  --filter selects benchmarks by
+ * a (POSIX extended) regular expression matched against the name.
+ *
+ * As in crcbench, the queues and the policy are first checked against
+ * their definition (FIFO order, deletion at any point, time slices that
+ * double per level, demotion, round-robin at the lowest level, and that a
+ * process which stops executing, e.g., to sleep, is not requeued), so a
+ * faster but wrong variant cannot go unnoticed.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <getopt.h>
+#include <regex.h>
+#include <time.h>
+
+#include "sched.h"
+
+struct {
+  double  min_time;
+  char*   filter;
+  int     procs[ 8 ];
+  int     procs_num;
+} args = { 0.5, ".", { 16, 256, 4096 }, 3 };
+
+uint64_t enqueued;                  // calls of sched_enqueued
+uint64_t dequeued;                  // calls of sched_dequeued
+volatile uintptr_t sink;            // accumulated results, so no work is optimised away
+
+void sched_enqueued( queue* q, pcb_t* pcb ) {
+  enqueued++;
+}
+
+void sched_dequeued( queue* q, pcb_t* pcb ) {
+  dequeued++;
+}
+
+static double now( clockid_t c ) {
+  struct timespec t;
+
+  clock_gettime( c, &t );
+
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+typedef struct {
+  int      n;                       // processes
+  uint64_t iters;                   // iterations to time
+  double   t_real, t_cpu;           // wall-clock and CPU time of those iterations
+} state_t;
+
+static void start( state_t* s ) {
+  s->t_real = now( CLOCK_MONOTONIC          );
+  s->t_cpu  = now( CLOCK_PROCESS_CPUTIME_ID );
+}
+
+static void stop( state_t* s ) {
+  s->t_real = now( CLOCK_MONOTONIC          ) - s->t_real;
+  s->t_cpu  = now( CLOCK_PROCESS_CPUTIME_ID ) - s->t_cpu;
+}
+
+// n processes, all ready at level 1 but none in a queue
+static pcb_t* procs_new( int n ) {
+  pcb_t* x = calloc( n, sizeof( pcb_t ) );
+
+  if( x == NULL ) {
+    perror( "calloc" ); exit( EXIT_FAILURE );
+  }
+
+  for( int i = 0; i < n; i++ ) {
+    x[ i ].pid    = i + 1;
+    x[ i ].status = STATUS_READY;
+    x[ i ].prty   = 1;
+  }
+
+  return x;
+}
+
+// empty every queue, so the next benchmark starts afresh
+static void mlfq_clear() {
+  for( int i = 0; i < PRIORITY_LEVELS; i++ ) {
+    while( !isEmpty( &mlfq.queues[ i ] ) ) {
+      dequeue( &mlfq.queues[ i ] );
+    }
+  }
+
+  memset( &mlfq, 0, sizeof( mlf_queues ) );
+}
+
+static int queue_len( queue* q ) {
+  int n = 0;
+
+  for( node* t = q->head; t != NULL; t = t->next ) {
+    n++;
+  }
+
+  return n;
+}
+
+static void bm_enqueue_dequeue( state_t* s ) {
+  pcb_t* x = procs_new( s->n );
+  queue  q = { NULL, NULL };
+
+  start( s );
+
+  for( uint64_t i = 0; i < s->iters; i++ ) {
+    for( int j = 0; j < s->n; j++ ) {
+      enqueue( &q, &x[ j ] );
+    }
+    for( int j = 0; j < s->n; j++ ) {
+      sink += ( uintptr_t )( q.head->pcb ); dequeue( &q );
+    }
+  }
+
+  stop( s );
+
+  free( x );
+}
+
+static void bm_delPCBNode( state_t* s ) {
+  pcb_t* x = procs_new( s->n );
+  queue  q = { NULL, NULL };
+
+  for( int j = 0; j < s->n; j++ ) {
+    enqueue( &q, &x[ j ] );
+  }
+
+  start( s );
+
+  // after the processes n / 2 + k, for k < i, are moved to the end in turn, n / 2 + i is still in the middle
+  for( uint64_t i = 0; i < s->iters; i++ ) {
+    pcb_t* p = &x[ s->n / 2 + i % ( s->n - s->n / 2 ) ];
+
+    delPCBNode( &q, p );
+    enqueue( &q, p );
+  }
+
+  stop( s );
+
+  while( !isEmpty( &q ) ) {
+    dequeue( &q );
+  }
+
+  free( x );
+}
+
+static void bm_schedule( state_t* s ) {
+  pcb_t* x = procs_new( s->n );
+  pcb_t* e = NULL;
+
+  mlfqInit( x, s->n );
+
+  start( s );
+
+  for( uint64_t i = 0; i < s->iters; i++ ) {
+    e = mlfqSchedule( e ); sink += ( uintptr_t )( e );
+  }
+
+  stop( s );
+
+  mlfq_clear();
+
+  free( x );
+}
+
+static void bm_schedule_churn( state_t* s ) {
+  pcb_t* x = procs_new( s->n );
+  pcb_t* e = NULL;
+
+  mlfqInit( x, s->n );
+
+  srand( 1 );
+
+  start( s );
+
+  for( uint64_t i = 0; i < s->iters; i++ ) {
+    pcb_t* p = &x[ rand() % s->n ];
+
+    if( p->status == STATUS_READY ) {     // kill
+      delPCBNode( &mlfq.queues[ p->prty - 1 ], p ); p->status = STATUS_INVALID;
+    }
+    else if( p->status == STATUS_INVALID ) { // fork
+      p->status = STATUS_READY; p->prty = 1; enqueue( &mlfq.queues[ 0 ], p );
+    }
+
+    e = mlfqSchedule( e ); sink += ( uintptr_t )( e );
+  }
+
+  stop( s );
+
+  mlfq_clear();
+
+  free( x );
+}
+
+struct {
+  char* id;
+  void ( *f )( state_t* s );
+} benchmarks[] = {
+  { "enqueue_dequeue", &bm_enqueue_dequeue },
+  { "delPCBNode",      &bm_delPCBNode      },
+  { "schedule",        &bm_schedule        },
+  { "schedule_churn",  &bm_schedule_churn  },
+  { NULL,              NULL                }
+};
+
+// run f for n processes, with the number of iterations grown until a run takes at least args.min_time seconds
+static void run( const char* id, void ( *f )( state_t* s ), int n ) {
+  state_t s = { n, 1, 0, 0 };
+
+  for( ;; ) {
+    f( &s );
+
+    if( s.t_real >= args.min_time || s.iters >= ( 1ULL << 40 ) ) {
+      break;
+    }
+
+    // aim 40% beyond the minimum, but grow by at most 10x per run (as Google Benchmark)
+    double m = ( s.t_real > 0 ) ? ( 1.4 * args.min_time / s.t_real ) : 10;
+
+    s.iters = ( uint64_t )( s.iters * ( ( m > 10 ) ? 10 : ( ( m < 2 ) ? 2 : m ) ) );
+  }
+
+  char name[ 64 ]; snprintf( name, sizeof( name ), "%s/%d", id, n );
+
+  printf( "%-30s %12.1f ns %12.1f ns %12llu\n", name, s.t_real * 1e9 / s.iters, s.t_cpu * 1e9 / s.iters, ( unsigned long long )( s.iters ) );
+}
+
+#define CHECK(x) if( !( x ) ) { fprintf( stderr, "check failed, line %d: %s\n", __LINE__, #x ); return false; }
+
+static bool check() {
+  pcb_t* x = procs_new( 8 );
+  queue  q = { NULL, NULL };
+
+  // FIFO order, and the hooks see every placement and removal
+  uint64_t e = enqueued, d = dequeued;
+
+  for( int j = 0; j < 8; j++ ) {
+    enqueue( &q, &x[ j ] );
+  }
+  for( int j = 0; j < 8; j++ ) {
+    CHECK( q.head->pcb == &x[ j ] ); dequeue( &q );
+  }
+
+  CHECK( isEmpty( &q ) && q.head == NULL );
+  CHECK( enqueued - e == 8 && dequeued - d == 8 );
+
+  // deletion from the head, middle and tail, where the tail must then be updated
+  for( int j = 0; j < 8; j++ ) {
+    enqueue( &q, &x[ j ] );
+  }
+
+  delPCBNode( &q, &x[ 0 ] );
+  delPCBNode( &q, &x[ 4 ] );
+  delPCBNode( &q, &x[ 7 ] );
+
+  CHECK( queue_len( &q ) == 5 && q.head->pcb == &x[ 1 ] && q.tail->pcb == &x[ 6 ] && q.tail->next == NULL );
+
+  enqueue( &q, &x[ 7 ] );
+
+  CHECK( q.tail->pcb == &x[ 7 ] && queue_len( &q ) == 6 );
+
+  while( !isEmpty( &q ) ) {
+    dequeue( &q );
+  }
+
+  // the first tick selects the first process, which then executes for queueTime[ 0 ] = 1 tick before demotion
+  mlfqInit( x, 8 );
+
+  for( int i = 1; i < PRIORITY_LEVELS; i++ ) {
+    CHECK( mlfq.queueTime[ i ] == 2 * mlfq.queueTime[ i - 1 ] );
+  }
+
+  pcb_t* p = mlfqSchedule( NULL );
+
+  CHECK( p == &x[ 0 ] && p->status == STATUS_EXECUTING && queue_len( &mlfq.queues[ 0 ] ) == 7 );
+
+  p = mlfqSchedule( p );
+
+  CHECK( p == &x[ 1 ] && x[ 0 ].status == STATUS_READY && x[ 0 ].prty == 2 && mlfq.queues[ 1 ].head->pcb == &x[ 0 ] );
+
+  // once every process is at the lowest level, each executes in turn for the longest time slice
+  int  slice = mlfq.queueTime[ PRIORITY_LEVELS - 1 ];
+  int  ticks[ 8 ] = { 0 };
+
+  for( int i = 0; i < 8 * ( 1 << PRIORITY_LEVELS ) * 4; i++ ) {
+    p = mlfqSchedule( p );
+  }
+  for( int i = 0; i < 8 * slice * 4; i++ ) {
+    p = mlfqSchedule( p ); ticks[ p - x ]++;
+
+    CHECK( p->prty == PRIORITY_LEVELS && p->status == STATUS_EXECUTING );
+  }
+  for( int j = 0; j < 8; j++ ) {
+    CHECK( ticks[ j ] == slice * 4 );
+  }
+
+  // a process no longer executing (e.g., sleeping) is not requeued
+  p->status = STATUS_WAITING;
+
+  pcb_t* r = mlfqSchedule( p ); int m = 0;
+
+  for( int i = 0; i < PRIORITY_LEVELS; i++ ) {
+    m += queue_len( &mlfq.queues[ i ] );
+  }
+
+  CHECK( r != p && r->status == STATUS_EXECUTING && m == 6 );
+
+  // with no process ready, there is nothing to select
+  mlfq_clear();
+
+  CHECK( mlfqSchedule( NULL ) == NULL );
+
+  free( x );
+
+  return true;
+}
+
+int main( int argc, char* argv[] ) {
+  static struct option opts[] = {
+    { "min-time", required_argument, NULL, 't' },
+    { "filter",   required_argument, NULL, 'f' },
+    { "procs",    required_argument, NULL, 'n' },
+    { NULL,                       0, NULL,  0  }
+  };
+
+  for( int c; -1 != ( c = getopt_long( argc, argv, "", opts, NULL ) ); ) {
+    switch( c ) {
+      case 't' : args.min_time = atof( optarg ); break;
+      case 'f' : args.filter   =       optarg;   break;
+      case 'n' : {
+        args.procs_num = 0;
+
+        for( char* t = strtok( optarg, "," ); t != NULL && args.procs_num < 8; t = strtok( NULL, "," ) ) {
+          args.procs[ args.procs_num++ ] = atoi( t );
+        }
+        break;
+      }
+      default  : fprintf( stderr, "usage: %s [--min-time=S] [--filter=REGEX] [--procs=N,N,...]\n", argv[ 0 ] ); return EXIT_FAILURE;
+    }
+  }
+
+  for( int i = 0; i < args.procs_num; i++ ) {
+    if( args.procs[ i ] < 2 ) {
+      fprintf( stderr, "number of processes must be at least 2\n" ); return EXIT_FAILURE;
+    }
+  }
+
+  regex_t r;
+
+  if( regcomp( &r, args.filter, REG_EXTENDED | REG_NOSUB ) ) {
+    fprintf( stderr, "invalid filter %s\n", args.filter ); return EXIT_FAILURE;
+  }
+
+  if( !check() ) {
+    return EXIT_FAILURE;
+  }
+
+  printf( "%-30s %15s %15s %12s\n", "Benchmark", "Time", "CPU", "Iterations" );
+  printf( "%.*s\n", 75, "---------------------------------------------------------------------------" );
+
+  for( int i = 0; benchmarks[ i ].id != NULL; i++ ) {
+    for( int j = 0; j < args.procs_num; j++ ) {
+      char name[ 64 ]; snprintf( name, sizeof( name ), "%s/%d", benchmarks[ i ].id, args.procs[ j ] );
+
+      if( !regexec( &r, name, 0, NULL, 0 ) ) {
+        run( benchmarks[ i ].id, benchmarks[ i ].f, args.procs[ j ] );
+      }
+    }
+  }
+
+  regfree( &r );
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,241 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+/* This is a host-side decoder for the binary event trace the kernel
+ * streams over UART3 (see kernel/trace.h), e.g., as captured by QEMU into
+ * a file.  By default it writes the trace in the Chrome trace event
+ * format (i.e., JSON that chrome://tracing or https://ui.perfetto.dev can
+ * load), with
+ *
+ * - one track per process, holding a slice for each period it executed,
+ *   i.e., from the dispatch that switched to it to the next dispatch,
+ * - one track for the kernel, holding a slice for each system call (named
+ *   after it) and interrupt (named after its source),
+ * - a counter of the number of processes in each ready queue, and
+ * - an instant event for each run of dropped events;
+ *
+ * with --text it instead lists one event per line.  Timestamps are given
+ * in microseconds since the first event.  Profiler samples are ignored,
+ * other than being listed by --text: tools/profsym decodes those.
+ */
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <getopt.h>
+
+#include "trace_format.h"
+
+#define QUEUES ( 8 )
+#define PIDS   ( 256 )
+
+struct {
+  const char* file;
+  bool        text;
+} args = { "trace.bin", false };
+
+static const char* svc_name[] = {
+  [ 0x00 ] = "yield", [ 0x01 ] = "write",      [ 0x02 ] = "read",     [ 0x03 ] = "fork",
+  [ 0x04 ] = "exit",  [ 0x05 ] = "exec",       [ 0x06 ] = "kill",     [ 0x07 ] = "nice",
+  [ 0x08 ] = "sem_init", [ 0x09 ] = "sem_close", [ 0x0A ] = "sync",   [ 0x0B ] = "cache_stat",
+  [ 0x0C ] = "ios_stat", [ 0x0D ] = "fs_stat", [ 0x0E ] = "journal_stat", [ 0x0F ] = "csum_stat",
+  [ 0x10 ] = "open",  [ 0x11 ] = "close",      [ 0x12 ] = "mkdir",
+  [ 0x13 ] = "stat",  [ 0x14 ] = "dup",        [ 0x15 ] = "pipe",     [ 0x16 ] = "load",
+  [ 0x17 ] = "mmap",  [ 0x18 ] = "munmap",     [ 0x19 ] = "ps",
+  [ 0x1A ] = "svc_stat", [ 0x1B ] = "svc_reset", [ 0x1C ] = "irq_stat", [ 0x1D ] = "prof", [ 0x1E ] = "pmu", [ 0x1F ] = "pmu_stat",
+  [ 0x20 ] = "sleep_ms", [ 0x21 ] = "sleep_until", [ 0x22 ] = "clock_ms",
+  [ 0x23 ] = "loader_stat", [ 0x24 ] = "vm_stat", [ 0x25 ] = "trace_stat", [ 0x26 ] = "prof_stat"
+};
+
+static const char* irq_name( uint32_t x ) {
+  switch( x ) {
+    case 36 : return "TIMER0";
+    case 37 : return "TIMER1";
+    case 44 : return "UART0";
+    case 45 : return "UART1";
+    case 46 : return "UART2";
+    case 52 : return "PS20";
+    case 53 : return "PS21";
+    default : return NULL;
+  }
+}
+
+uint64_t khz   = TRACE_KHZ;         // counter frequency
+uint64_t base  = 0;                 // unwrapped timestamp of first event
+bool     first = true;
+bool     comma = false;             // JSON event written already?
+
+static double us( uint64_t t ) {
+  return ( double )( t - base ) * 1000.0 / khz;
+}
+
+// write one JSON event of phase ph at time t on track tid, plus any further fields per fmt
+static void json( const char* ph, uint64_t t, uint32_t tid, const char* fmt, ... ) {
+  va_list ap;
+
+  printf( "%s\n  { \"ph\" : \"%s\", \"ts\" : %.3f, \"pid\" : 1, \"tid\" : %u", comma ? "," : "", ph, us( t ), tid );
+
+  if( fmt != NULL ) {
+    printf( ", " ); va_start( ap, fmt ); vprintf( fmt, ap ); va_end( ap );
+  }
+
+  printf( " }" ); comma = true;
+}
+
+// name system call (iff. svc) or interrupt source x into s
+static void name( uint32_t x, char* s, size_t n, bool svc ) {
+  const char* r = svc ? ( ( x < sizeof( svc_name ) / sizeof( svc_name[ 0 ] ) ) ? svc_name[ x ] : NULL ) : irq_name( x );
+
+  if( r != NULL ) {
+    snprintf( s, n, "%s", r );
+  }
+  else {
+    snprintf( s, n, svc ? "svc 0x%02X" : "irq %u", x );
+  }
+}
+
+int main( int argc, char* argv[] ) {
+  static struct option opts[] = {
+    { "file",      required_argument, NULL, 'f' },
+    { "text",            no_argument, NULL, 't' },
+    { NULL,                        0, NULL,  0  }
+  };
+
+  for( int c; -1 != ( c = getopt_long( argc, argv, "", opts, NULL ) ); ) {
+    switch( c ) {
+      case 'f' : args.file = optarg; break;
+      case 't' : args.text = true;   break;
+      default  : fprintf( stderr, "usage: %s [--file=FILE] [--text]\n", argv[ 0 ] ); return EXIT_FAILURE;
+    }
+  }
+
+  FILE* fd = fopen( args.file, "rb" );
+
+  if( fd == NULL ) {
+    perror( args.file ); return EXIT_FAILURE;
+  }
+
+  trace_event_t e;
+  uint64_t      t = 0, since = 0;      // unwrapped timestamp, start of open kernel slice
+  uint32_t      last = 0, running = 0, depth[ QUEUES ] = { 0 }, n = 0, bad = 0;
+  bool          seen[ PIDS ] = { false }, open = false;
+  char          s[ 32 ];
+
+  if( !args.text ) {
+    printf( "{ \"displayTimeUnit\" : \"ns\", \"traceEvents\" : [" );
+  }
+
+  for( ; 1 == fread( &e, sizeof( e ), 1, fd ); n++ ) {
+    if( e.type < TRACE_START || e.type > TRACE_IMAGE ) {
+      bad++; continue;
+    }
+
+    // samples and images hold an address rather than a timestamp, so are left to tools/profsym
+    if( e.type == TRACE_SAMPLE || e.type == TRACE_IMAGE ) {
+      if( args.text ) {
+        printf( "%14s %-10s %3u %5u 0x%08X\n", "", ( e.type == TRACE_SAMPLE ) ? "sample" : "image", e.a, e.b, e.t );
+      }
+      continue;
+    }
+
+    if( first ) {
+      t = base = e.t; first = false;
+    }
+    else {
+      t += ( uint32_t )( e.t - last );
+    }
+
+    last = e.t;
+
+    if( e.type == TRACE_START && e.b != 0 ) {
+      khz = e.b;
+    }
+
+    if( args.text ) {
+      static const char* id[] = { NULL, "start", "lost", "dispatch", "svc-enter", "svc-exit", "irq-enter", "irq-exit", "enqueue", "dequeue" };
+
+      printf( "%14.3f %-10s %3u %5u\n", us( t ), id[ e.type ], e.a, e.b ); continue;
+    }
+
+    // name each process track the first time it is seen
+    if( e.type == TRACE_DISPATCH && e.b < PIDS && !seen[ e.b ] && e.b != 0 ) {
+      seen[ e.b ] = true; json( "M", t, e.b, "\"name\" : \"thread_name\", \"args\" : { \"name\" : \"pid %u\" }", e.b );
+    }
+
+    switch( e.type ) {
+      case TRACE_START    : {
+        json( "M", t, 0, "\"name\" : \"thread_name\", \"args\" : { \"name\" : \"kernel\" }" );
+        json( "i", t, 0, "\"name\" : \"start\", \"s\" : \"g\"" );
+        break;
+      }
+      case TRACE_LOST     : {
+        json( "i", t, 0, "\"name\" : \"lost\", \"s\" : \"g\", \"args\" : { \"events\" : %u }", e.b );
+        break;
+      }
+      case TRACE_DISPATCH : {
+        // the slice of whichever process was running ends, even if it has since exited (so prev is 0)
+        if( running != 0 ) {
+          json( "E", t, running, NULL );
+        }
+        if( ( running = e.b ) != 0 ) {
+          json( "B", t, running, "\"name\" : \"run\"" );
+        }
+        break;
+      }
+      case TRACE_SVC_ENTER :
+      case TRACE_IRQ_ENTER : {
+        since = t; open = true;
+        break;
+      }
+      case TRACE_SVC_EXIT :
+      case TRACE_IRQ_EXIT : {
+        if( !open ) {
+          break;
+        }
+
+        name( ( e.type == TRACE_SVC_EXIT ) ? e.a : e.b, s, sizeof( s ), e.type == TRACE_SVC_EXIT );
+
+        printf( "%s\n  { \"ph\" : \"X\", \"ts\" : %.3f, \"dur\" : %.3f, \"pid\" : 1, \"tid\" : 0, \"name\" : \"%s\"", comma ? "," : "", us( since ), us( t ) - us( since ), s );
+        if( e.type == TRACE_SVC_EXIT ) {
+          printf( ", \"args\" : { \"pid\" : %u }", e.b );
+        }
+        printf( " }" ); comma = true; open = false;
+        break;
+      }
+      case TRACE_ENQUEUE :
+      case TRACE_DEQUEUE : {
+        if( e.a >= QUEUES ) {
+          break;
+        }
+
+        depth[ e.a ] += ( e.type == TRACE_ENQUEUE ) ? 1 : ( depth[ e.a ] > 0 ) ? -1 : 0;
+
+        json( "C", t, 0, "\"name\" : \"ready\", \"args\" : { \"q0\" : %u, \"q1\" : %u, \"q2\" : %u }", depth[ 0 ], depth[ 1 ], depth[ 2 ] );
+        break;
+      }
+    }
+  }
+
+  if( !args.text ) {
+    if( running != 0 ) {
+      json( "E", t, running, NULL );
+    }
+
+    printf( "\n] }\n" );
+  }
+
+  fclose( fd );
+
+  fprintf( stderr, "%u events, %u malformed, %.3f ms\n", n, bad, first ? 0.0 : us( t ) / 1000.0 );
+
+  return EXIT_SUCCESS;
+}
@@ -29,10 +29,27 @@ void gets( char* x, int n ) {
   }
 }
 
-/* Since we lack a *real* loader (as a result of also lacking a storage
- * medium to store program images), the following function approximates 
- * one: given a program name from the set of programs statically linked
- * into the kernel image, it returns a pointer to the entry point.
+// write unsigned integer x, right-aligned in a field of w characters
+void putn( uint32_t x, int w ) {
+  char s[ 10 ]; int n = 0;
+
+  do {
+    s[ n++ ] = '0' + ( x % 10 ); x /= 10;
+  } while( x );
+
+  for( int i = n; i < w; i++ ) {
+    PL011_putc( UART1, ' ', true );
+  }
+  while( n > 0 ) {
+    PL011_putc( UART1, s[ --n ], true );
+  }
+}
+
+/* Programs are loaded from disk: given a program name x, the kernel loader
+ * reads the position-independent image /bin/x (or x itself, if it is an
+ * absolute path) into memory, or finds it already resident, and returns a
+ * pointer to the entry point.  The programs statically linked into the
+ * kernel image remain as a fallback, e.g., for use without a disk.
  */
 
 extern void main_P3(); 
@@ -41,7 +58,14 @@ extern void main_P5();
 extern void main_philosopher();
 
 void* load( char* x ) {
-  if     ( 0 == strcmp( x, "P3" ) ) {
+  char path[ 128 ] = "/bin/";
+
+  void* addr = load_image( ( x[ 0 ] == '/' ) ? x : strncat( path, x, sizeof( path ) - 6 ) );
+
+  if     ( addr != NULL ) {
+    return addr;
+  }
+  else if( 0 == strcmp( x, "P3" ) ) {
     return &main_P3;
   }
   else if( 0 == strcmp( x, "P4" ) ) {
@@ -66,16 +90,22 @@ void* load( char* x ) {
  *
  * As is, the console only recognises the following commands:
  *
- * a. execute <program name>
+ * a. execute <program name> [<argument> ...]
  *
  *    This command will use fork to create a new process; the parent
  *    (i.e., the console) will continue as normal, whereas the child
  *    uses exec to replace the process image and thereby execute a
- *    different (named) program.  For example,
+ *    different (named) program, passing it the program name and any
+ *    arguments as argv.  For example,
  *    
  *    execute P3
  *
- *    would execute the user program named P3.
+ *    would execute the user program named P3, i.e., /bin/P3 on disk, and
+ *
+ *    execute DP 5 1000 2000
+ *
+ *    would execute the dining philosophers benchmark with arguments 5,
+ *    1000 and 2000.
  *
  * b. terminate <process ID> 
  *
@@ -87,8 +117,227 @@ void* load( char* x ) {
  *    terminate 3
  *
  *    would terminate the process whose PID is 3.
+ *
+ * c. ps
+ *
+ *    This command lists every process, with its status (R = ready, X =
+ *    executing, W = waiting), priority, the time it has spent executing
+ *    and waiting in a ready queue (in ms), the number of times it was
+ *    switched away from by yield (voluntary) or the timer (involuntary),
+ *    and the number of system calls it has made.
+ *
+ * d. top
+ *
+ *    This command lists the same, but ordered by (and with) the share of
+ *    the CPU each process has had since top was last used (or since it
+ *    was created).
+ *
+ * e. lat [reset]
+ *
+ *    This command lists, for each system call made since the histograms
+ *    were last reset, how many times it was made and the minimum, mean,
+ *    50th, 90th and 99th percentile, and maximum latency of the kernel
+ *    handler (in ticks of the 24MHz counter; a percentile is the top of
+ *    a power-of-two bucket, so overestimates by at most a factor of 2).
+ *    With reset, it clears the histograms instead.
+ *
+ * f. irq [reset]
+ *
+ *    This command lists the same for the timer interrupt, i.e., for the
+ *    latency from expiry of the timer to entry to the handler, and for
+ *    the duration of the handler; the spread between the minimum and the
+ *    99th percentile latency is a measure of scheduling jitter.  With
+ *    reset, the histograms are cleared after being listed, so the next
+ *    use covers only the interval in between.
+ *
+ * g. prof <rate>
+ *
+ *    This command starts the profiler, which samples the PC the given
+ *    number of times per second into the kernel trace (for make profile
+ *    to resolve into a profile on the host), or stops it iff. the rate
+ *    is 0.  For example,
+ *
+ *    prof 1000
+ *
+ *    would take 1000 samples per second.
+ *
+ * h. pmu [reset | <event> ...]
+ *
+ *    This command lists the PMU cycle counter and each event counter
+ *    (with the event it counts), then the same as lat for each kernel
+ *    scope measured in cycles, i.e., dispatch, scheduling, and writing
+ *    a character to the console.  With reset, the histograms are cleared
+ *    after being listed; with events, each event counter is first set to
+ *    count the given event (in decimal, per the ARMv7 event numbers), so
+ *    for example
+ *
+ *    pmu 8 3 4 16
+ *
+ *    would count instructions executed, data cache misses and accesses,
+ *    and mispredicted branches.
+ *
+ * i. stat
+ *
+ *    This command lists the counters kept by each kernel subsystem since
+ *    reset, i.e., by the block cache, the I/O scheduler (read and write
+ *    queues), the file system directory entry and inode caches, the
+ *    journal, the metadata checksums, the program loader, demand paging,
+ *    the event trace, and the profiler.  For example, using stat before
+ *    and after a program is executed twice shows whether the second time
+ *    was served from memory, i.e., by hits rather than misses.
  */
 
+// write one line of ps output for process x, with the CPU share c (in %) iff. c >= 0
+void ps_line( proc_stat_t* x, int c ) {
+  putn( x->pid, 5 ); puts( " ", 1 );
+  PL011_putc( UART1, ( x->status < 6 ) ? "?CTRXW"[ x->status ] : '?', true );
+  putn( x->prty, 4 );
+  if( c >= 0 ) {
+    putn( c, 5 );
+  }
+  putn( x->run  / PS_TICKS_PER_MS, 10 );
+  putn( x->wait / PS_TICKS_PER_MS, 10 );
+  putn( x->vcsw, 7 ); putn( x->ivcsw, 7 ); putn( x->svcs, 8 ); puts( "\n", 1 );
+}
+
+void ps_list( bool top ) {
+  static proc_stat_t last[ MAX_PS ]; static int m = 0;
+
+  proc_stat_t x[ MAX_PS ]; uint64_t d[ MAX_PS ], total = 0; int k[ MAX_PS ];
+
+  int n = ps( x, MAX_PS );
+
+  // time each process has run since the last top, for the CPU share
+  for( int i = 0; i < n; i++ ) {
+    d[ i ] = x[ i ].run; k[ i ] = i;
+
+    for( int j = 0; j < m; j++ ) {
+      if( last[ j ].pid == x[ i ].pid ) {
+        d[ i ] -= last[ j ].run;
+      }
+    }
+
+    total += d[ i ];
+  }
+
+  if( top ) {
+    for( int i = 0; i < n; i++ ) {
+      for( int j = i + 1; j < n; j++ ) {
+        if( d[ k[ j ] ] > d[ k[ i ] ] ) {
+          int t = k[ i ]; k[ i ] = k[ j ]; k[ j ] = t;
+        }
+      }
+    }
+
+    memcpy( last, x, n * sizeof( proc_stat_t ) ); m = n;
+  }
+
+  char* h = top ? "  PID S PRI %CPU   RUN(ms)  WAIT(ms)   VCSW  IVCSW    SVCS\n"
+                : "  PID S PRI   RUN(ms)  WAIT(ms)   VCSW  IVCSW    SVCS\n";
+
+  puts( h, strlen( h ) );
+
+  for( int i = 0; i < n; i++ ) {
+    ps_line( &x[ k[ i ] ], top ? ( int )( ( total == 0 ) ? 0 : ( 100 * d[ k[ i ] ] ) / total ) : -1 );
+  }
+}
+
+// write the rest of one line of lat or irq output, for histogram x
+void hist_line( hist_t* x ) {
+  putn( x->count, 9 ); putn( ( x->count == 0 ) ? 0 : x->min, 10 ); putn( ( x->count == 0 ) ? 0 : ( uint32_t )( x->sum / x->count ), 10 );
+  putn( hist_percentile( x, 50 ), 10 );
+  putn( hist_percentile( x, 90 ), 10 );
+  putn( hist_percentile( x, 99 ), 10 );
+  putn( x->max, 10 ); puts( "\n", 1 );
+}
+
+void lat_list() {
+  char* h = "  SVC    COUNT       MIN      MEAN       P50       P90       P99       MAX\n";
+
+  puts( h, strlen( h ) );
+
+  for( int id = 0; id < SVC_IDS; id++ ) {
+    hist_t x;
+
+    if( ( 0 != svc_stat( id, &x ) ) || ( 0 == x.count ) ) {
+      continue;
+    }
+
+    puts( " 0x", 3 );
+    PL011_putc( UART1, "0123456789ABCDEF"[ ( id >> 4 ) & 0xF ], true );
+    PL011_putc( UART1, "0123456789ABCDEF"[ ( id >> 0 ) & 0xF ], true );
+    hist_line( &x );
+  }
+}
+
+void irq_list( bool reset ) {
+  char* h = "  IRQ    COUNT       MIN      MEAN       P50       P90       P99       MAX\n";
+
+  hist_t x[ 2 ];
+
+  irq_stat( x, reset );
+
+  puts( h, strlen( h ) );
+  puts( "  lat", 5 ); hist_line( &x[ IRQ_LAT ] );
+  puts( "  dur", 5 ); hist_line( &x[ IRQ_DUR ] );
+}
+
+void pmu_list( bool reset, uint32_t* events ) {
+  char* h = " SCOPE   COUNT       MIN      MEAN       P50       P90       P99       MAX\n";
+  char* scope[] = { "  disp", "  schd", "  putc" }; // per PMU_DISPATCH etc.
+
+  pmu_t x; int n = pmu( &x, events );
+
+  puts( "cycles", 6 ); putn( x.cycles, 11 ); puts( "\n", 1 );
+
+  for( int i = 0; i < n; i++ ) {
+    puts( "event ", 6 ); putn( x.event[ i ], 3 ); putn( x.count[ i ], 8 ); puts( "\n", 1 );
+  }
+
+  puts( h, strlen( h ) );
+
+  for( int id = 0; id < sizeof( scope ) / sizeof( char* ); id++ ) {
+    hist_t y;
+
+    if( 0 != pmu_stat( id, &y, reset ) ) {
+      continue;
+    }
+
+    puts( scope[ id ], 6 ); hist_line( &y );
+  }
+}
+
+// write one group of stat output: header h, then label x (7 characters) and the n counters in y
+void stat_line( char* h, char* x, uint32_t* y, int n ) {
+  puts( h, strlen( h ) ); puts( x, 7 );
+
+  for( int i = 0; i < n; i++ ) {
+    putn( y[ i ], 10 );
+  }
+
+  puts( "\n", 1 );
+}
+
+void stat_list() {
+  cache_stat_t c; ios_stat_t q[ 2 ]; fs_stat_t f; journal_stat_t j; csum_stat_t s;
+  loader_stat_t l; vm_stat_t v; trace_stat_t t; prof_stat_t p;
+
+  cache_stat( &c ); ios_stat( q ); fs_stat( &f ); journal_stat( &j ); csum_stat( &s );
+  loader_stat( &l ); vm_stat( &v ); trace_stat( &t ); prof_stat( &p );
+
+  // every counter is a uint32_t, so each structure is listed as an array of them
+  stat_line( "             HITS    MISSES     EVICT     WBACK   RDAHEAD\n", "cache  ", ( uint32_t* )( &c ), sizeof( c ) / 4 );
+  stat_line( "           SUBMIT    MERGED  DISPATCH    BLOCKS   EXPIRED    ERRORS     DEPTH  MAXDEPTH\n", "ios rd ", ( uint32_t* )( &q[ IOS_RD ] ), sizeof( q[ 0 ] ) / 4 );
+  stat_line( "", "ios wr ", ( uint32_t* )( &q[ IOS_WR ] ), sizeof( q[ 0 ] ) / 4 );
+  stat_line( "            DHITS   DMISSES  DIRREADS     IHITS   IMISSES\n", "fs     ", ( uint32_t* )( &f ), sizeof( f ) / 4 );
+  stat_line( "          COMMITS    BLOCKS   REPLAYS\n", "journal", ( uint32_t* )( &j ), sizeof( j ) / 4 );
+  stat_line( "          CHECKED    FAILED   UPDATED\n", "csum   ", ( uint32_t* )( &s ), sizeof( s ) / 4 );
+  stat_line( "             HITS    MISSES    MAPPED  REJECTED      USED\n", "loader ", ( uint32_t* )( &l ), sizeof( l ) / 4 );
+  stat_line( "           FAULTS   PAGEINS    FRAMES    FAILED\n", "vm     ", ( uint32_t* )( &v ), sizeof( v ) / 4 );
+  stat_line( "           EVENTS      LOST     BYTES\n", "trace  ", ( uint32_t* )( &t ), sizeof( t ) / 4 );
+  stat_line( "               HZ   SAMPLES\n", "prof   ", ( uint32_t* )( &p ), sizeof( p ) / 4 );
+}
+
 void main_console() {
   while( 1 ) {
     char cmd[ MAX_CMD_CHARS ];
@@ -99,11 +348,17 @@ void main_console() {
 
     // step 2: tokenize command.
 
-    int cmd_argc = 0; char* cmd_argv[ MAX_CMD_ARGS ];
+    int cmd_argc = 0; char* cmd_argv[ MAX_CMD_ARGS + 1 ];
    
-    for( char* t = strtok( cmd, " " ); t != NULL; t = strtok( NULL, " " ) ) {
+    for( char* t = strtok( cmd, " " ); t != NULL && cmd_argc < MAX_CMD_ARGS; t = strtok( NULL, " " ) ) {
       cmd_argv[ cmd_argc++ ] = t;
     }
+
+    cmd_argv[ cmd_argc ] = NULL;
+
+    if( cmd_argc == 0 ) {
+      continue;
+    }
 	
     // step 3: execute command.
 
@@ -112,7 +367,7 @@ void main_console() {
 
       if( addr != NULL ) {
         if( 0 == fork() ) {
-          exec( addr );
+          exec( addr, &cmd_argv[ 1 ] );
         }
       }
       else {
@@ -122,6 +377,40 @@ void main_console() {
     else if( 0 == strcmp( cmd_argv[ 0 ], "terminate" ) ) {
       kill( atoi( cmd_argv[ 1 ] ), SIG_TERM );
     } 
+    else if( 0 == strcmp( cmd_argv[ 0 ], "ps"        ) ) {
+      ps_list( false );
+    } 
+    else if( 0 == strcmp( cmd_argv[ 0 ], "top"       ) ) {
+      ps_list( true  );
+    } 
+    else if( 0 == strcmp( cmd_argv[ 0 ], "lat"       ) ) {
+      if( ( cmd_argc > 1 ) && ( 0 == strcmp( cmd_argv[ 1 ], "reset" ) ) ) {
+        svc_reset();
+      }
+      else {
+        lat_list();
+      }
+    } 
+    else if( 0 == strcmp( cmd_argv[ 0 ], "irq"       ) ) {
+      irq_list( ( cmd_argc > 1 ) && ( 0 == strcmp( cmd_argv[ 1 ], "reset" ) ) );
+    } 
+    else if( 0 == strcmp( cmd_argv[ 0 ], "prof"      ) ) {
+      prof( ( cmd_argc > 1 ) ? atoi( cmd_argv[ 1 ] ) : 0 );
+    } 
+    else if( 0 == strcmp( cmd_argv[ 0 ], "pmu"       ) ) {
+      uint32_t events[ PMU_EVENTS ] = { 0 };
+
+      for( int i = 1; i < cmd_argc && i <= PMU_EVENTS; i++ ) {
+        events[ i - 1 ] = atoi( cmd_argv[ i ] );
+      }
+
+      bool reset = ( cmd_argc > 1 ) && ( 0 == strcmp( cmd_argv[ 1 ], "reset" ) );
+
+      pmu_list( reset, ( cmd_argc > 1 && !reset ) ? events : NULL );
+    } 
+    else if( 0 == strcmp( cmd_argv[ 0 ], "stat"      ) ) {
+      stat_list();
+    } 
     else {
       puts( "unknown command\n", 16 );
     }
@@ -19,6 +19,7 @@
 #include "libc.h"
 
 #define MAX_CMD_CHARS ( 1024 )
-#define MAX_CMD_ARGS  (    2 )
+#define MAX_CMD_ARGS  (    8 )
+#define MAX_PS        (   20 )
 
 #endif
@@ -1,77 +1,194 @@
 #include "dining_philosophers.h"
-#include "libc.h"
 
-uint32_t *forks[PHILOSOPHERS];
-bool phils[PHILOSOPHERS];
-uint32_t next;
+/* The dining philosophers double as a benchmark of the semaphores and the
+ * scheduler under contention.  It takes (up to) five arguments, namely
+ *
+ * 1. the number of philosophers, from 2 to PHILOSOPHERS (default 5),
+ * 2. how long a philosopher thinks before each meal, in us (default 1000),
+ * 3. how long a philosopher eats, in us (default 1000),
+ * 4. how long the benchmark runs, in s (default 5), and
+ * 5. whether a philosopher sleeps (1, the default) or spins (0) while
+ *    thinking and eating,
+ *
+ * e.g., execute DP 5 1000 2000 10 0.  Each philosopher is a process, and
+ * each fork a semaphore.  Thinking and eating are waits of a fixed length:
+ * a sleep leaves the processor to the other processes, but is rounded up
+ * to whole ms, whereas a busy-wait is timed by the 24MHz counter, so any
+ * variation between philosophers is down to contention for the forks and
+ * for the processor.  Data is shared by every process executing a
+ * program, so each philosopher updates its own entry in a table of
+ * statistics, i.e., meals eaten and time spent waiting for forks, and the
+ * first process (which only waits) reports
+ *
+ * - the meals per second, in all,
+ * - the meals and mean and maximum wait of each philosopher, and
+ * - the fairness of the meals, per Jain's index: ( sum x )^2 / ( n sum x^2 )
+ *   for x the meals of each of n philosophers, so 1 iff. each had as many,
+ *   and 1 / n iff. one philosopher had them all,
+ *
+ * ending with a BENCH line for tools/qbench.py.
+ */
 
-// pseudo-random generator for philosopher wait times
-uint32_t random() {
-          next = next*1103515245 +12345;
-          return (uint32_t) (next*65536)%4294967296;
+typedef struct {
+  uint32_t meals;                     // meals eaten
+  uint64_t wait;                      // time spent waiting for forks (in ticks), in all
+  uint32_t wait_max;                  // time spent waiting for forks (in ticks) before one meal, at most
+  bool     done;                      // stopped?
+} phil_stat_t;
+
+uint32_t*         phil_forks[ PHILOSOPHERS ];
+phil_stat_t       phil_stats[ PHILOSOPHERS ];
+volatile bool     phil_stop;
+
+// wait for t ticks: sleep (for t rounded up to whole ms) iff. nap, or busy-wait
+static void spin( uint32_t t, bool nap ) {
+  uint32_t x = SYSCONF->COUNTER_24MHZ;
+
+  if( nap ) {
+    sleep_ms( ( t + PHIL_TICKS_PER_US * 1000 - 1 ) / ( PHIL_TICKS_PER_US * 1000 ) ); return;
+  }
+
+  while( SYSCONF->COUNTER_24MHZ - x < t ) {
+    asm volatile( "nop \n" : : : );
+  }
+}
+
+// write string x
+static void say( char* x ) {
+  write( STDOUT_FILENO, x, strlen( x ) );
 }
 
-// seed the generator variable
-void seed_random(uint32_t seed) {
-	next = seed;
+// write integer x, followed by string y
+static void say_n( uint32_t x, char* y ) {
+  char s[ 12 ]; itoa( s, x ); say( s ); say( y );
 }
 
-void philosopher(int p) {
-	while(true) {
-		// random wait time
-		for (volatile int i = 0; i < random(); i++) { 
-			asm volatile ( "nop \n" : : : );
-		}
-		
-		// assign left and right forks for a philosopher
-		int left = p;
-		int right = (p+1)%PHILOSOPHERS;
-
-		// always pick up the lowest index fork first (prevents deadlock)
-		if (left < right) {
-			sem_wait(forks[left]);
-			sem_wait(forks[right]);
-		}
-		else {
-			sem_wait(forks[right]);
-			sem_wait(forks[left]);
-		}
-		
-		// print philosopher id, assign true to philosopher index
-		char* x;
-		itoa(x,p);
-        write(0,x,2);
-		phils[p] = true;
-
-		// random eat time
-		for (volatile int i = 0; i < random(); i++) { 
-			asm volatile ( "nop \n" : : : );
-		}
-
-		// put down forks
-		sem_post(forks[left]);
-		sem_post(forks[right]);
-		phils[p] = false;
-	}
+// write x / 1000 to 3 decimal places, followed by string y
+static void say_f( uint32_t x, char* y ) {
+  char s[ 12 ];
+
+  say_n( x / 1000, "." );
+
+  itoa( s, 1000 + ( x % 1000 ) ); say( s + 1 ); say( y ); // skip the leading 1, which keeps any leading 0s
+}
+
+// parse argument i of argv (of argc), or default to x if absent; clamp to lo ... hi
+static uint32_t arg( int argc, char* argv[], int i, uint32_t x, uint32_t lo, uint32_t hi ) {
+  if( i < argc ) {
+    x = atoi( argv[ i ] );
+  }
+
+  return ( x < lo ) ? lo : ( x > hi ) ? hi : x;
+}
+
+void philosopher( int p, int n, uint32_t think, uint32_t eat, bool nap ) {
+  phil_stat_t* s = &phil_stats[ p ];
+
+  // always pick up the lowest index fork first (prevents deadlock)
+  int lo = ( p < ( p + 1 ) % n ) ? p : ( p + 1 ) % n;
+  int hi = ( p < ( p + 1 ) % n ) ? ( p + 1 ) % n : p;
+
+  while( !phil_stop ) {
+    spin( think, nap );
+
+    uint32_t t = SYSCONF->COUNTER_24MHZ;
+
+    sem_wait( phil_forks[ lo ] );
+    sem_wait( phil_forks[ hi ] );
+
+    t = SYSCONF->COUNTER_24MHZ - t;
+
+    s->meals++; s->wait += t; s->wait_max = ( t > s->wait_max ) ? t : s->wait_max;
+
+    spin( eat, nap );
+
+    // put down forks
+    sem_post( phil_forks[ hi ] );
+    sem_post( phil_forks[ lo ] );
+  }
+
+  s->done = true;
+
+  exit( EXIT_SUCCESS );
 }
-			
-void main_philosopher() {
-	seed_random(1);
-	for(int i = 0; i < PHILOSOPHERS; i++) {
-		phils[i] = false;
-	}
-
-	// initialise all forks (semaphore with value 1 aka mutex)
-	for(int i = 0; i < PHILOSOPHERS; i++) {
-		forks[i] = sem_init(1);
-	}
-    // initialise philosopher child processes
-	for(int i = 0; i < PHILOSOPHERS; i++) {
-		if (0 == fork()) {
-			philosopher(i);
-			break;
-		}
-	}
-	exit(EXIT_SUCCESS);	
+
+void main_philosopher( int argc, char* argv[] ) {
+  uint32_t n        = arg( argc, argv, 1,    5, 2, PHILOSOPHERS      );
+  uint32_t think    = arg( argc, argv, 2, 1000, 0, 1000000           ) * PHIL_TICKS_PER_US;
+  uint32_t eat      = arg( argc, argv, 3, 1000, 0, 1000000           ) * PHIL_TICKS_PER_US;
+  uint32_t duration = arg( argc, argv, 4,    5, 1, PHIL_DURATION_MAX ) * PHIL_TICKS_PER_US * 1000000;
+  bool     nap      = arg( argc, argv, 5,    1, 0, 1                 );
+
+  phil_stop = false;
+
+  // initialise all forks (semaphore with value 1 aka mutex)
+  for( int i = 0; i < n; i++ ) {
+    phil_forks[ i ] = sem_init( 1 ); memset( &phil_stats[ i ], 0, sizeof( phil_stat_t ) );
+  }
+
+  uint32_t t = SYSCONF->COUNTER_24MHZ;
+
+  // initialise philosopher child processes, of which m are started
+  int m = 0;
+
+  for( ; m < n; m++ ) {
+    int pid = fork();
+
+    if( pid == 0 ) {
+      philosopher( m, n, think, eat, nap );
+    }
+    if( pid < 0 ) {
+      break;
+    }
+  }
+
+  // wait for the run to finish (unless a philosopher could not be started), then for every philosopher started to stop
+  if( m == n ) {
+    sleep_ms( duration / ( PHIL_TICKS_PER_US * 1000 ) );
+  }
+
+  phil_stop = true;
+
+  for( int i = 0; i < m; i++ ) {
+    while( !phil_stats[ i ].done ) {
+      sleep_ms( 1 );
+    }
+  }
+
+  if( m < n ) {
+    for( int i = 0; i < n; i++ ) {
+      sem_close( phil_forks[ i ] );
+    }
+
+    say( "cannot start philosopher " ); say_n( m, "\n" );
+
+    exit( EXIT_FAILURE );
+  }
+
+  uint32_t ms = ( SYSCONF->COUNTER_24MHZ - t ) / ( PHIL_TICKS_PER_US * 1000 ), meals = 0, wait_max = 0;
+  uint64_t sum = 0, sum_sq = 0, wait = 0;
+
+  say( "\nphilosopher     meals  wait(us)  max(us)\n" );
+
+  for( int i = 0; i < n; i++ ) {
+    phil_stat_t* s = &phil_stats[ i ];
+
+    say_n( i, "  " ); say_n( s->meals, "  " );
+    say_n( ( s->meals == 0 ) ? 0 : ( uint32_t )( s->wait / s->meals / PHIL_TICKS_PER_US ), "  " );
+    say_n( s->wait_max / PHIL_TICKS_PER_US, "\n" );
+
+    meals += s->meals; sum += s->meals; sum_sq += ( uint64_t )( s->meals ) * s->meals;
+    wait  += s->wait;  wait_max = ( s->wait_max > wait_max ) ? s->wait_max : wait_max;
+
+    sem_close( phil_forks[ i ] );
+  }
+
+  uint32_t rate     = ( ms == 0 ) ? 0 : ( uint32_t )( ( uint64_t )( meals ) * 1000000 / ms ); // meals per s, x 1000
+  uint32_t fairness = ( sum_sq == 0 ) ? 0 : ( uint32_t )( sum * sum * 1000 / ( n * sum_sq ) );  // x 1000
+
+  say( "BENCH phil n=" ); say_n( n, " think_us=" ); say_n( think / PHIL_TICKS_PER_US, " eat_us=" ); say_n( eat / PHIL_TICKS_PER_US, " sleep=" ); say_n( nap, " ms=" ); say_n( ms, " meals=" );
+  say_n( meals, " meals_per_s=" ); say_f( rate, " fairness=" ); say_f( fairness, " wait_mean_us=" );
+  say_n( ( meals == 0 ) ? 0 : ( uint32_t )( wait / meals / PHIL_TICKS_PER_US ), " wait_max_us=" ); say_n( wait_max / PHIL_TICKS_PER_US, "\n" );
+
+  exit( EXIT_SUCCESS );
 }
-			
@@ -1,8 +1,19 @@
 #ifndef __DINING_PHILIOSOPHERS_H
 #define __DINING_PHILIOSOPHERS_H
 
-#define PHILOSOPHERS 16
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
+#include <string.h>
+
+#include "SYS.h"
+
+#include "libc.h"
 #include "lolevel_sem.h"
 
+#define PHILOSOPHERS       16 // philosophers, at most
+#define PHIL_TICKS_PER_US  24 // ticks of the 24MHz counter per microsecond
+#define PHIL_DURATION_MAX  60 // longest run (in s), well within the period of the counter
+
 #endif
@@ -29,6 +29,21 @@ void sem_close(uint32_t* s) {
 				  :
 			);
 }
+
+int sem_timedwait(uint32_t* x, uint32_t ms) {
+	uint32_t t = clock_ms() + ms;
+
+	// the kernel has no wait queue for a semaphore, so poll once per ms rather than spin
+	while (!sem_trywait(x)) {
+		if ((int32_t)(clock_ms() - t) >= 0) {
+			return -1;
+		}
+
+		sleep_ms(1);
+	}
+
+	return 0;
+}
 				   
 int  atoi( char* x        ) {
   char* p = x; bool s = false; int r = 0;
@@ -75,6 +90,26 @@ void itoa( char* r, int x ) {
   return;
 }
 
+uint32_t hist_percentile( const hist_t* x, int p ) {
+  uint64_t n = ( ( uint64_t )( x->count ) * p + 99 ) / 100, m = 0;
+
+  if( n == 0 ) {
+    n = 1;
+  }
+
+  for( int k = 0; k < HIST_BUCKETS; k++ ) {
+    m += x->bucket[ k ];
+
+    if( m >= n ) {
+      uint32_t t = ( k == 0 ) ? 0 : ( uint32_t )( ( ( uint64_t )( 1 ) << k ) - 1 );
+
+      return ( t < x->max ) ? t : x->max;
+    }
+  }
+
+  return x->max;
+}
+
 void yield() {
   asm volatile( "svc %0     \n" // make system call SYS_YIELD
               :
@@ -136,12 +171,13 @@ void exit( int x ) {
   return;
 }
 
-void exec( const void* x ) {
+void exec( const void* x, char* argv[] ) {
   asm volatile( "mov r0, %1 \n" // assign r0 = x
+                "mov r1, %2 \n" // assign r1 = argv
                 "svc %0     \n" // make system call SYS_EXEC
               :
-              : "I" (SYS_EXEC), "r" (x)
-              : "r0" );
+              : "I" (SYS_EXEC), "r" (x), "r" (argv)
+              : "r0", "r1" );
 
   return;
 }
@@ -170,3 +206,385 @@ void nice( int pid, int x ) {
 
   return;
 }
+
+int  sync() {
+  int r;
+
+  asm volatile( "svc %1     \n" // make system call SYS_SYNC
+                "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_SYNC)
+              : "r0" );
+
+  return r;
+}
+
+int  cache_stat( cache_stat_t* x ) {
+  int r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 = x
+                "svc %1     \n" // make system call SYS_CACHE_STAT
+                "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_CACHE_STAT), "r" (x)
+              : "r0" );
+
+  return r;
+}
+
+int  ios_stat( ios_stat_t* x ) {
+  int r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 = x
+                "svc %1     \n" // make system call SYS_IOS_STAT
+                "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_IOS_STAT), "r" (x)
+              : "r0" );
+
+  return r;
+}
+
+int  fs_stat( fs_stat_t* x ) {
+  int r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 = x
+                "svc %1     \n" // make system call SYS_FS_STAT
+                "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_FS_STAT), "r" (x)
+              : "r0" );
+
+  return r;
+}
+
+int  journal_stat( journal_stat_t* x ) {
+  int r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 = x
+                "svc %1     \n" // make system call SYS_JOURNAL_STAT
+                "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_JOURNAL_STAT), "r" (x)
+              : "r0" );
+
+  return r;
+}
+
+int  csum_stat( csum_stat_t* x ) {
+  int r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 = x
+                "svc %1     \n" // make system call SYS_CSUM_STAT
+                "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_CSUM_STAT), "r" (x)
+              : "r0" );
+
+  return r;
+}
+
+int  loader_stat( loader_stat_t* x ) {
+  int r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 = x
+                "svc %1     \n" // make system call SYS_LOADER_STAT
+                "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_LOADER_STAT), "r" (x)
+              : "r0" );
+
+  return r;
+}
+
+int  vm_stat( vm_stat_t* x ) {
+  int r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 = x
+                "svc %1     \n" // make system call SYS_VM_STAT
+                "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_VM_STAT), "r" (x)
+              : "r0" );
+
+  return r;
+}
+
+int  trace_stat( trace_stat_t* x ) {
+  int r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 = x
+                "svc %1     \n" // make system call SYS_TRACE_STAT
+                "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_TRACE_STAT), "r" (x)
+              : "r0" );
+
+  return r;
+}
+
+int  open( const char* x, int f ) {
+  int r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 = x
+                "mov r1, %3 \n" // assign r1 = f
+                "svc %1     \n" // make system call SYS_OPEN
+                "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_OPEN), "r" (x), "r" (f)
+              : "r0", "r1" );
+
+  return r;
+}
+
+int  close( int fd ) {
+  int r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 = fd
+                "svc %1     \n" // make system call SYS_CLOSE
+                "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_CLOSE), "r" (fd)
+              : "r0" );
+
+  return r;
+}
+
+int  mkdir( const char* x ) {
+  int r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 = x
+                "svc %1     \n" // make system call SYS_MKDIR
+                "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_MKDIR), "r" (x)
+              : "r0" );
+
+  return r;
+}
+
+int  stat( const char* x, stat_t* s ) {
+  int r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 = x
+                "mov r1, %3 \n" // assign r1 = s
+                "svc %1     \n" // make system call SYS_STAT
+                "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_STAT), "r" (x), "r" (s)
+              : "r0", "r1" );
+
+  return r;
+}
+
+int  dup( int fd ) {
+  int r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 = fd
+                "svc %1     \n" // make system call SYS_DUP
+                "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_DUP), "r" (fd)
+              : "r0" );
+
+  return r;
+}
+
+int  pipe( int x[ 2 ] ) {
+  int r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 = x
+                "svc %1     \n" // make system call SYS_PIPE
+                "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_PIPE), "r" (x)
+              : "r0", "memory" );
+
+  return r;
+}
+
+void* load_image( const char* x ) {
+  void* r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 = x
+                "svc %1     \n" // make system call SYS_LOAD
+                "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_LOAD), "r" (x)
+              : "r0" );
+
+  return r;
+}
+
+void* mmap( int fd, uint32_t off, size_t n, int prot ) {
+  void* r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 = fd
+                "mov r1, %3 \n" // assign r1 = off
+                "mov r2, %4 \n" // assign r2 = n
+                "mov r3, %5 \n" // assign r3 = prot
+                "svc %1     \n" // make system call SYS_MMAP
+                "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_MMAP), "r" (fd), "r" (off), "r" (n), "r" (prot)
+              : "r0", "r1", "r2", "r3" );
+
+  return r;
+}
+
+int   munmap( void* x ) {
+  int r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 = x
+                "svc %1     \n" // make system call SYS_MUNMAP
+                "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_MUNMAP), "r" (x)
+              : "r0" );
+
+  return r;
+}
+
+int  ps( proc_stat_t* x, int n ) {
+  int r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 = x
+                "mov r1, %3 \n" // assign r1 = n
+                "svc %1     \n" // make system call SYS_PS
+                "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_PS), "r" (x), "r" (n)
+              : "r0", "r1", "memory" );
+
+  return r;
+}
+
+int  svc_stat( int id, hist_t* x ) {
+  int r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 = id
+                "mov r1, %3 \n" // assign r1 = x
+                "svc %1     \n" // make system call SYS_SVC_STAT
+                "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_SVC_STAT), "r" (id), "r" (x)
+              : "r0", "r1", "memory" );
+
+  return r;
+}
+
+void svc_reset() {
+  asm volatile( "svc %0     \n" // make system call SYS_SVC_RESET
+              :
+              : "I" (SYS_SVC_RESET)
+              : "r0" );
+
+  return;
+}
+
+int  irq_stat( hist_t* x, bool reset ) {
+  int r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 = x
+                "mov r1, %3 \n" // assign r1 = reset
+                "svc %1     \n" // make system call SYS_IRQ_STAT
+                "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_IRQ_STAT), "r" (x), "r" (reset)
+              : "r0", "r1", "memory" );
+
+  return r;
+}
+
+uint32_t prof( uint32_t hz ) {
+  uint32_t r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 = hz
+                "svc %1     \n" // make system call SYS_PROF
+                "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_PROF), "r" (hz)
+              : "r0" );
+
+  return r;
+}
+
+int  prof_stat( prof_stat_t* x ) {
+  int r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 = x
+                "svc %1     \n" // make system call SYS_PROF_STAT
+                "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_PROF_STAT), "r" (x)
+              : "r0" );
+
+  return r;
+}
+
+int  pmu( pmu_t* x, const uint32_t* events ) {
+  int r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 = x
+                "mov r1, %3 \n" // assign r1 = events
+                "svc %1     \n" // make system call SYS_PMU
+                "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_PMU), "r" (x), "r" (events)
+              : "r0", "r1", "memory" );
+
+  return r;
+}
+
+int  pmu_stat( int id, hist_t* x, bool reset ) {
+  int r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 = id
+                "mov r1, %3 \n" // assign r1 = x
+                "mov r2, %4 \n" // assign r2 = reset
+                "svc %1     \n" // make system call SYS_PMU_STAT
+                "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_PMU_STAT), "r" (id), "r" (x), "r" (reset)
+              : "r0", "r1", "r2", "memory" );
+
+  return r;
+}
+
+uint32_t sleep_ms( uint32_t ms ) {
+  uint32_t r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 = ms
+                "svc %1     \n" // make system call SYS_SLEEP_MS
+                "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_SLEEP_MS), "r" (ms)
+              : "r0" );
+
+  return r;
+}
+
+uint32_t sleep_until( uint32_t t ) {
+  uint32_t r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 = t
+                "svc %1     \n" // make system call SYS_SLEEP_UNTIL
+                "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_SLEEP_UNTIL), "r" (t)
+              : "r0" );
+
+  return r;
+}
+
+uint32_t clock_ms() {
+  uint32_t r;
+
+  asm volatile( "svc %1     \n" // make system call SYS_CLOCK_MS
+                "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_CLOCK_MS)
+              : "r0" );
+
+  return r;
+}
@@ -22,7 +22,8 @@ typedef int pid_t;
  *    to specify which action the kernel should take),
  * 2. signal identifiers (as used by the kill system call), 
  * 3. status codes for exit,
- * 4. standard file descriptors (e.g., for read and write system calls),
+ * 4. flags for open and mmap, and standard file descriptors (e.g., for read and
+ *    write system calls),
  * 5. platform-specific constants, which may need calibration (wrt. the
  *    underlying hardware QEMU is executed on).
  *
@@ -40,6 +41,35 @@ typedef int pid_t;
 #define SYS_NICE      ( 0x07 )
 #define SYS_SEM_INIT  ( 0x08 )
 #define SYS_SEM_CLOSE ( 0x09 )
+#define SYS_SYNC      ( 0x0A )
+#define SYS_CACHE_STAT ( 0x0B )
+#define SYS_IOS_STAT  ( 0x0C )
+#define SYS_FS_STAT   ( 0x0D )
+#define SYS_JOURNAL_STAT ( 0x0E )
+#define SYS_CSUM_STAT ( 0x0F )
+#define SYS_OPEN      ( 0x10 )
+#define SYS_CLOSE     ( 0x11 )
+#define SYS_MKDIR     ( 0x12 )
+#define SYS_STAT      ( 0x13 )
+#define SYS_DUP       ( 0x14 )
+#define SYS_PIPE      ( 0x15 )
+#define SYS_LOAD      ( 0x16 )
+#define SYS_MMAP      ( 0x17 )
+#define SYS_MUNMAP    ( 0x18 )
+#define SYS_PS        ( 0x19 )
+#define SYS_SVC_STAT  ( 0x1A )
+#define SYS_SVC_RESET ( 0x1B )
+#define SYS_IRQ_STAT  ( 0x1C )
+#define SYS_PROF      ( 0x1D )
+#define SYS_PMU       ( 0x1E )
+#define SYS_PMU_STAT  ( 0x1F )
+#define SYS_SLEEP_MS  ( 0x20 )
+#define SYS_SLEEP_UNTIL ( 0x21 )
+#define SYS_CLOCK_MS  ( 0x22 )
+#define SYS_LOADER_STAT ( 0x23 )
+#define SYS_VM_STAT   ( 0x24 )
+#define SYS_TRACE_STAT ( 0x25 )
+#define SYS_PROF_STAT ( 0x26 )
 
 #define SIG_TERM      ( 0x00 )
 #define SIG_QUIT      ( 0x01 )
@@ -47,10 +77,178 @@ typedef int pid_t;
 #define EXIT_SUCCESS  ( 0 )
 #define EXIT_FAILURE  ( 1 )
 
+#define O_RDONLY      ( 0x0000 )
+#define O_WRONLY      ( 0x0001 )
+#define O_RDWR        ( 0x0002 )
+#define O_CREAT       ( 0x0040 )
+#define O_TRUNC       ( 0x0200 )
+#define O_APPEND      ( 0x0400 )
+
+#define PROT_READ     ( 0x0001 )
+#define PROT_WRITE    ( 0x0002 )
+
 #define  STDIN_FILENO ( 0 )
 #define STDOUT_FILENO ( 1 )
 #define STDERR_FILENO ( 2 )
 
+// Define a type that captures the kernel block cache hit/miss counters.
+
+typedef struct {
+  uint32_t hits;       // lookups served from memory
+  uint32_t misses;     // lookups that read the disk
+  uint32_t evictions;  // buffers reused for another block
+  uint32_t writebacks; // dirty blocks written to the disk
+  uint32_t readaheads; // blocks read before being asked for
+} cache_stat_t;
+
+// Define a type that captures the statistics of one kernel I/O scheduler queue.
+
+typedef struct {
+  uint32_t submitted;  // blocks submitted
+  uint32_t merged;     // blocks merged into a queued request
+  uint32_t dispatched; // requests sent to the disk
+  uint32_t blocks;     // blocks   sent to the disk
+  uint32_t expired;    // requests dispatched out of order by deadline
+  uint32_t errors;     // requests that failed
+  uint32_t depth;      // requests currently queued
+  uint32_t max_depth;  // high-water mark of depth
+} ios_stat_t;
+
+#define IOS_RD        ( 0 )
+#define IOS_WR        ( 1 )
+
+// Define a type that captures the kernel file system cache counters.
+
+typedef struct {
+  uint32_t dcache_hits;   // path components resolved from memory
+  uint32_t dcache_misses; // path components looked up on disk
+  uint32_t dir_reads;     // directory buckets read by lookups
+  uint32_t icache_hits;   // inodes found in memory
+  uint32_t icache_misses; // inodes read from the block cache
+} fs_stat_t;
+
+// Define a type that captures the kernel metadata journal counters.
+
+typedef struct {
+  uint32_t commits;    // transactions committed
+  uint32_t blocks;     // blocks written via the journal
+  uint32_t replays;    // transactions replayed at mount
+} journal_stat_t;
+
+// Define a type that captures the kernel metadata checksum counters.
+
+typedef struct {
+  uint32_t checked;    // blocks checked
+  uint32_t failed;     // blocks whose checksum did not match
+  uint32_t updated;    // checksums (re)computed
+} csum_stat_t;
+
+// Define a type that captures the kernel program loader counters.
+
+typedef struct {
+  uint32_t hits;       // loads served by a resident image
+  uint32_t misses;     // loads that read an image from disk
+  uint32_t mapped;     // images mapped, rather than copied
+  uint32_t rejected;   // images that could not be loaded
+  uint32_t used;       // bytes of image space in use
+} loader_stat_t;
+
+// Define a type that captures the kernel demand paging counters.
+
+typedef struct {
+  uint32_t faults;     // aborts handled
+  uint32_t pageins;    // pages read from a file
+  uint32_t frames;     // frames currently mapped
+  uint32_t failed;     // aborts that terminated a process
+} vm_stat_t;
+
+// Define a type that captures the kernel event trace counters.
+
+typedef struct {
+  uint32_t events;     // events recorded
+  uint32_t lost;       // events dropped because the buffer was full
+  uint32_t bytes;      // bytes transmitted
+} trace_stat_t;
+
+// Define a type that captures the kernel profiler state, as set by prof.
+
+typedef struct {
+  uint32_t hz;         // sample rate, or 0 iff. stopped
+  uint32_t samples;    // samples taken
+} prof_stat_t;
+
+// Define a type that describes a file or directory, as filled in by stat.
+
+typedef struct {
+  uint32_t ino;        // inode number
+  uint32_t type;       // S_TYPE_FILE or S_TYPE_DIR
+  uint32_t nlink;      // number of links
+  uint32_t size;       // size in bytes
+  uint32_t blocks;     // size in blocks
+} stat_t;
+
+#define S_TYPE_FILE   ( 1 )
+#define S_TYPE_DIR    ( 2 )
+
+// Define a type that captures the CPU accounting of one process, as filled in by ps (times are in ticks of the 24MHz counter).
+
+typedef struct {
+  uint32_t pid;        // process ID
+  uint32_t status;     // PS_READY, PS_EXECUTING etc.
+  uint32_t prty;       // priority level
+  uint64_t run;        // time spent executing
+  uint64_t wait;       // time spent ready, i.e., in a queue
+  uint32_t vcsw;       // switches away from process by yield  (voluntary)
+  uint32_t ivcsw;      // switches away from process by timer (involuntary)
+  uint32_t svcs;       // system calls made
+} proc_stat_t;
+
+#define PS_CREATED    ( 1 )
+#define PS_TERMINATED ( 2 )
+#define PS_READY      ( 3 )
+#define PS_EXECUTING  ( 4 )
+#define PS_WAITING    ( 5 )
+
+#define PS_TICKS_PER_MS ( 24000 )
+
+// Define a type that captures a latency histogram, as filled in by svc_stat (values are in ticks of the 24MHz counter): bucket 0 counts 0, bucket k > 0 counts 2^( k - 1 ) to 2^k - 1.
+
+#define HIST_BUCKETS  ( 33 )
+
+typedef struct {
+  uint32_t count;      // values recorded
+  uint32_t min;        // smallest value recorded (UINT32_MAX iff. none)
+  uint32_t max;        // largest  value recorded
+  uint64_t sum;        // sum of values recorded
+  uint32_t bucket[ HIST_BUCKETS ];
+} hist_t;
+
+#define SVC_IDS       ( 48 )
+
+#define IRQ_LAT       ( 0 ) // timer interrupt latency,  i.e., from expiry to handler
+#define IRQ_DUR       ( 1 ) // timer interrupt duration, i.e., of handler
+
+// Define a type that captures the PMU counters, as filled in by pmu: the cycle counter, and each of the event counters available, with the event it counts (e.g., PMU_EVENT_INST_RETIRED).
+
+#define PMU_EVENTS    ( 4 )
+
+#define PMU_EVENT_L1I_CACHE_REFILL ( 0x01 ) // instruction cache miss
+#define PMU_EVENT_L1D_CACHE_REFILL ( 0x03 ) //        data cache miss
+#define PMU_EVENT_L1D_CACHE        ( 0x04 ) //        data cache access
+#define PMU_EVENT_INST_RETIRED     ( 0x08 ) // instruction executed
+#define PMU_EVENT_BR_MIS_PRED      ( 0x10 ) // branch mispredicted
+
+typedef struct {
+  uint32_t cycles;     // cycle counter
+  uint32_t events;     // event counters available
+  uint32_t event[ PMU_EVENTS ];
+  uint32_t count[ PMU_EVENTS ];
+} pmu_t;
+
+#define PMU_DISPATCH  ( 0 ) // kernel scope of dispatch,   i.e., a context switch
+#define PMU_SCHEDULE  ( 1 ) // kernel scope of scheduling, i.e., selecting the process to execute next
+#define PMU_PUTC      ( 2 ) // kernel scope of writing a character to the console
+
 // create a semaphore of value i
 extern uint32_t* sem_init(int i);
 // close a semaphore
@@ -60,11 +258,17 @@ extern void sem_close(uint32_t* s);
 extern void sem_wait(uint32_t* x);
 // increment semaphore
 extern void sem_post(uint32_t* x);
+// decrement semaphore iff. non-zero, returning true, or return false
+extern bool sem_trywait(uint32_t* x);
+// decrement semaphore, waiting at most ms ms (by sleeping between attempts): return 0 on success or -1 on timeout
+extern int  sem_timedwait(uint32_t* x, uint32_t ms);
 
 // convert ASCII string x into integer r
 extern int  atoi( char* x        );
 // convert integer x into ASCII string r
 extern void itoa( char* r, int x );
+// bound the p-th percentile of histogram x from above, i.e., by the top of the bucket it falls in (or by the maximum)
+extern uint32_t hist_percentile( const hist_t* x, int p );
 
 // cooperatively yield control of processor, i.e., invoke the scheduler
 extern void yield();
@@ -78,12 +282,73 @@ extern int  read( int fd,       void* x, size_t n );
 extern int  fork();
 // perform exit, i.e., terminate process with status x
 extern void exit(       int   x );
-// perform exec, i.e., start executing program at address x
-extern void exec( const void* x );
+// perform exec, i.e., start executing program at address x, as main_x( argc, argv ) with the NULL-terminated arguments argv (or none iff. argv = NULL)
+extern void exec( const void* x, char* argv[] );
 
 // for process identified by pid, send signal of x
 extern int  kill( pid_t pid, int x );
 // for process identified by pid, set  priority to x
 extern void nice( pid_t pid, int x );
 
+// open the file at path x per flags f, returning a file descriptor or -1 on failure
+extern int  open( const char* x, int f );
+// close file descriptor fd
+extern int  close( int fd );
+// create a directory at path x, returning 0 on success or -1 on failure
+extern int  mkdir( const char* x );
+// describe the file or directory at path x in s, returning 0 on success or -1 on failure
+extern int  stat( const char* x, stat_t* s );
+// make a new descriptor referring to the same console, pipe or file as fd; return it, or -1 on failure
+extern int  dup( int fd );
+// create a pipe, with x[ 0 ] the descriptor for the read end and x[ 1 ] for the write end; return 0 on success or -1 on failure
+extern int  pipe( int x[ 2 ] );
+// load the program image at path x from disk (or memory, if already loaded), returning its entry point for exec or NULL on failure
+extern void* load_image( const char* x );
+// map n bytes of the file fd refers to from offset off (a multiple of 4 KiB), read on demand; return the address, or NULL on failure
+extern void* mmap( int fd, uint32_t off, size_t n, int prot );
+// unmap the mapping at address x, as returned by mmap
+extern int   munmap( void* x );
+
+// write all modified inodes and disk blocks cached by the kernel back to the disk
+extern int  sync();
+// copy the kernel block cache counters into x; return 0 on success or -1 on failure
+extern int  cache_stat( cache_stat_t* x );
+// copy the kernel I/O scheduler statistics for the read (x[ IOS_RD ]) and write (x[ IOS_WR ]) queue into x; return 0 on success or -1 on failure
+extern int  ios_stat( ios_stat_t* x );
+// copy the kernel file system (directory entry and inode) cache counters into x; return 0 on success or -1 on failure
+extern int  fs_stat( fs_stat_t* x );
+// copy the kernel metadata journal counters into x; return 0 on success or -1 on failure
+extern int  journal_stat( journal_stat_t* x );
+// copy the kernel metadata checksum counters into x; return 0 on success or -1 on failure
+extern int  csum_stat( csum_stat_t* x );
+// copy the kernel program loader counters into x; return 0 on success or -1 on failure
+extern int  loader_stat( loader_stat_t* x );
+// copy the kernel demand paging counters into x; return 0 on success or -1 on failure
+extern int  vm_stat( vm_stat_t* x );
+// copy the kernel event trace counters into x; return 0 on success or -1 on failure
+extern int  trace_stat( trace_stat_t* x );
+// copy the CPU accounting of up to n processes into x; return the number copied, or -1 on failure
+extern int  ps( proc_stat_t* x, int n );
+// copy the latency histogram of system call id into x; return 0 on success or -1 on failure
+extern int  svc_stat( int id, hist_t* x );
+// clear the latency histogram of every system call
+extern void svc_reset();
+// copy the timer interrupt latency (x[ IRQ_LAT ]) and duration (x[ IRQ_DUR ]) histograms into x, then clear them iff. reset; return 0 on success or -1 on failure
+extern int  irq_stat( hist_t* x, bool reset );
+// sample the PC into the kernel trace at hz samples per second, or stop iff. hz = 0; return the rate set
+extern uint32_t prof( uint32_t hz );
+// copy the profiler rate and sample count into x; return 0 on success or -1 on failure
+extern int  prof_stat( prof_stat_t* x );
+// select the event counted by each PMU event counter iff. events != NULL, then copy every counter into x; return the number of event counters, or -1 on failure
+extern int  pmu( pmu_t* x, const uint32_t* events );
+// copy the cycle histogram of kernel scope id (e.g., PMU_DISPATCH) into x, then clear it iff. reset; return 0 on success or -1 on failure
+extern int  pmu_stat( int id, hist_t* x, bool reset );
+
+// sleep, i.e., give up the processor, for ms ms; return the time of wake-up (per clock_ms)
+extern uint32_t sleep_ms( uint32_t ms );
+// sleep until time t (per clock_ms), or not at all iff. t has passed; return the time of wake-up
+extern uint32_t sleep_until( uint32_t t );
+// return the time since reset, in ms (wrapping around after 2^32 ms)
+extern uint32_t clock_ms();
+
 #endif
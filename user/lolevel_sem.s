@@ -1,6 +1,7 @@
 
 .global sem_post
 .global sem_wait
+.global sem_trywait
 
 sem_post: ldrex r1 , [ r0 ]          @ s' = MEM[ &s ]
           add r1 , r1 , #1           @ s' = s' + 1
@@ -19,3 +20,19 @@ sem_wait: ldrex r1 , [ r0 ]          @ s' = MEM[ &s ]
           bne sem_wait               @ if r != 0, retry
           dmb                        @ memory barrier
           bx lr                      @ return
+
+sem_trywait: ldrex r1 , [ r0 ]       @ s' = MEM[ &s ]
+          cmp r1 , #0                @ s' ?= 0
+          beq sem_trywait_fail       @ if s' == 0, fail
+          sub r1 , r1 , #1           @ s' = s' - 1
+          strex r2 , r1 , [ r0 ]     @ r <= MEM[ &s ] = s'
+          cmp r2 , #0                @ r ?= 0
+          bne sem_trywait            @ if r != 0, retry
+          dmb                        @ memory barrier
+          mov r0 , #1                @ return true
+          bx lr
+
+sem_trywait_fail:
+          clrex                      @ clear exclusive monitor
+          mov r0 , #0                @ return false
+          bx lr